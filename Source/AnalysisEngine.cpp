@@ -0,0 +1,1284 @@
+#include "AnalysisEngine.h"
+
+//==============================================================================
+// FRAME ALLOCATION CHECK
+#if CHANNELSTRIP_CHECK_FRAME_ALLOCATIONS
+#if JUCE_MAC
+typedef void (mallocLoggerType) (uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t numOfHotFramesToSkip);
+extern "C" mallocLoggerType* malloc_logger;
+#elif JUCE_MSVC && defined (_DEBUG)
+ #include <crtdbg.h>
+#endif
+
+namespace
+{
+   #if JUCE_MAC || (JUCE_MSVC && defined (_DEBUG))
+    // The allocator hook sees every thread of the host. It counts for the threads that asked
+    // for their count, in a fixed table, so it never allocates or takes a lock itself.
+    struct countedThreadType
+    {
+        std::atomic<Thread::ThreadID> threadAt { nullptr };
+        std::atomic<int64> numOfAllocationsAt { 0 };
+    };
+
+    countedThreadType countedThreads[8];
+
+    void countAllocation()
+    {
+        const Thread::ThreadID thread = Thread::getCurrentThreadId();
+        for (auto& counted : countedThreads)
+        {
+            if (counted.threadAt.load (std::memory_order_relaxed) == thread)
+            {
+                counted.numOfAllocationsAt.fetch_add (1, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+
+    int64 getNumOfHookedAllocations()
+    {
+        // the first call of a thread claims a slot, a thread that finds the table full goes unchecked
+        const Thread::ThreadID thread = Thread::getCurrentThreadId();
+        for (auto& counted : countedThreads)
+        {
+            Thread::ThreadID freeSlot = nullptr;
+            if (counted.threadAt.load() == thread || counted.threadAt.compare_exchange_strong (freeSlot, thread))
+                return counted.numOfAllocationsAt.load (std::memory_order_relaxed);
+        }
+        return 0;
+    }
+
+   #if JUCE_MAC
+    void logMalloc (uint32_t type, uintptr_t, uintptr_t, uintptr_t, uintptr_t, uint32_t)
+    {
+        if ((type & 2) != 0)    // MALLOC_LOG_TYPE_ALLOCATE, realloc sets it as well
+            countAllocation();
+    }
+   #else
+    _CRT_ALLOC_HOOK previousCrtHook = nullptr;
+
+    int __cdecl crtAllocHook (int allocType, void* userData, size_t size, int blockType,
+                              long requestNumber, const unsigned char* fileName, int lineNumber)
+    {
+        if (allocType == _HOOK_ALLOC || allocType == _HOOK_REALLOC)
+            countAllocation();
+
+        return previousCrtHook != nullptr ? previousCrtHook (allocType, userData, size, blockType, requestNumber, fileName, lineNumber)
+                                          : TRUE;
+    }
+   #endif
+
+    /** Installed while the plugin binary is loaded, it must be gone before its code is. */
+    struct allocationHookType
+    {
+        allocationHookType()
+        {
+           #if JUCE_MAC
+            // Instruments or MallocStackLogging may log already, they keep the hook
+            isInstalled = (malloc_logger == nullptr);
+            if (isInstalled)
+                malloc_logger = logMalloc;
+           #else
+            previousCrtHook = _CrtSetAllocHook (crtAllocHook);
+            isInstalled = true;
+           #endif
+        }
+
+        ~allocationHookType()
+        {
+           #if JUCE_MAC
+            if (isInstalled && malloc_logger == logMalloc)
+                malloc_logger = nullptr;
+           #else
+            _CrtSetAllocHook (previousCrtHook);
+           #endif
+        }
+
+        bool isInstalled = false;
+    };
+
+    const allocationHookType allocationHook;
+
+    ScopedFrameAllocationCheck::allocationCounterType getDefaultCounter()
+    {
+        return allocationHook.isInstalled ? getNumOfHookedAllocations : nullptr;
+    }
+   #else
+    ScopedFrameAllocationCheck::allocationCounterType getDefaultCounter()
+    {
+        return nullptr;
+    }
+   #endif
+}
+
+// after the hook, it is constructed first in this translation unit
+std::atomic<ScopedFrameAllocationCheck::allocationCounterType> ScopedFrameAllocationCheck::counterAt (getDefaultCounter());
+
+ScopedFrameAllocationCheck::ScopedFrameAllocationCheck()
+: counter (counterAt.load()),
+  numOfAllocationsAtStart (counter != nullptr ? counter() : 0),
+  maxNumOfPaintAllocations (nullptr)
+{
+}
+
+ScopedFrameAllocationCheck::ScopedFrameAllocationCheck (int64& maxNumOfPaintAllocationsToUse)
+: counter (counterAt.load()),
+  numOfAllocationsAtStart (counter != nullptr ? counter() : 0),
+  maxNumOfPaintAllocations (&maxNumOfPaintAllocationsToUse)
+{
+}
+
+ScopedFrameAllocationCheck::~ScopedFrameAllocationCheck()
+{
+    if (counter == nullptr)
+        return;
+
+    const int64 numOfAllocations = counter() - numOfAllocationsAtStart;
+    if (maxNumOfPaintAllocations == nullptr)
+    {
+        // something in the frame allocated: size it in prepareFrame() / resized() instead
+        jassert (numOfAllocations == 0);
+        return;
+    }
+
+    // more than the renderer's scratch: the paint builds or copies something per point, move it to prepareFrame()
+    jassert (numOfAllocations <= *maxNumOfPaintAllocations + paintAllocationSlack);
+    *maxNumOfPaintAllocations = jmax (*maxNumOfPaintAllocations, numOfAllocations);
+}
+
+void ScopedFrameAllocationCheck::setAllocationCounter (allocationCounterType newCounter)
+{
+    counterAt.store (newCounter);
+}
+#endif
+
+//==============================================================================
+// SPECTRUM FRAME
+void spectrumFrameType::setSize (int newFftSize, int newWindowLength)
+{
+    fftSize   = newFftSize;
+    windowLength = newWindowLength;
+    numOfBins = newFftSize / 2 + 1;
+    binsPre     .setSize (numOfChannelTypes, 2 * numOfBins);
+    binsPost    .setSize (numOfChannelTypes, 2 * numOfBins);
+    averagePre  .setSize (numOfChannelTypes, 2 * numOfBins);
+    averagePost .setSize (numOfChannelTypes, 2 * numOfBins);
+    crossSpectrum .setSize (numOfChannelTypes, 2 * numOfBins);
+    binsPre     .clear();
+    binsPost    .clear();
+    averagePre  .clear();
+    averagePost .clear();
+    crossSpectrum .clear();
+    numOfAveragedWindows = 0;
+
+    logBinsPre      .setSize (numOfChannelTypes, 2 * multiResolutionTable::maxNumOfPoints);
+    logBinsPost     .setSize (numOfChannelTypes, 2 * multiResolutionTable::maxNumOfPoints);
+    logAveragePre   .setSize (numOfChannelTypes, 2 * multiResolutionTable::maxNumOfPoints);
+    logAveragePost  .setSize (numOfChannelTypes, 2 * multiResolutionTable::maxNumOfPoints);
+    logCrossSpectrum.setSize (numOfChannelTypes, 2 * multiResolutionTable::maxNumOfPoints);
+    numOfLogPoints = 0;
+}
+
+//==============================================================================
+// STREAMING CORRELATION
+void streamingCorrelationType::setSize (int newNumOfBlocks, int newBlockSize)
+{
+    numOfBlocks = jmax (1, newNumOfBlocks);
+    blockSize   = jmax (1, newBlockSize);
+    blockSums.assign ((size_t) numOfBlocks, blockSumsType());
+    reset();
+}
+
+void streamingCorrelationType::reset()
+{
+    std::fill (blockSums.begin(), blockSums.end(), blockSumsType());
+    windowSums  = blockSumsType();
+    partialSums = blockSumsType();
+    numOfPartialSamples = 0;
+    nextBlock = 0;
+}
+
+void streamingCorrelationType::addSamples (const float* left, const float* right, int numOfSamples)
+{
+    jassert (blockSize > 0);
+
+    while (numOfSamples > 0)
+    {
+        const int numToAdd = jmin (numOfSamples, blockSize - numOfPartialSamples);
+        accumulate (left, right, numToAdd, partialSums);
+
+        left  += numToAdd;
+        right += numToAdd;
+        numOfSamples -= numToAdd;
+        numOfPartialSamples += numToAdd;
+
+        if (numOfPartialSamples == blockSize)
+            completeBlock();
+    }
+}
+
+void streamingCorrelationType::completeBlock()
+{
+    blockSumsType& oldest = blockSums[(size_t) nextBlock];
+    windowSums.lr += partialSums.lr - oldest.lr;
+    windowSums.ll += partialSums.ll - oldest.ll;
+    windowSums.rr += partialSums.rr - oldest.rr;
+    oldest = partialSums;
+
+    if (++nextBlock == numOfBlocks)
+    {
+        // the ring went round once: start again from the stored sums instead of the running one
+        nextBlock  = 0;
+        windowSums = blockSumsType();
+        for (auto& sums : blockSums)
+        {
+            windowSums.lr += sums.lr;
+            windowSums.ll += sums.ll;
+            windowSums.rr += sums.rr;
+        }
+    }
+
+    partialSums = blockSumsType();
+    numOfPartialSamples = 0;
+}
+
+float streamingCorrelationType::getCorrelation() const
+{
+    const double energy = windowSums.ll * windowSums.rr;
+    if (energy <= 1.0e-20)
+        return 0.0f;
+
+    return (float) jlimit (-1.0, 1.0, windowSums.lr / std::sqrt (energy));
+}
+
+void streamingCorrelationType::accumulateScalar (const float* left, const float* right, int numOfSamples, blockSumsType& sums)
+{
+    for (int i = 0; i < numOfSamples; ++i)
+    {
+        sums.lr += left[i] * right[i];
+        sums.ll += left[i] * left[i];
+        sums.rr += right[i] * right[i];
+    }
+}
+
+void streamingCorrelationType::accumulate (const float* left, const float* right, int numOfSamples, blockSumsType& sums)
+{
+    int i = 0;
+
+    // four float lanes are summed over one block at most, only the block total goes to double
+   #if JUCE_USE_SIMD && defined (__SSE2__)
+    __m128 lr = _mm_setzero_ps(), ll = _mm_setzero_ps(), rr = _mm_setzero_ps();
+
+    for (; i + 4 <= numOfSamples; i += 4)
+    {
+        const __m128 l = _mm_loadu_ps (left + i);
+        const __m128 r = _mm_loadu_ps (right + i);
+        lr = _mm_add_ps (lr, _mm_mul_ps (l, r));
+        ll = _mm_add_ps (ll, _mm_mul_ps (l, l));
+        rr = _mm_add_ps (rr, _mm_mul_ps (r, r));
+    }
+
+    float lanes[3][4];
+    _mm_storeu_ps (lanes[0], lr);
+    _mm_storeu_ps (lanes[1], ll);
+    _mm_storeu_ps (lanes[2], rr);
+   #elif JUCE_USE_SIMD && (defined (__ARM_NEON__) || defined (__ARM_NEON))
+    float32x4_t lr = vdupq_n_f32 (0.0f), ll = vdupq_n_f32 (0.0f), rr = vdupq_n_f32 (0.0f);
+
+    for (; i + 4 <= numOfSamples; i += 4)
+    {
+        const float32x4_t l = vld1q_f32 (left + i);
+        const float32x4_t r = vld1q_f32 (right + i);
+        lr = vmlaq_f32 (lr, l, r);
+        ll = vmlaq_f32 (ll, l, l);
+        rr = vmlaq_f32 (rr, r, r);
+    }
+
+    float lanes[3][4];
+    vst1q_f32 (lanes[0], lr);
+    vst1q_f32 (lanes[1], ll);
+    vst1q_f32 (lanes[2], rr);
+   #endif
+
+   #if JUCE_USE_SIMD && (defined (__SSE2__) || defined (__ARM_NEON__) || defined (__ARM_NEON))
+    sums.lr += (double) lanes[0][0] + lanes[0][1] + lanes[0][2] + lanes[0][3];
+    sums.ll += (double) lanes[1][0] + lanes[1][1] + lanes[1][2] + lanes[1][3];
+    sums.rr += (double) lanes[2][0] + lanes[2][1] + lanes[2][2] + lanes[2][3];
+   #endif
+
+    accumulateScalar (left + i, right + i, numOfSamples - i, sums);
+}
+
+//==============================================================================
+// PIXEL REDUCTION TABLE
+void pixelReductionTable::build (int newWidth, int newFftSize, int newSampleRate, int newNumOfLogPoints)
+{
+    width      = newWidth;
+    fftSize    = newFftSize;
+    sampleRate = newSampleRate;
+    numOfLogPoints = newNumOfLogPoints;
+
+    firstBin    .assign (width, 0);
+    numOfBins   .assign (width, 1);
+    binPosition .assign (width, 0.0f);
+    if (sampleRate <= 0 || fftSize <= 0)
+        return;
+
+    if (numOfLogPoints > 0)
+    {
+        // a column owns the points whose centre falls into it, the nearest one when there is none
+        const float pointsPerColumn = numOfLogPoints / (float) width;
+        for (auto x = 0; x < width; ++x)
+        {
+            int pointStart = (int) std::ceil ( x      * pointsPerColumn - 0.5f);
+            int pointEnd   = (int) std::ceil ((x + 1) * pointsPerColumn - 0.5f);
+            if (pointEnd <= pointStart)
+            {
+                pointStart = roundToInt ((x + 0.5f) * pointsPerColumn - 0.5f);
+                pointEnd   = pointStart + 1;
+            }
+
+            pointStart = jlimit (0, numOfLogPoints - 1, pointStart);
+            firstBin[x]    = pointStart;
+            numOfBins[x]   = jlimit (1, numOfLogPoints - pointStart, pointEnd - pointStart);
+            binPosition[x] = jlimit (0.0f, (float) (numOfLogPoints - 1), (x + 0.5f) * pointsPerColumn - 0.5f);
+        }
+        return;
+    }
+
+    const int lastBin = fftSize / 2;
+    const float binsPerHz  = fftSize / (float) sampleRate;
+    const float logRange   = std::log ((sampleRate / 2.f) / 10.f);
+
+    for (auto x = 0; x < width; ++x)
+    {
+        const float freqStart = 10.f * std::exp (logRange * x / width);
+        const float freqEnd   = 10.f * std::exp (logRange * (x + 1) / width);
+
+        int binStart = (int) std::ceil  (freqStart * binsPerHz);
+        int binEnd   = (int) std::ceil  (freqEnd   * binsPerHz);
+
+        // narrower than a bin (low end): the column shows its nearest bin
+        if (binEnd <= binStart)
+        {
+            binStart = roundToInt (0.5f * (freqStart + freqEnd) * binsPerHz);
+            binEnd   = binStart + 1;
+        }
+
+        binStart = jlimit (0, lastBin, binStart);
+        binEnd   = jlimit (binStart + 1, lastBin + 1, binEnd);
+
+        firstBin[x]    = binStart;
+        numOfBins[x]   = binEnd - binStart;
+        binPosition[x] = jlimit (0.0f, (float) lastBin, 0.5f * (freqStart + freqEnd) * binsPerHz);
+    }
+}
+
+void pixelReductionTable::reduce (const float* values, reductionType type, float* pixelValues, bool interpolate) const
+{
+    const int lastBin = getNumOfValues() - 1;
+
+    for (auto x = 0; x < width; ++x)
+    {
+        const float* columnValues = values + firstBin[x];
+        const int n = numOfBins[x];
+
+        if (n == 1)
+        {
+            pixelValues[x] = interpolate ? interpolateAt (values, lastBin, binPosition[x]) : columnValues[0];
+        }
+        else if (type == maxReduction && interpolate)
+        {
+            const int peak = firstBin[x] + (int) (std::max_element (columnValues, columnValues + n) - columnValues);
+            pixelValues[x] = interpolatePeak (values, lastBin, peak);
+        }
+        else if (type == maxReduction)
+        {
+            pixelValues[x] = FloatVectorOperations::findMaximum (columnValues, n);
+        }
+        else
+        {
+            float sum[4] = { 0, 0, 0, 0 };
+            int i = 0;
+            for (; i + 4 <= n; i += 4)
+                for (auto k = 0; k < 4; ++k)
+                    sum[k] += columnValues[i + k] * columnValues[i + k];
+            for (; i < n; ++i)
+                sum[0] += columnValues[i] * columnValues[i];
+
+            pixelValues[x] = std::sqrt ((sum[0] + sum[1] + sum[2] + sum[3]) / n);
+        }
+    }
+}
+
+float pixelReductionTable::interpolateAt (const float* values, int lastBin, float position)
+{
+    if (lastBin < 2)
+        return values[jlimit (0, lastBin, roundToInt (position))];
+
+    // quadratic through the nearest bin and its neighbours, d is -0.5 .. 0.5 away from it
+    const int k = jlimit (1, lastBin - 1, roundToInt (position));
+    const float d = position - k;
+    const float below = values[k - 1], centre = values[k], above = values[k + 1];
+
+    return centre + 0.5f * d * (above - below) + 0.5f * d * d * (above - 2.0f * centre + below);
+}
+
+float pixelReductionTable::interpolatePeak (const float* values, int lastBin, int peak)
+{
+    if (peak <= 0 || peak >= lastBin)
+        return values[peak];
+
+    const float below = values[peak - 1], centre = values[peak], above = values[peak + 1];
+    const float curvature = below - 2.0f * centre + above;
+
+    // only a local maximum has a vertex within half a bin
+    if (centre < below || centre < above || curvature >= 0.0f)
+        return centre;
+
+    const float offset = 0.5f * (below - above) / curvature;
+    return centre - 0.25f * (below - above) * offset;
+}
+
+//==============================================================================
+// HALF-BAND DECIMATOR
+namespace
+{
+    struct halfBandCoefficients
+    {
+        halfBandCoefficients()
+        {
+            const int centre = halfBandDecimator::numOfTaps / 2;
+            double sum = 0;
+            for (int i = 0; i < halfBandDecimator::numOfTaps; ++i)
+            {
+                const int offset = i - centre;
+                const double sinc = offset == 0 ? 0.5 : std::sin (double_Pi * offset / 2) / (double_Pi * offset);
+                const double phase = 2 * double_Pi * i / (halfBandDecimator::numOfTaps - 1);
+                const double blackman = 0.42 - 0.5 * std::cos (phase) + 0.08 * std::cos (2 * phase);
+                h[i] = (float) (sinc * blackman);
+                sum += h[i];
+            }
+            for (auto& tap : h)
+                tap = (float) (tap / sum);
+        }
+
+        float h[halfBandDecimator::numOfTaps];
+    };
+}
+
+int halfBandDecimator::process (float* samples, int numOfSamples)
+{
+    static const halfBandCoefficients coefficients;
+    const float* h = coefficients.h;
+    const int centre = numOfTaps / 2;
+    const int numOfOutputs = getNumOfOutputs (numOfSamples);
+
+    // reads x[2m .. 2m + numOfTaps - 1] before it writes x[m], in place is safe
+    for (int m = 0; m < numOfOutputs; ++m)
+    {
+        const float* x = samples + 2 * m;
+        float sum = h[centre] * x[centre];
+        for (int j = 1; j <= centre; j += 2)
+            sum += h[centre + j] * (x[centre - j] + x[centre + j]);
+        samples[m] = sum;
+    }
+    return numOfOutputs;
+}
+
+//==============================================================================
+// MULTI-RESOLUTION TABLE
+void multiResolutionTable::build (int newFftSize, int newSampleRate, int newNumOfBands)
+{
+    fftSize    = newFftSize;
+    sampleRate = newSampleRate;
+    numOfBands = jlimit (1, (int) maxNumOfBands, newNumOfBands);
+    numOfPoints = jmin ((int) maxNumOfPoints, fftSize / 2 + 1);
+
+    firstBin  .assign (numOfPoints, 0);
+    numOfBins .assign (numOfPoints, 1);
+    for (int band = 0; band < maxNumOfBands; ++band)
+        bandFirstPoint[band] = bandNumOfPoints[band] = 0;
+    if (sampleRate <= 0 || fftSize <= 0)
+        return;
+
+    const int lastBin = fftSize / 2;
+    const float logRange = std::log ((sampleRate / 2.f) / 10.f);
+
+    for (int point = 0; point < numOfPoints; ++point)
+    {
+        const float freqStart = 10.f * std::exp (logRange * point / numOfPoints);
+        const float freqEnd   = 10.f * std::exp (logRange * (point + 1) / numOfPoints);
+
+        int band = 0;
+        for (int k = numOfBands - 1; k > 0; --k)
+        {
+            if (freqEnd <= sampleRate / (4.0f * (1 << k)))
+            {
+                band = k;
+                break;
+            }
+        }
+
+        // the same bin ranges as pixelReductionTable, in the bins of the decimated band
+        const float binsPerHz = fftSize * (1 << band) / (float) sampleRate;
+        int binStart = (int) std::ceil (freqStart * binsPerHz);
+        int binEnd   = (int) std::ceil (freqEnd   * binsPerHz);
+        if (binEnd <= binStart)
+        {
+            binStart = roundToInt (0.5f * (freqStart + freqEnd) * binsPerHz);
+            binEnd   = binStart + 1;
+        }
+
+        binStart = jlimit (0, lastBin, binStart);
+        binEnd   = jlimit (binStart + 1, lastBin + 1, binEnd);
+
+        firstBin[point]  = binStart;
+        numOfBins[point] = binEnd - binStart;
+
+        if (bandNumOfPoints[band]++ == 0)
+            bandFirstPoint[band] = point;
+    }
+}
+
+//==============================================================================
+// FREQUENCY BAND TABLE
+void frequencyBandTable::build (bandScaleType newScale, int newFftSize, int newSampleRate)
+{
+    scale      = newScale;
+    fftSize    = newFftSize;
+    sampleRate = newSampleRate;
+
+    firstBin        .clear();
+    numOfBins       .clear();
+    centreFrequency .clear();
+    if (sampleRate <= 0 || fftSize <= 0)
+        return;
+
+    const double binWidth = sampleRate / (double) fftSize;
+    const double nyquist  = sampleRate / 2.0;
+    const int lastBin = fftSize / 2;
+
+    auto getUpperEdge = [newScale] (double lowerEdge)
+    {
+        if (newScale == thirdOctaveBands)
+            return lowerEdge * std::pow (2.0, 1.0 / 3.0);
+
+        // one step on the ERB-rate scale: 21.4 * log10 (1 + 0.00437 * f)
+        const double erbRate = 21.4 * std::log10 (1.0 + 0.00437 * lowerEdge) + 1.0;
+        return (std::pow (10.0, erbRate / 21.4) - 1.0) / 0.00437;
+    };
+
+    double lowerEdge = 20.0;
+    double bandLowerEdge = lowerEdge;
+    int bin = jmax (1, (int) std::ceil (lowerEdge / binWidth));
+
+    while (bin <= lastBin)
+    {
+        const double upperEdge = jmin (nyquist, getUpperEdge (lowerEdge));
+        const int endBin = upperEdge >= nyquist ? lastBin + 1 : jmin (lastBin + 1, (int) std::ceil (upperEdge / binWidth));
+
+        if (endBin > bin)
+        {
+            firstBin        .push_back (bin);
+            numOfBins       .push_back (endBin - bin);
+            centreFrequency .push_back ((float) std::sqrt (bandLowerEdge * upperEdge));
+            bin = endBin;
+            bandLowerEdge = upperEdge;
+        }
+        lowerEdge = upperEdge;
+    }
+}
+
+//==============================================================================
+// POINT DENSITY BUFFER
+void pointDensityBuffer::setSize (int newWidth, int newHeight)
+{
+    width  = jmax (0, newWidth);
+    height = jmax (0, newHeight);
+    density.assign ((size_t) (width * height), 0.0f);
+}
+
+void pointDensityBuffer::splat (const float* x, const float* y, int numOfPoints, float scale, float weight)
+{
+    const float centreX = width  * 0.5f;
+    const float centreY = height * 0.5f;
+
+    for (int start = 0; start < numOfPoints; start += batchSize)
+    {
+        const int n = jmin ((int) batchSize, numOfPoints - start);
+
+        // onto the pixel grid, vectorised, zoom and centre are one multiply-add per coordinate
+        FloatVectorOperations::copyWithMultiply (batchX, x + start, -scale, n);
+        FloatVectorOperations::add (batchX, centreX, n);
+        FloatVectorOperations::copyWithMultiply (batchY, y + start, -scale, n);
+        FloatVectorOperations::add (batchY, centreY, n);
+
+        for (int i = 0; i < n; ++i)
+        {
+            const float px = batchX[i], py = batchY[i];
+            if (px >= 0 && px < width && py >= 0 && py < height)
+                density[(size_t) ((int) py * width + (int) px)] += weight;
+        }
+    }
+}
+
+void pointDensityBuffer::toneMap (const pointDensityBuffer& back, Colour backColour, const pointDensityBuffer& front, Colour frontColour,
+                                  float exposure, Image::BitmapData& bitmap)
+{
+    jassert (back.matches (front.width, front.height));
+    const int width  = jmin (back.width,  bitmap.width);
+    const int height = jmin (back.height, bitmap.height);
+
+    const float backRed  = backColour.getFloatRed()  * 255.0f, backGreen  = backColour.getFloatGreen()  * 255.0f, backBlue  = backColour.getFloatBlue()  * 255.0f;
+    const float frontRed = frontColour.getFloatRed() * 255.0f, frontGreen = frontColour.getFloatGreen() * 255.0f, frontBlue = frontColour.getFloatBlue() * 255.0f;
+
+    for (int y = 0; y < height; ++y)
+    {
+        const float* backDensity  = back.density.data()  + y * back.width;
+        const float* frontDensity = front.density.data() + y * front.width;
+        uint8* line = bitmap.getLinePointer (y);
+
+        for (int x = 0; x < width; ++x)
+        {
+            const float b = backDensity[x]  * exposure;
+            const float f = frontDensity[x] * exposure;
+            const float backLevel  = b / (1.0f + b);
+            const float frontLevel = f / (1.0f + f);
+
+            reinterpret_cast<PixelRGB*> (line + x * bitmap.pixelStride)
+                -> setARGB (255, (uint8) jmax (backRed   * backLevel, frontRed   * frontLevel),
+                                 (uint8) jmax (backGreen * backLevel, frontGreen * frontLevel),
+                                 (uint8) jmax (backBlue  * backLevel, frontBlue  * frontLevel));
+        }
+    }
+}
+
+//==============================================================================
+// TRANSFER FUNCTION
+void transferFunctionType::setSize (int newNumOfBins)
+{
+    powerPre  .assign (newNumOfBins, 0.0f);
+    powerPost .assign (newNumOfBins, 0.0f);
+    crossRe   .assign (newNumOfBins, 0.0f);
+    crossIm   .assign (newNumOfBins, 0.0f);
+}
+
+void transferFunctionType::reset()
+{
+    std::fill (powerPre.begin(),  powerPre.end(),  0.0f);
+    std::fill (powerPost.begin(), powerPost.end(), 0.0f);
+    std::fill (crossRe.begin(),   crossRe.end(),   0.0f);
+    std::fill (crossIm.begin(),   crossIm.end(),   0.0f);
+}
+
+void transferFunctionType::addFrame (const float* averagePre, const float* averagePost, const float* crossSpectrum, float smoothing)
+{
+    // the estimates are ratios of these sums, so the ramp up after a reset cancels out
+    const float weight = 1.0f - smoothing;
+    for (int bin = 0; bin < getNumOfBins(); ++bin)
+    {
+        powerPre[bin]  = smoothing * powerPre[bin]  + weight * averagePre[2 * bin]  * averagePre[2 * bin];
+        powerPost[bin] = smoothing * powerPost[bin] + weight * averagePost[2 * bin] * averagePost[2 * bin];
+        crossRe[bin]   = smoothing * crossRe[bin]   + weight * crossSpectrum[2 * bin];
+        crossIm[bin]   = smoothing * crossIm[bin]   + weight * crossSpectrum[2 * bin + 1];
+    }
+}
+
+float transferFunctionType::getBandGain (int firstBin, int numOfBins, estimatorType estimator) const
+{
+    float sumPre = 0, sumPost = 0, sumRe = 0, sumIm = 0;
+    for (int bin = firstBin; bin < firstBin + numOfBins; ++bin)
+    {
+        sumPre  += powerPre[bin];
+        sumPost += powerPost[bin];
+        sumRe   += crossRe[bin];
+        sumIm   += crossIm[bin];
+    }
+
+    const float cross = std::hypot (sumRe, sumIm);
+    const float denominator = estimator == h1Estimator ? sumPre : cross;
+    if (denominator <= 1.0e-20f)
+        return 0.0f;
+
+    return (estimator == h1Estimator ? cross : sumPost) / denominator;
+}
+
+float transferFunctionType::getBandPhase (int firstBin, int numOfBins) const
+{
+    float sumRe = 0, sumIm = 0;
+    for (int bin = firstBin; bin < firstBin + numOfBins; ++bin)
+    {
+        sumRe += crossRe[bin];
+        sumIm += crossIm[bin];
+    }
+    return std::atan2 (sumIm, sumRe);
+}
+
+float transferFunctionType::getCoherence (int bin) const
+{
+    if (powerPre[bin] <= 1.0e-20f || powerPost[bin] <= 1.0e-20f)
+        return 0.0f;
+
+    // divided one by one, the product of two small powers would underflow
+    return jmin (1.0f, (crossRe[bin] * crossRe[bin] + crossIm[bin] * crossIm[bin]) / powerPre[bin] / powerPost[bin]);
+}
+
+//==============================================================================
+// STFT ANALYSER
+STFTAnalyser::STFTAnalyser (int fS, int sR, AudioBufferManagement& buffManag, forwardFFT& fFFT)
+:
+mainAudioBufferSystem (buffManag),
+forwFFT (fFFT),
+fftSize (fS),
+windowLength (fS),
+requestedFFTSizeAt (fS),
+zeroPaddingAt (1),
+overlapAt (50),
+multiResolutionAt (false),
+sampleRate (sR)
+{
+    changeFFTSize (fS, fS);
+}
+
+STFTAnalyser::~STFTAnalyser()
+{
+}
+
+bool STFTAnalyser::processNextFrame()
+{
+    // the pre & post transforms run once per hop of the audio clock, every
+    // spectral view reads the same published frame afterwards.
+    audioBufferManagementType& post = mainAudioBufferSystem.bufferPost;
+    const int64 numOfWrittenSamples = post.numOfWrittenSamples.load();
+    const int hopSize = jmax (1, roundToInt (windowLength * (1.0 - overlapAt.load() / 100.0)));
+
+    // the newest window comes first after a (re)start or a reset of the history
+    if (nextWindowEnd < 0 || nextWindowEnd > numOfWrittenSamples + hopSize)
+        nextWindowEnd = numOfWrittenSamples;
+
+    // the oldest window must still be inside the history, and a frame does a bounded amount of work
+    const int maxBacklog = jmin (maxNumOfWindowsPerFrame - 1, (post.historyBuffer.getNumSamples() / 2 - windowLength) / hopSize) * hopSize;
+    if (numOfWrittenSamples - nextWindowEnd > maxBacklog)
+        nextWindowEnd = numOfWrittenSamples - jmax (0, maxBacklog);
+
+    if (nextWindowEnd > numOfWrittenSamples)
+        return false;
+
+    // every frame is still held: the windows wait for the next frame, the backlog above bounds them
+    std::shared_ptr<spectrumFrameType> frame = getFreeFrame();
+    if (frame == nullptr)
+        return false;
+
+    powerSumPre  .clear();
+    powerSumPost .clear();
+    crossSum     .clear();
+
+    int numOfWindows = 0;
+    for (; nextWindowEnd <= numOfWrittenSamples; nextWindowEnd += hopSize)
+    {
+        const float delay = (float) (numOfWrittenSamples - nextWindowEnd);
+        transformBuffer (mainAudioBufferSystem.bufferPre,  delay, frame->binsPre,  powerSumPre);
+        transformBuffer (post,                             delay, frame->binsPost, powerSumPost);
+        accumulateCrossSpectrum (frame->binsPre, frame->binsPost);
+        ++numOfWindows;
+    }
+
+    // Welch: the mean power of the windows, as magnitudes in the real part
+    auto writeAverage = [numOfWindows] (const AudioBuffer<float>& powerSums, AudioBuffer<float>& average)
+    {
+        const float normalisation = 1.0f / numOfWindows;
+        for (int channel = 0; channel < spectrumFrameType::numOfChannelTypes; ++channel)
+        {
+            const float* powers = powerSums.getReadPointer (channel);
+            float* values = average.getWritePointer (channel);
+            for (int bin = 0; bin < powerSums.getNumSamples(); ++bin)
+            {
+                values[2 * bin]     = std::sqrt (powers[bin] * normalisation);
+                values[2 * bin + 1] = 0.0f;
+            }
+        }
+    };
+    writeAverage (powerSumPre,  frame->averagePre);
+    writeAverage (powerSumPost, frame->averagePost);
+    for (int channel = 0; channel < spectrumFrameType::numOfChannelTypes; ++channel)
+        FloatVectorOperations::multiply (frame->crossSpectrum.getWritePointer (channel), crossSum.getReadPointer (channel),
+                                         1.0f / numOfWindows, crossSum.getNumSamples());
+    frame->numOfAveragedWindows = numOfWindows;
+
+    frame->numOfLogPoints = 0;
+    if (multiResolution)
+        processMultiResolution (*frame);
+    frame->frameIndex = numOfFrames++;
+
+    std::atomic_store (&latestFrame, spectrumFramePtr (frame));
+    return true;
+}
+
+STFTAnalyser::spectrumFramePtr STFTAnalyser::getLatestFrame() const
+{
+    return std::atomic_load (&latestFrame);
+}
+
+void STFTAnalyser::changeFFTSize (int newSize, int newWindowLength)
+{
+    fftSize = newSize;
+    windowLength = newWindowLength;
+    forwFFT.changeFFTSize (newSize, newWindowLength);
+
+    const int numOfChannels = mainAudioBufferSystem.bufferPre.historyBuffer.getNumChannels();
+    fftBuffer.setSize (numOfChannels, 2 * fftSize);
+    powerSumPre  .setSize (spectrumFrameType::numOfChannelTypes, fftSize / 2 + 1);
+    powerSumPost .setSize (spectrumFrameType::numOfChannelTypes, fftSize / 2 + 1);
+    crossSum     .setSize (spectrumFrameType::numOfChannelTypes, 2 * (fftSize / 2 + 1));
+
+    std::atomic_store (&latestFrame, spectrumFramePtr());
+    framePool.clear();
+    for (auto i = 0; i < 3; ++i)
+    {
+        framePool.push_back (std::make_shared<spectrumFrameType>());
+        framePool.back()->setSize (fftSize, windowLength);
+    }
+    nextWindowEnd = -1;
+
+    if (multiResolution)
+        prepareMultiResolution();
+}
+
+void STFTAnalyser::setFFTSize (int newSize)
+{
+    requestedFFTSizeAt.store (newSize);
+    forwFFT.preparePlan (jmin ((int) forwardFFT::maxFFTSize, newSize * zeroPaddingAt.load()), newSize);
+}
+
+void STFTAnalyser::setZeroPadding (int factor)
+{
+    zeroPaddingAt.store (jmax (1, factor));
+    setFFTSize (requestedFFTSizeAt.load());
+}
+
+void STFTAnalyser::prepareFrame()
+{
+    const int requestedLength = requestedFFTSizeAt.load();
+    const int requestedSize   = jmax (requestedLength, jmin ((int) forwardFFT::maxFFTSize, requestedLength * zeroPaddingAt.load()));
+    
+    if ((requestedSize != fftSize || requestedLength != windowLength) && forwFFT.preparePlan (requestedSize, requestedLength))
+        changeFFTSize (requestedSize, requestedLength);
+
+    if (multiResolutionAt.load() != multiResolution)
+    {
+        multiResolution = ! multiResolution;
+        if (multiResolution)
+            prepareMultiResolution();
+    }
+}
+
+void STFTAnalyser::prepareMultiResolution()
+{
+    // as many bands as the history holds the span for: every band below the first
+    // needs the span of the band above it after one more decimation
+    const int maxSpanLength = mainAudioBufferSystem.bufferPost.historyBuffer.getNumSamples() / 2;
+    int numOfBands = 1;
+    spanLength = windowLength;
+    for (; numOfBands < multiResolutionTable::maxNumOfBands; ++numOfBands)
+    {
+        const int longerSpan = halfBandDecimator::getNumOfInputs (spanLength);
+        if (longerSpan > maxSpanLength)
+            break;
+        spanLength = longerSpan;
+    }
+
+    resolutionTable.build (fftSize, sampleRate, numOfBands);
+
+    const int numOfChannels = mainAudioBufferSystem.bufferPre.historyBuffer.getNumChannels();
+    for (int tap = 0; tap < 2; ++tap)
+    {
+        decimationBuffers[tap] .setSize (numOfChannels, spanLength);
+        bandBuffers[tap]       .setSize (numOfChannels, 2 * fftSize);
+    }
+}
+
+void STFTAnalyser::processMultiResolution (spectrumFrameType& frame)
+{
+    audioBufferManagementType* taps[2] = { &mainAudioBufferSystem.bufferPre, &mainAudioBufferSystem.bufferPost };
+    for (int tap = 0; tap < 2; ++tap)
+        taps[tap]->copyDelayedSamplesFromHistoryBuffer (decimationBuffers[tap], spanLength, taps[tap]->getAlignmentDelay());
+
+    // every band takes the newest window of the span, decimated once more than the band above
+    int length = spanLength;
+    for (int band = 0; band < resolutionTable.numOfBands; ++band)
+    {
+        for (int tap = 0; tap < 2; ++tap)
+        {
+            AudioBuffer<float>& samples = decimationBuffers[tap];
+            AudioBuffer<float>& bins    = bandBuffers[tap];
+            bins.clear();
+
+            for (int channel = 0; channel < samples.getNumChannels(); ++channel)
+            {
+                if (band > 0)
+                    halfBandDecimator::process (samples.getWritePointer (channel), length);
+
+                const int numOfOutputs = band > 0 ? halfBandDecimator::getNumOfOutputs (length) : length;
+                FloatVectorOperations::copy (bins.getWritePointer (channel), samples.getReadPointer (channel, numOfOutputs - windowLength), windowLength);
+            }
+            forwFFT.performFFT (bins);
+        }
+
+        if (band > 0)
+            length = halfBandDecimator::getNumOfOutputs (length);
+        writeBandPoints (band, frame);
+    }
+    frame.numOfLogPoints = resolutionTable.numOfPoints;
+}
+
+void STFTAnalyser::writeBandPoints (int band, spectrumFrameType& frame)
+{
+    const int numOfChannels = bandBuffers[0].getNumChannels();
+    const float* binsL[2] = { bandBuffers[0].getReadPointer (0), bandBuffers[1].getReadPointer (0) };
+    const float* binsR[2] = { bandBuffers[0].getReadPointer (numOfChannels > 1 ? 1 : 0), bandBuffers[1].getReadPointer (numOfChannels > 1 ? 1 : 0) };
+
+    auto writePoint = [] (const float* l, const float* r, int point, AudioBuffer<float>& values, AudioBuffer<float>& average)
+    {
+        const float re[spectrumFrameType::numOfChannelTypes] = { l[0], r[0], 0.5f * (l[0] + r[0]), 0.5f * (l[0] - r[0]) };
+        const float im[spectrumFrameType::numOfChannelTypes] = { l[1], r[1], 0.5f * (l[1] + r[1]), 0.5f * (l[1] - r[1]) };
+        for (int channel = 0; channel < spectrumFrameType::numOfChannelTypes; ++channel)
+        {
+            values.getWritePointer (channel)[2 * point]      = re[channel];
+            values.getWritePointer (channel)[2 * point + 1]  = im[channel];
+            average.getWritePointer (channel)[2 * point]     = std::sqrt (re[channel] * re[channel] + im[channel] * im[channel]);
+            average.getWritePointer (channel)[2 * point + 1] = 0.0f;
+        }
+    };
+
+    const int firstPoint = resolutionTable.bandFirstPoint[band];
+    for (int point = firstPoint; point < firstPoint + resolutionTable.bandNumOfPoints[band]; ++point)
+    {
+        // the loudest bin of the range over both taps and channels, every channel reads that
+        // bin, so the difference and phase views compare the same frequency before and after
+        const int binStart = resolutionTable.firstBin[point];
+        int loudestBin = binStart;
+        float loudestPower = -1.0f;
+        for (int bin = binStart; bin < binStart + resolutionTable.numOfBins[point]; ++bin)
+        {
+            float power = 0.0f;
+            for (int tap = 0; tap < 2; ++tap)
+                power += binsL[tap][2 * bin] * binsL[tap][2 * bin] + binsL[tap][2 * bin + 1] * binsL[tap][2 * bin + 1]
+                       + binsR[tap][2 * bin] * binsR[tap][2 * bin] + binsR[tap][2 * bin + 1] * binsR[tap][2 * bin + 1];
+
+            if (power > loudestPower)
+            {
+                loudestPower = power;
+                loudestBin = bin;
+            }
+        }
+
+        writePoint (binsL[0] + 2 * loudestBin, binsR[0] + 2 * loudestBin, point, frame.logBinsPre,  frame.logAveragePre);
+        writePoint (binsL[1] + 2 * loudestBin, binsR[1] + 2 * loudestBin, point, frame.logBinsPost, frame.logAveragePost);
+
+        // a band holds a single window, its cross spectrum is that of the point's bins
+        for (int channel = 0; channel < spectrumFrameType::numOfChannelTypes; ++channel)
+        {
+            const float* pre  = frame.logBinsPre.getReadPointer  (channel) + 2 * point;
+            const float* post = frame.logBinsPost.getReadPointer (channel) + 2 * point;
+            float* cross = frame.logCrossSpectrum.getWritePointer (channel) + 2 * point;
+            cross[0] = pre[0] * post[0] + pre[1] * post[1];
+            cross[1] = pre[0] * post[1] - pre[1] * post[0];
+        }
+    }
+}
+
+std::shared_ptr<spectrumFrameType> STFTAnalyser::getFreeFrame()
+{
+    // a frame only referenced by the pool is neither published nor held by a reader
+    for (auto& frame : framePool)
+        if (frame.use_count() == 1)
+            return frame;
+
+    // the pool is filled in changeFFTSize(), a new frame here would allocate inside the frame's check
+    return nullptr;
+}
+
+void STFTAnalyser::transformBuffer (audioBufferManagementType& buffer, float delay, AudioBuffer<float>& bins, AudioBuffer<float>& powerSums)
+{
+    const int numOfChannels = fftBuffer.getNumChannels();
+    const int numOfValues   = bins.getNumSamples();
+
+    fftBuffer.clear();
+    buffer.copyDelayedSamplesFromHistoryBuffer (fftBuffer, windowLength, buffer.getAlignmentDelay() + delay);
+    forwFFT.performFFT (fftBuffer);
+
+    const float* binsL = fftBuffer.getReadPointer (0);
+    const float* binsR = fftBuffer.getReadPointer (numOfChannels > 1 ? 1 : 0);
+
+    // the transform is linear, mid & side come straight from the L/R bins
+    FloatVectorOperations::copy     (bins.getWritePointer (spectrumFrameType::left),  binsL, numOfValues);
+    FloatVectorOperations::copy     (bins.getWritePointer (spectrumFrameType::right), binsR, numOfValues);
+    FloatVectorOperations::add      (bins.getWritePointer (spectrumFrameType::mid),   binsL, binsR, numOfValues);
+    FloatVectorOperations::multiply (bins.getWritePointer (spectrumFrameType::mid),   0.5f, numOfValues);
+    FloatVectorOperations::subtract (bins.getWritePointer (spectrumFrameType::side),  binsL, binsR, numOfValues);
+    FloatVectorOperations::multiply (bins.getWritePointer (spectrumFrameType::side),  0.5f, numOfValues);
+
+    for (int channel = 0; channel < spectrumFrameType::numOfChannelTypes; ++channel)
+    {
+        const float* values = bins.getReadPointer (channel);
+        float* powers = powerSums.getWritePointer (channel);
+        for (int bin = 0; bin < powerSums.getNumSamples(); ++bin)
+            powers[bin] += values[2 * bin] * values[2 * bin] + values[2 * bin + 1] * values[2 * bin + 1];
+    }
+}
+
+void STFTAnalyser::accumulateCrossSpectrum (const AudioBuffer<float>& binsPre, const AudioBuffer<float>& binsPost)
+{
+    // conj (x) * y: the phase of the sum is that of post relative to pre
+    for (int channel = 0; channel < spectrumFrameType::numOfChannelTypes; ++channel)
+    {
+        const float* x = binsPre.getReadPointer  (channel);
+        const float* y = binsPost.getReadPointer (channel);
+        float* sums = crossSum.getWritePointer (channel);
+        for (int value = 0; value < crossSum.getNumSamples(); value += 2)
+        {
+            sums[value]     += x[value] * y[value]     + x[value + 1] * y[value + 1];
+            sums[value + 1] += x[value] * y[value + 1] - x[value + 1] * y[value];
+        }
+    }
+}
+
+//==============================================================================
+// ALIGNMENT ESTIMATOR
+AlignmentEstimator::AlignmentEstimator (int sR, AudioBufferManagement& buffManag)
+:
+mainAudioBufferSystem (buffManag),
+fft (roundToInt (std::log2 ((double) fftSize))),
+sampleRate (jmax (1, sR)),
+numOfSamplesPerMeasurement (jmax (1, sR / 4)),
+window ((size_t) windowSize),
+fftPre ((size_t) (2 * fftSize)),
+fftPost ((size_t) (2 * fftSize)),
+resetRequestedAt (false),
+confidenceAt (0)
+{
+    for (int i = 0; i < windowSize; ++i)
+        window[(size_t) i] = 0.5f - 0.5f * std::cos (2.0f * float_Pi * i / windowSize);
+}
+
+void AlignmentEstimator::prepareFrame()
+{
+    const int numOfChannels = mainAudioBufferSystem.bufferPre.historyBuffer.getNumChannels();
+    if (windowBuffer.getNumChannels() != numOfChannels)
+        windowBuffer.setSize (numOfChannels, windowSize);
+}
+
+void AlignmentEstimator::processData()
+{
+    if (resetRequestedAt.exchange (false))
+    {
+        hasOffset = false;
+        numOfCandidateHits = 0;
+        mainAudioBufferSystem.bufferPre.alignmentOffset.store (0);
+    }
+
+    // a measurement every quarter of a second of new audio is plenty to follow a changing chain
+    const int64 numOfPublishedSamples = mainAudioBufferSystem.captureRing.numOfPublishedSamples.load (std::memory_order_acquire);
+    if (numOfPublishedSamples < lastMeasurementSample)
+        lastMeasurementSample = numOfPublishedSamples;
+    if (numOfPublishedSamples - lastMeasurementSample < numOfSamplesPerMeasurement)
+        return;
+    lastMeasurementSample = numOfPublishedSamples;
+
+    float offset = 0, confidence = 0;
+    const bool isValid = measureOffset (offset, confidence);
+    confidenceAt.store (confidence);
+
+    if (isValid)
+        trackOffset (offset);
+}
+
+bool AlignmentEstimator::measureOffset (float& offset, float& confidence)
+{
+    const int numOfChannels = windowBuffer.getNumChannels();
+
+    // the mono sum of one tap, windowed and zero padded to twice its length against circular wrap
+    auto loadWindow = [this, numOfChannels] (audioBufferManagementType& buffer, float delay, float* data)
+    {
+        buffer.copyDelayedSamplesFromHistoryBuffer (windowBuffer, windowSize, delay);
+        FloatVectorOperations::copy (data, windowBuffer.getReadPointer (0), windowSize);
+        for (int channel = 1; channel < numOfChannels; ++channel)
+            FloatVectorOperations::add (data, windowBuffer.getReadPointer (channel), windowSize);
+
+        float sumOfSquares = 0;
+        for (int i = 0; i < windowSize; ++i)
+            sumOfSquares += data[i] * data[i];
+
+        FloatVectorOperations::multiply (data, window.data(), windowSize);
+        FloatVectorOperations::clear (data + windowSize, 2 * fftSize - windowSize);
+        return std::sqrt (sumOfSquares / windowSize) / numOfChannels;
+    };
+
+    // pre is read at the reported latency, what is left to find is the error of the report
+    const int reportedDelay = mainAudioBufferSystem.bufferPre.processorDelay.load();
+    if (loadWindow (mainAudioBufferSystem.bufferPre, (float) reportedDelay, fftPre.data()) < minSignalRms
+     || loadWindow (mainAudioBufferSystem.bufferPost, 0.0f, fftPost.data()) < minSignalRms)
+        return false;
+
+    fft.performRealOnlyForwardTransform (fftPre.data(),  true);
+    fft.performRealOnlyForwardTransform (fftPost.data(), true);
+
+    // cross spectrum conj (pre) * post, whitened (PHAT): only the phase carries the delay,
+    // so a filtering plugin does not smear the peak. Bins without energy stay out of it.
+    const int numOfBins = fftSize / 2;
+    const int firstBin  = jmax (1, (int) std::ceil (20.0 * fftSize / sampleRate));
+    float* cross = fftPre.data();
+    const float* post = fftPost.data();
+    float maxMagnitude = 0;
+
+    for (int bin = firstBin; bin < numOfBins; ++bin)
+    {
+        const float preRe = cross[2 * bin], preIm = cross[2 * bin + 1];
+        const float postRe = post[2 * bin], postIm = post[2 * bin + 1];
+        cross[2 * bin]     = preRe * postRe + preIm * postIm;
+        cross[2 * bin + 1] = preRe * postIm - preIm * postRe;
+        maxMagnitude = jmax (maxMagnitude, std::hypot (cross[2 * bin], cross[2 * bin + 1]));
+    }
+
+    FloatVectorOperations::clear (cross, 2 * firstBin);
+    FloatVectorOperations::clear (cross + 2 * numOfBins, 2 * fftSize - 2 * numOfBins);
+
+    for (int bin = firstBin; bin < numOfBins; ++bin)
+    {
+        const float magnitude = std::hypot (cross[2 * bin], cross[2 * bin + 1]);
+        const float weight = magnitude > 1.0e-4f * maxMagnitude ? 1.0f / magnitude : 0.0f;
+        cross[2 * bin]     *= weight;
+        cross[2 * bin + 1] *= weight;
+    }
+
+    fft.performRealOnlyInverseTransform (cross);
+
+    // lag n > 0: post comes n samples later than the reported latency says
+    auto getCorrelation = [cross] (int lag) { return std::abs (cross[(lag + fftSize) % fftSize]); };
+
+    int peakLag = 0;
+    float peak = 0, sumOfSquares = 0;
+    for (int lag = -maxLag; lag <= maxLag; ++lag)
+    {
+        const float value = getCorrelation (lag);
+        sumOfSquares += value * value;
+        if (value > peak)
+        {
+            peak = value;
+            peakLag = lag;
+        }
+    }
+
+    const float rms = std::sqrt (sumOfSquares / (2 * maxLag + 1));
+    confidence = rms > 0 ? peak / rms : 0.0f;
+
+    // a peak at the edge of the search range lies outside of it
+    if (confidence < minPeakToRms || std::abs (peakLag) == maxLag)
+        return false;
+
+    // sub-sample position of the peak from the parabola through it and its neighbours
+    const float before = getCorrelation (peakLag - 1), after = getCorrelation (peakLag + 1);
+    const float curvature = before - 2.0f * peak + after;
+    const float shift = curvature < 0 ? jlimit (-0.5f, 0.5f, 0.5f * (before - after) / curvature) : 0.0f;
+
+    offset = peakLag + shift;
+    return true;
+}
+
+void AlignmentEstimator::trackOffset (float offset)
+{
+    if (hasOffset && std::abs (offset - trackedOffset) <= maxTrackingStep)
+    {
+        // the same delay measured again, follow it slowly
+        trackedOffset += trackingRatio * (offset - trackedOffset);
+        numOfCandidateHits = 0;
+    }
+    else if (numOfCandidateHits > 0 && std::abs (offset - candidateOffset) <= maxTrackingStep)
+    {
+        // a new delay is only taken over once it was measured a few times in a row
+        candidateOffset = offset;
+        if (++numOfCandidateHits >= numOfHitsToJump)
+        {
+            trackedOffset = candidateOffset;
+            hasOffset = true;
+            numOfCandidateHits = 0;
+        }
+    }
+    else
+    {
+        candidateOffset = offset;
+        numOfCandidateHits = 1;
+    }
+
+    if (hasOffset)
+        mainAudioBufferSystem.bufferPre.alignmentOffset.store (trackedOffset);
+}
+
+//==============================================================================
+// ANALYSIS THREAD
+AnalysisThread::AnalysisThread (AudioBufferManagement& buffManag, STFTAnalyser& stft, AsyncUpdater& callback)
+:
+Thread ("Analysis Thread"),
+mainAudioBufferSystem (buffManag),
+stftAnalyser (stft),
+frameReadyCallback (callback),
+hopSizeAt (2048),
+pausedAt (false)
+{
+}
+
+AnalysisThread::~AnalysisThread()
+{
+    stopThread (2000);
+}
+
+void AnalysisThread::run()
+{
+    while (! threadShouldExit())
+    {
+        wait (clockPollIntervalMs);
+        if (threadShouldExit())
+            break;
+
+        const int64 numOfPublishedSamples = mainAudioBufferSystem.captureRing.numOfPublishedSamples.load (std::memory_order_acquire);
+        if (numOfPublishedSamples < lastFrameSample) // the capture ring was reset
+            lastFrameSample = numOfPublishedSamples;
+
+        if (pausedAt.load() || numOfPublishedSamples - lastFrameSample < hopSizeAt.load())
+            continue;
+
+        lastFrameSample = numOfPublishedSamples;
+
+        {
+            const ScopedLock sl (clientLock);
+
+            stftAnalyser.prepareFrame();
+            for (auto* client : clients)
+                client->prepareFrame();
+
+            const ScopedFrameAllocationCheck allocationCheck;
+            ignoreUnused (allocationCheck);
+
+            mainAudioBufferSystem.pushAudioBufferIntoHistoryBuffer();
+            stftAnalyser.processNextFrame();
+
+            for (auto* client : clients)
+                client->processData();
+        }
+        frameReadyCallback.triggerAsyncUpdate();
+    }
+}
+
+void AnalysisThread::addClient (AnalysisClient* client)
+{
+    const ScopedLock sl (clientLock);
+    clients.addIfNotAlreadyThere (client);
+}
+
+void AnalysisThread::removeClient (AnalysisClient* client)
+{
+    const ScopedLock sl (clientLock);
+    clients.removeFirstMatchingValue (client);
+}
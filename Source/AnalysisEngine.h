@@ -0,0 +1,536 @@
+#pragma once
+#include "JuceHeader.h"
+#include "AudioBufferManagement.h"
+#include "SpectrumKernel.h"
+
+/** When enabled, every analysis frame asserts that it did not touch the heap and every
+    view paint that it did not allocate per point, as far as the allocations of a thread
+    can be counted (see ScopedFrameAllocationCheck). */
+#ifndef CHANNELSTRIP_CHECK_FRAME_ALLOCATIONS
+ #define CHANNELSTRIP_CHECK_FRAME_ALLOCATIONS JUCE_DEBUG
+#endif
+
+//==============================================================================
+/** Lock-free hand-over of render data between one writer and one reader thread.
+    The writer fills getWriteBuffer() and calls publish(); the reader always gets
+    the most recently published buffer, neither side ever waits for the other.
+    The writer sizes getWriteBuffer() before it fills it; the other two may be in the
+    reader's hands, they are sized when they come up for writing.
+*/
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : middleState (1) {}
+
+    T& getWriteBuffer()             { return buffers[writeIndex]; }
+
+    void publish()
+    {
+        const int oldMiddle = middleState.exchange (writeIndex | newDataFlag, std::memory_order_acq_rel);
+        writeIndex = oldMiddle & indexMask;
+    }
+
+    const T& getReadBuffer()
+    {
+        if (middleState.load (std::memory_order_relaxed) & newDataFlag)
+        {
+            const int oldMiddle = middleState.exchange (readIndex, std::memory_order_acq_rel);
+            readIndex = oldMiddle & indexMask;
+        }
+        return buffers[readIndex];
+    }
+
+private:
+    enum { indexMask = 3, newDataFlag = 4 };
+
+    T buffers[3];
+    int writeIndex = 0;
+    int readIndex  = 2;
+    std::atomic<int> middleState;
+};
+
+//==============================================================================
+struct spectrumFrameType
+{
+    enum channelType { left = 0, right, mid, side, numOfChannelTypes };
+
+    // Complex bins (re, im interleaved, 0..fftSize/2) of the newest pre and post windows.
+    // fftSize is the transform length, windowLength the samples it covers, the rest is zero padding.
+    // A published frame is never written again, readers can keep it as long as they need.
+    AudioBuffer<float> binsPre;
+    AudioBuffer<float> binsPost;
+
+    // Welch average of every window since the previous frame, in the same layout:
+    // sqrt (mean |X|^2) in the real part and a zero imaginary part, so a magnitude
+    // reader takes it exactly like the bins of a single window.
+    AudioBuffer<float> averagePre;
+    AudioBuffer<float> averagePost;
+
+    // Welch average of conj (pre) * post over the same windows, (re, im) interleaved:
+    // with the two averages above the transfer function and coherence of the frame.
+    AudioBuffer<float> crossSpectrum;
+
+    // Multi-resolution points (see multiResolutionTable) of the newest data, in the same
+    // two layouts; numOfLogPoints is 0 while the mode is off.
+    AudioBuffer<float> logBinsPre;
+    AudioBuffer<float> logBinsPost;
+    AudioBuffer<float> logAveragePre;
+    AudioBuffer<float> logAveragePost;
+    AudioBuffer<float> logCrossSpectrum;
+
+    int fftSize   = 0;
+    int windowLength = 0;
+    int numOfBins = 0;
+    int numOfLogPoints = 0;
+    int numOfAveragedWindows = 0;
+    int64 frameIndex = 0;
+
+    void setSize (int newFftSize, int newWindowLength);
+    const float* getBinsPre  (int channel) const { return binsPre.getReadPointer  (channel); }
+    const float* getBinsPost (int channel) const { return binsPost.getReadPointer (channel); }
+    const float* getAveragePre  (int channel) const { return averagePre.getReadPointer  (channel); }
+    const float* getAveragePost (int channel) const { return averagePost.getReadPointer (channel); }
+    const float* getCrossSpectrum (int channel) const { return crossSpectrum.getReadPointer (channel); }
+
+    // what the log frequency views read: the multi-resolution points when there are any
+    int getViewNumOfBins() const                         { return numOfLogPoints > 0 ? numOfLogPoints : numOfBins; }
+    const float* getViewBinsPre     (int channel) const  { return (numOfLogPoints > 0 ? logBinsPre     : binsPre)     .getReadPointer (channel); }
+    const float* getViewBinsPost    (int channel) const  { return (numOfLogPoints > 0 ? logBinsPost    : binsPost)    .getReadPointer (channel); }
+    const float* getViewAveragePre  (int channel) const  { return (numOfLogPoints > 0 ? logAveragePre  : averagePre)  .getReadPointer (channel); }
+    const float* getViewAveragePost (int channel) const  { return (numOfLogPoints > 0 ? logAveragePost : averagePost) .getReadPointer (channel); }
+    const float* getViewCrossSpectrum (int channel) const { return (numOfLogPoints > 0 ? logCrossSpectrum : crossSpectrum) .getReadPointer (channel); }
+};
+
+//==============================================================================
+/** Maps the FFT bins onto the pixel columns of a log frequency axis (10 Hz .. fs/2).
+    Every column owns a contiguous bin range, so reducing a column looks at every bin
+    that falls into it instead of sampling one of them. The cost only depends on the
+    number of bins, the path drawn from it on the width. With numOfLogPoints the values
+    are multi-resolution points, already spaced on the same log axis as the columns.
+    With interpolation (values in dB), a column narrower than a bin reads the parabola
+    through the three bins nearest to its centre instead of stepping from bin to bin,
+    and the loudest bin of a wider column is raised to the vertex of the parabola through
+    it and its neighbours, so a sine between two bins keeps its level.
+*/
+struct pixelReductionTable
+{
+    enum reductionType { maxReduction, powerMeanReduction };
+
+    void build (int newWidth, int newFftSize, int newSampleRate, int newNumOfLogPoints = 0);
+    bool matches (int w, int fS, int sR, int lP = 0) const
+    {
+        return w == width && fS == fftSize && sR == sampleRate && lP == numOfLogPoints;
+    }
+    int getNumOfValues() const              { return numOfLogPoints > 0 ? numOfLogPoints : fftSize / 2 + 1; }
+
+    void reduce (const float* values, reductionType type, float* pixelValues, bool interpolate = false) const;
+
+    static float interpolateAt   (const float* values, int lastBin, float position);
+    static float interpolatePeak (const float* values, int lastBin, int peak);
+
+    std::vector<int> firstBin;
+    std::vector<int> numOfBins;
+    std::vector<float> binPosition;     // fractional bin at the column centre
+    int width = 0;
+    int fftSize = 0;
+    int sampleRate = 0;
+    int numOfLogPoints = 0;
+};
+
+//==============================================================================
+/** Halves the sample rate with a 23 tap half-band FIR (Blackman windowed sinc): flat up
+    to a quarter of the output rate, and what would alias into that range is stopped.
+    Every other tap is zero, so an output costs seven multiplies.
+*/
+struct halfBandDecimator
+{
+    enum { numOfTaps = 23 };
+
+    /** In place: output m is the sum of h[j] * x[2m + j], written over the start of the
+        samples. Returns the number of outputs. */
+    static int process (float* samples, int numOfSamples);
+
+    static int getNumOfOutputs (int numOfInputs)    { return numOfInputs < numOfTaps ? 0 : (numOfInputs - numOfTaps) / 2 + 1; }
+    static int getNumOfInputs (int numOfOutputs)    { return 2 * (numOfOutputs - 1) + numOfTaps; }
+};
+
+//==============================================================================
+/** Layout of the multi-resolution spectrum: numOfPoints log-spaced points from 10 Hz to
+    fs / 2, the axis of the spectral views. Band k is an FFT of the history decimated by
+    2^k, so every octave further down gets twice the resolution. A point is read from the
+    finest band whose clean pass band (a quarter of the band's rate) reaches the point's
+    upper edge: band 0 for the top two octaves, one octave per band below, the last band
+    for everything under it. The points of a band are contiguous.
+*/
+struct multiResolutionTable
+{
+    enum { maxNumOfBands = 5, maxNumOfPoints = 1024 };
+
+    void build (int newFftSize, int newSampleRate, int newNumOfBands);
+    bool matches (int fS, int sR, int nB) const     { return fS == fftSize && sR == sampleRate && nB == numOfBands; }
+
+    std::vector<int> firstBin;              // per point, in the bins of its band
+    std::vector<int> numOfBins;
+    int bandFirstPoint[maxNumOfBands] = {};
+    int bandNumOfPoints[maxNumOfBands] = {};
+    int numOfPoints = 0;
+    int numOfBands = 0;
+    int fftSize = 0;
+    int sampleRate = 0;
+};
+
+//==============================================================================
+/** Groups the FFT bins into perceptual bands, third octaves or ERBs (Glasberg & Moore),
+    from 20 Hz up to fs / 2. Every band owns a contiguous, non-empty bin range; at low
+    frequencies, where a band is narrower than a bin, it is merged into the next one.
+*/
+struct frequencyBandTable
+{
+    enum bandScaleType { thirdOctaveBands = 0, erbBands };
+
+    void build (bandScaleType newScale, int newFftSize, int newSampleRate);
+    bool matches (bandScaleType s, int fS, int sR) const { return s == scale && fS == fftSize && sR == sampleRate; }
+    int getNumOfBands() const               { return (int) firstBin.size(); }
+
+    std::vector<int> firstBin;
+    std::vector<int> numOfBins;
+    std::vector<float> centreFrequency;    // geometric centre of the band's edges
+    bandScaleType scale = thirdOctaveBands;
+    int fftSize = 0;
+    int sampleRate = 0;
+};
+
+//==============================================================================
+/** Float density image of a point cloud (the vectorscope). Points come in as separate
+    x / y arrays, are moved onto the pixel grid and clipped a batch at a time, and only
+    add their weight to one float per pixel. toneMap() turns two layers into pixels
+    in a single pass, so neither the number of points nor their weights touch the bitmap.
+*/
+struct pointDensityBuffer
+{
+    void setSize (int newWidth, int newHeight);
+    bool matches (int w, int h) const       { return w == width && h == height; }
+
+    void clear()                            { FloatVectorOperations::clear (density.data(), (int) density.size()); }
+    void decay (float factor)               { FloatVectorOperations::multiply (density.data(), factor, (int) density.size()); }
+
+    /** Adds weight at (width / 2 - x * scale, height / 2 - y * scale) for every point inside the image. */
+    void splat (const float* x, const float* y, int numOfPoints, float scale, float weight);
+
+    /** Writes every pixel of an RGB bitmap: each layer's colour scaled by d * e / (1 + d * e), the brighter one wins. */
+    static void toneMap (const pointDensityBuffer& back, Colour backColour, const pointDensityBuffer& front, Colour frontColour,
+                         float exposure, Image::BitmapData& bitmap);
+
+    std::vector<float> density;
+    int width = 0;
+    int height = 0;
+
+private:
+    enum { batchSize = 256 };
+    float batchX[batchSize];
+    float batchY[batchSize];
+};
+
+//==============================================================================
+/** Sliding window correlation sum (L * R) / sqrt (sum (L * L) * sum (R * R)) of a
+    stream. Every sample is added exactly once: the three sums are accumulated with SIMD
+    a block at a time into a ring of block sums, and the window is the sum of the last
+    numOfBlocks complete blocks. A frame costs only its new samples, the window is
+    rectangular, and the window sum is rebuilt from the ring once per revolution so
+    rounding never piles up over a long session.
+*/
+struct streamingCorrelationType
+{
+    struct blockSumsType
+    {
+        double lr = 0, ll = 0, rr = 0;
+    };
+
+    void setSize (int newNumOfBlocks, int newBlockSize);
+    void reset();
+    void addSamples (const float* left, const float* right, int numOfSamples);
+
+    /** -1 .. 1 over the last getWindowLength() samples, 0 while either side is silent. */
+    float getCorrelation() const;
+    int getWindowLength() const             { return numOfBlocks * blockSize; }
+
+    static void accumulate       (const float* left, const float* right, int numOfSamples, blockSumsType& sums);
+    static void accumulateScalar (const float* left, const float* right, int numOfSamples, blockSumsType& sums);
+
+private:
+    void completeBlock();
+
+    std::vector<blockSumsType> blockSums;
+    blockSumsType windowSums;
+    blockSumsType partialSums;
+    int numOfBlocks = 0;
+    int blockSize = 0;
+    int numOfPartialSamples = 0;
+    int nextBlock = 0;
+};
+
+//==============================================================================
+/** Transfer function from the pre (x) to the post (y) tap, per bin, from auto and cross
+    spectra averaged recursively over the frames; a frame weighs 1 - smoothing. Noise on
+    the post tap averages out of Sxy, so H1 = Sxy / Sxx stays unbiased by it, H2 = Syy / Syx
+    does the same for noise on the pre tap. The coherence |Sxy|^2 / (Sxx * Syy) tells how
+    far either is linear: 1 for a plain filter, towards 0 for distortion, noise or time variance.
+*/
+struct transferFunctionType
+{
+    enum estimatorType { h1Estimator = 0, h2Estimator };
+
+    void setSize (int newNumOfBins);
+    void reset();
+
+    /** One frame: the Welch averages (magnitude in the real part) and the cross spectrum of spectrumFrameType. */
+    void addFrame (const float* averagePre, const float* averagePost, const float* crossSpectrum, float smoothing);
+
+    /** |H|, 0 where the estimator has nothing to divide by. */
+    float getGain (int bin, estimatorType estimator) const     { return getBandGain (bin, 1, estimator); }
+    /** arg H in radians, post relative to pre. */
+    float getPhase (int bin) const          { return std::atan2 (crossIm[bin], crossRe[bin]); }
+
+    /** |H| and arg H of a band, from the spectra summed over its bins before they are divided. */
+    float getBandGain  (int firstBin, int numOfBins, estimatorType estimator) const;
+    float getBandPhase (int firstBin, int numOfBins) const;
+    float getCoherence (int bin) const;
+    int getNumOfBins() const                { return (int) powerPre.size(); }
+
+private:
+    std::vector<float> powerPre;
+    std::vector<float> powerPost;
+    std::vector<float> crossRe;
+    std::vector<float> crossIm;
+};
+
+//==============================================================================
+/** Streaming STFT of the pre and post histories. Windows start every hop (fftSize times
+    1 - overlap) of the audio clock, and every window since the previous frame is
+    transformed, so every sample reaches the spectra whatever the frame rate. A frame
+    publishes the newest window's complex bins, the Welch average of all of them and
+    their averaged cross spectrum, which costs no transform of its own.
+*/
+class STFTAnalyser
+{
+public:
+    typedef AudioBufferManagement::audioBufferManagementType audioBufferManagementType;
+    typedef std::shared_ptr<const spectrumFrameType> spectrumFramePtr;
+
+    STFTAnalyser (int fftSize, int sampleRate, AudioBufferManagement& mainAudioBufferSystem, forwardFFT& fFFT);
+    ~STFTAnalyser();
+
+    /** Returns false when no new window was due, the latest frame stays as it is. */
+    bool processNextFrame();
+    spectrumFramePtr getLatestFrame() const;
+
+    /** Any thread: asks for a new FFT size, the window length. Its plan is built in the
+        background, the current size keeps running until prepareFrame() finds the plan ready. */
+    void setFFTSize (int newSize);
+
+    /** Any thread: the transform is this many times longer than the window (1, 2, 4 ...),
+        up to forwardFFT::maxFFTSize. Interpolates the spectrum, it adds no resolution. */
+    void setZeroPadding (int factor);
+
+    /** Analysis thread, before the frame's allocation check: switches to a requested size
+        whose plan is ready. The views follow in their own prepareFrame(). */
+    void prepareFrame();
+
+    /** Any thread: adds the multi-resolution points to every frame from the next one on. */
+    void setMultiResolution (bool shouldBeOn)   { multiResolutionAt.store (shouldBeOn); }
+
+    /** Analysis thread: the transform size of the frames processNextFrame() publishes. */
+    int getFFTSize() const                      { return fftSize; }
+    int getWindowLength() const                 { return windowLength; }
+    int getNumOfLogPoints() const               { return multiResolution ? resolutionTable.numOfPoints : 0; }
+
+    /** Any thread: overlap of successive windows in percent (0, 50, 75 ...), used from the next frame on. */
+    void setOverlap (int overlapPercent)        { overlapAt.store (jlimit (0, 95, overlapPercent)); }
+    void setWindowType (forwardFFT::windowType type)   { forwFFT.windowTypeAt.store (type); }
+
+private:
+    void changeFFTSize (int newSize, int newWindowLength);
+    std::shared_ptr<spectrumFrameType> getFreeFrame();    // nullptr when every frame is still in use
+    void transformBuffer (audioBufferManagementType& buffer, float delay, AudioBuffer<float>& bins, AudioBuffer<float>& powerSums);
+    void accumulateCrossSpectrum (const AudioBuffer<float>& binsPre, const AudioBuffer<float>& binsPost);
+    void prepareMultiResolution();
+    void processMultiResolution (spectrumFrameType& frame);
+    void writeBandPoints (int band, spectrumFrameType& frame);
+
+    AudioBufferManagement& mainAudioBufferSystem;
+    forwardFFT& forwFFT;
+
+    int fftSize;
+    int windowLength;
+    std::atomic<int> requestedFFTSizeAt;
+    std::atomic<int> zeroPaddingAt;
+    std::atomic<int> overlapAt;
+    std::atomic<bool> multiResolutionAt;
+    const int sampleRate;
+    int64 nextWindowEnd = -1;          // audio clock sample at which the next window ends
+    int64 numOfFrames = 0;
+
+    AudioBuffer<float> fftBuffer;
+    AudioBuffer<float> powerSumPre;    // |X|^2 summed over the windows of the frame
+    AudioBuffer<float> powerSumPost;
+    AudioBuffer<float> crossSum;       // conj (pre) * post summed over the windows of the frame
+
+    // multi-resolution: the newest span of both taps, decimated in place band by band,
+    // and the transform of the current band
+    bool multiResolution = false;
+    multiResolutionTable resolutionTable;
+    int spanLength = 0;
+    AudioBuffer<float> decimationBuffers[2];
+    AudioBuffer<float> bandBuffers[2];
+
+    // a frame after a long pause only takes the newest windows, the cost of a frame stays bounded
+    static constexpr int maxNumOfWindowsPerFrame = 32;
+    std::vector<std::shared_ptr<spectrumFrameType>> framePool;
+    spectrumFramePtr latestFrame;
+};
+
+//==============================================================================
+class AnalysisClient
+{
+public:
+    virtual ~AnalysisClient() {}
+
+    /** Called on the analysis thread before processData(). The only place where a
+        client may (re)size its frame buffers, e.g. after a sample-rate or mode change. */
+    virtual void prepareFrame() {}
+
+    /** Called on the analysis thread, does the DSP and publishes the render data.
+        Must work inside the buffers sized beforehand, it is not allowed to allocate. */
+    virtual void processData() = 0;
+};
+
+//==============================================================================
+/** Measures how far the post tap really lags the pre tap, beyond the latency the chain
+    reports, with a GCC-PHAT cross-correlation of the two histories. A new value is only
+    taken over after a few measurements agree, small drifts are smoothed, and the result
+    goes to the pre history as a fractional alignmentOffset, so every view reads aligned
+    pre samples even when a plugin reports the wrong latency.
+*/
+class AlignmentEstimator : public AnalysisClient
+{
+public:
+    typedef AudioBufferManagement::audioBufferManagementType audioBufferManagementType;
+
+    AlignmentEstimator (int sampleRate, AudioBufferManagement& mainAudioBufferSystem);
+
+    void prepareFrame() override;
+    void processData() override;
+
+    /** Any thread: forgets the estimate, the reported latency is used until a new one is found. */
+    void reset()                            { resetRequestedAt.store (true); }
+
+    float getOffset() const                 { return mainAudioBufferSystem.bufferPre.alignmentOffset.load(); }
+    float getConfidence() const             { return confidenceAt.load(); }   // peak to rms of the last correlation
+
+private:
+    bool measureOffset (float& offset, float& confidence);
+    void trackOffset (float offset);
+
+    enum { windowSize = 8192, fftSize = 2 * windowSize, maxLag = windowSize / 4 };
+
+    AudioBufferManagement& mainAudioBufferSystem;
+    dsp::FFT fft;
+    const int sampleRate;
+    const int numOfSamplesPerMeasurement;
+
+    AudioBuffer<float> windowBuffer;
+    std::vector<float> window;
+    std::vector<float> fftPre;
+    std::vector<float> fftPost;
+
+    int64 lastMeasurementSample = 0;
+    bool hasOffset = false;
+    float trackedOffset = 0;
+    float candidateOffset = 0;
+    int numOfCandidateHits = 0;
+
+    std::atomic<bool> resetRequestedAt;
+    std::atomic<float> confidenceAt;
+
+    static constexpr float minPeakToRms    = 8.0f;     // a clear peak, not a noise correlation
+    static constexpr float minSignalRms    = 1.0e-4f;  // -80 dBFS, silence says nothing about the delay
+    static constexpr float maxTrackingStep = 1.0f;     // samples, larger changes need new agreement
+    static constexpr float trackingRatio   = 0.25f;
+    static constexpr int   numOfHitsToJump = 3;
+};
+
+//==============================================================================
+/** Debug check that the heap is not used on this thread during its lifetime.
+    The plugin never replaces operator new, it would take over the allocator of every
+    plugin it hosts. Its debug builds count through the system allocator's own hook
+    instead (malloc_logger on macOS, the debug CRT's allocation hook on Windows); where
+    there is none, the check does nothing unless an executable installs its own counter.
+*/
+struct ScopedFrameAllocationCheck
+{
+   #if CHANNELSTRIP_CHECK_FRAME_ALLOCATIONS
+    typedef int64 (*allocationCounterType)();    // allocations of the calling thread so far
+
+    ScopedFrameAllocationCheck();
+
+    /** Message thread, around a view's createFrame(). JUCE's software renderer allocates
+        scratch for every path it fills or strokes, so a paint may allocate. It must not
+        allocate per point or bin: a paint may need at most a fixed slack more than the
+        most any earlier paint of the view needed. */
+    explicit ScopedFrameAllocationCheck (int64& maxNumOfPaintAllocations);
+
+    ~ScopedFrameAllocationCheck();
+
+    /** Any thread, before the analysis runs: replaces the allocator hook's counter.
+        nullptr switches the check off. */
+    static void setAllocationCounter (allocationCounterType newCounter);
+
+private:
+    static std::atomic<allocationCounterType> counterAt;
+    static constexpr int64 paintAllocationSlack = 128;
+
+    const allocationCounterType counter;
+    const int64 numOfAllocationsAtStart;
+    int64* const maxNumOfPaintAllocations;
+   #else
+    ScopedFrameAllocationCheck() {}
+    explicit ScopedFrameAllocationCheck (int64&) {}
+   #endif
+};
+
+//==============================================================================
+class AnalysisThread : public Thread
+{
+public:
+    AnalysisThread (AudioBufferManagement& mainAudioBufferSystem, STFTAnalyser& stftAnalyser, AsyncUpdater& frameReadyCallback);
+    ~AnalysisThread();
+
+    void run() override;
+
+    void addClient    (AnalysisClient* client);
+    void removeClient (AnalysisClient* client);
+    
+    /** A frame is analysed every time this many new samples have been published by the
+        audio thread. Nothing runs, and nothing is repainted, while no audio arrives. */
+    void setHopSize (int numOfSamples)      { hopSizeAt.store (jmax (1, numOfSamples)); }
+    void setPaused  (bool shouldBePaused)   { pausedAt.store (shouldBePaused); }
+
+    /** Held while a frame is analysed, lock it to change the clients or the STFT setup. */
+    CriticalSection& getLock() { return clientLock; }
+
+private:
+    AudioBufferManagement& mainAudioBufferSystem;
+    STFTAnalyser& stftAnalyser;
+    AsyncUpdater& frameReadyCallback;
+
+    CriticalSection clientLock;
+    Array<AnalysisClient*> clients;
+    
+    std::atomic<int> hopSizeAt;
+    std::atomic<bool> pausedAt;
+    int64 lastFrameSample = 0;
+    
+    // how often the audio clock is looked at, the audio thread itself never signals us
+    static constexpr int clockPollIntervalMs = 5;
+};
@@ -0,0 +1,590 @@
+#include "AudioBufferManagement.h"
+
+//==============================================================================
+AudioBufferManagement::AudioBufferManagement (int channels, int maxBlockSize, int sizeCaptureRing, int sizeHistoryBuffer)
+:
+captureRing (channels, maxBlockSize, 1),
+bufferPre  (channels, sizeHistoryBuffer, "bufferPre", threadMutex),
+bufferPost (channels, sizeHistoryBuffer, "bufferPost", threadMutex)
+{
+    visualizersSemaphore.store(0);
+    reset (channels, maxBlockSize, sizeCaptureRing, sizeHistoryBuffer);
+}
+
+void AudioBufferManagement::pushAudioBufferIntoHistoryBuffer()
+{
+    std::lock_guard<std::mutex> lock (threadMutex);
+    
+    // pre and post travel in the same ring slot, so both history buffers always
+    // receive exactly the same blocks and stay sample aligned.
+    const int numOfChannels = captureRing.numOfChannels;
+    int numOfSamples = 0;
+    
+    while (captureRing.readNextBlock (captureReadBuffer, numOfSamples))
+    {
+        bufferPre  .writeBlockIntoHistoryBuffer (captureReadBuffer, 0,             numOfSamples);
+        bufferPost .writeBlockIntoHistoryBuffer (captureReadBuffer, numOfChannels, numOfSamples);
+    }
+}
+
+void AudioBufferManagement::reset(int newChannel, int newMaxBlockSize, int newSizeCaptureRing, int newSizeHistoryBuffer)
+{
+    std::lock_guard<std::mutex> lock (threadMutex);
+    
+    const int slotSize   = jmax (1, newMaxBlockSize);
+    const int numOfSlots = jmax (8, nextPowerOfTwo (newSizeCaptureRing / slotSize));
+    
+    captureRing.reset (newChannel, slotSize, numOfSlots);
+    captureReadBuffer.setSize (2 * newChannel, slotSize);
+    
+    bufferPre.reset(newChannel, newSizeHistoryBuffer);
+    bufferPost.reset(newChannel, newSizeHistoryBuffer);
+}
+
+namespace
+{
+    // 2^36 steps per full scale square, a single square is limited to 64 (+18 dBFS per sample)
+    // so that the sum over ~2^20 history samples still fits into 64 bit.
+    // Noise floor: every square is rounded to the nearest step, so a sample below 2^-18.5
+    // (about -111 dBFS) adds nothing and a window that stays below it reads as silence.
+    // A louder square is off by half a step at most, under 1 % of it above about -91 dBFS.
+    const double squareSumScale = 68719476736.0;
+    const float maxSquare = 64.0f;
+    
+    inline uint64 toFixedPointSquare (float sample)
+    {
+        return (uint64) std::llround ((double) jmin (sample * sample, maxSquare) * squareSumScale);
+    }
+}
+
+void AudioBufferManagement::audioBufferManagementType::reset(int ch, int sHb)
+{
+    historyBuffer.setSize(ch, sHb > 0 ? sHb : 1);
+    historyBuffer.clear();
+    
+    squareSumPrefix.assign ((size_t) ((historyBuffer.getNumChannels() + 1) * historyBuffer.getNumSamples()), 0);
+    monoMinMax.reset (2 * historyBuffer.getNumSamples());
+    
+    lastSampleIndexHistoryBuffer.store(0);
+    numOfWrittenSamples.store(0);
+}
+
+void AudioBufferManagement::audioBufferManagementType::writeBlockIntoHistoryBuffer(const AudioBuffer<float> &fromBuffer, int firstChannel, int numOfSamples)
+{
+    const int numOfSamplesInBuffer = historyBuffer.getNumSamples();
+    const int numOfChannels = historyBuffer.getNumChannels();
+    const int writeIndex = lastSampleIndexHistoryBuffer.load();
+    
+    const int size1 = jmin (numOfSamples, numOfSamplesInBuffer - writeIndex);
+    const int size2 = numOfSamples - size1;
+    
+    for (int ch = 0; ch < numOfChannels; ++ch)
+    {
+        historyBuffer.copyFrom (ch, writeIndex, fromBuffer, firstChannel + ch, 0, size1);
+        if (size2 > 0)
+            historyBuffer.copyFrom (ch, 0, fromBuffer, firstChannel + ch, size1, size2);
+    }
+    
+    // extend the running sums, continuing from the entry of the newest sample so far
+    const int previousIndex = (writeIndex + numOfSamplesInBuffer - 1) % numOfSamplesInBuffer;
+    const int rightChannel = numOfChannels > 1 ? firstChannel + 1 : firstChannel;
+    
+    for (int row = 0; row <= numOfChannels; ++row)
+    {
+        uint64* prefix = getSquareSumPrefixRow (row);
+        uint64 runningSum = prefix[previousIndex];
+        const bool isMonoRow = row == numOfChannels;
+        const float* channelData = fromBuffer.getReadPointer (isMonoRow ? firstChannel : firstChannel + row);
+        const float* rightData   = fromBuffer.getReadPointer (rightChannel);
+        
+        int index = writeIndex;
+        for (int i = 0; i < numOfSamples; ++i)
+        {
+            runningSum += toFixedPointSquare (isMonoRow ? channelData[i] + rightData[i] : channelData[i]);
+            prefix[index] = runningSum;
+            if (++index == numOfSamplesInBuffer) index = 0;
+        }
+    }
+    
+    monoMinMax.addSamples (fromBuffer.getReadPointer (firstChannel), fromBuffer.getReadPointer (rightChannel), numOfSamples);
+    
+    lastSampleIndexHistoryBuffer.store ((writeIndex + numOfSamples) % numOfSamplesInBuffer);
+    numOfWrittenSamples.store (numOfWrittenSamples.load() + numOfSamples);
+}
+
+void AudioBufferManagement::audioBufferManagementType::copySamplesFromHistoryBuffer(AudioBuffer<float> &toBuffer, int numOfSamples)
+{
+    copyDelayedSamplesFromHistoryBuffer (toBuffer, numOfSamples, getAlignmentDelay());
+}
+
+void AudioBufferManagement::audioBufferManagementType::copyDelayedSamplesFromHistoryBuffer(AudioBuffer<float> &toBuffer, int numOfSamples, float delay)
+{
+    const int procDelay = (int) std::floor (delay);
+    const float fraction = delay - procDelay;
+    const int numOfSamplesInBuffer = historyBuffer.getNumSamples();
+    const int lastSampleIndex = lastSampleIndexHistoryBuffer.load() - procDelay;
+    
+    int firstSampleIndex = lastSampleIndex - numOfSamples;
+    if (firstSampleIndex < 0) firstSampleIndex = numOfSamplesInBuffer + firstSampleIndex;
+    
+    // a fractional delay reads between the samples, the newest one it needs has to be written already
+    if (fraction > 1.0e-3f && procDelay >= 1)
+    {
+        // 4 point Lagrange interpolation at a = 1 - fraction between sample n - 1 and n
+        const float a = 1.0f - fraction;
+        const float c0 = -a * (a - 1.0f) * (a - 2.0f) / 6.0f;
+        const float c1 = (a + 1.0f) * (a - 1.0f) * (a - 2.0f) / 2.0f;
+        const float c2 = -(a + 1.0f) * a * (a - 2.0f) / 2.0f;
+        const float c3 = (a + 1.0f) * a * (a - 1.0f) / 6.0f;
+        
+        for (auto channel = 0; channel < historyBuffer.getNumChannels(); channel++)
+        {
+            const float* history = historyBuffer.getReadPointer (channel);
+            float* samples = toBuffer.getWritePointer (channel);
+            
+            int index = (firstSampleIndex - 2 + numOfSamplesInBuffer) % numOfSamplesInBuffer;
+            float x0 = history[index];
+            if (++index == numOfSamplesInBuffer) index = 0;
+            float x1 = history[index];
+            if (++index == numOfSamplesInBuffer) index = 0;
+            float x2 = history[index];
+            if (++index == numOfSamplesInBuffer) index = 0;
+            
+            for (int i = 0; i < numOfSamples; ++i)
+            {
+                const float x3 = history[index];
+                samples[i] = c0 * x0 + c1 * x1 + c2 * x2 + c3 * x3;
+                x0 = x1; x1 = x2; x2 = x3;
+                if (++index == numOfSamplesInBuffer) index = 0;
+            }
+        }
+        return;
+    }
+    
+    if ( firstSampleIndex + numOfSamples > numOfSamplesInBuffer)
+    {
+        int size1 = numOfSamplesInBuffer - firstSampleIndex;
+        int size2 = numOfSamples - size1;
+        for (auto channel = 0; channel < historyBuffer.getNumChannels(); channel++)
+        {
+            toBuffer.copyFrom(channel, 0, historyBuffer, channel, firstSampleIndex, size1);
+            toBuffer.copyFrom(channel, size1, historyBuffer, channel, 0, size2);
+        }
+    }
+    else
+    {
+        for (auto channel = 0; channel < historyBuffer.getNumChannels(); channel++)
+            toBuffer.copyFrom(channel, 0, historyBuffer, channel, firstSampleIndex, numOfSamples);
+    }
+}
+
+float AudioBufferManagement::audioBufferManagementType::getRMSMonoValueInSample(int samplesInThePast, int windowSize)
+{
+    return getRMSFromSquareSumPrefix (samplesInThePast, windowSize, historyBuffer.getNumChannels());
+}
+
+float AudioBufferManagement::audioBufferManagementType::getRMSChannelValueInSample(int samplesInThePast, int windowSize, int channel)
+{
+    return getRMSFromSquareSumPrefix (samplesInThePast, windowSize, jmin (channel, historyBuffer.getNumChannels() - 1));
+}
+
+float AudioBufferManagement::audioBufferManagementType::getRMSFromSquareSumPrefix(int samplesInThePast, int windowSize, int row) const
+{
+    const int numOfSamplesInBuffer = historyBuffer.getNumSamples();
+    windowSize = jlimit (1, numOfSamplesInBuffer - 1, windowSize);
+    
+    // index of the newest sample inside the window and of the newest one before it
+    const int lastSampleIndex = lastSampleIndexHistoryBuffer.load() - roundToInt (getAlignmentDelay()) - samplesInThePast - 1;
+    const int endIndex   = ((lastSampleIndex % numOfSamplesInBuffer) + numOfSamplesInBuffer) % numOfSamplesInBuffer;
+    const int startIndex = (endIndex - windowSize + numOfSamplesInBuffer) % numOfSamplesInBuffer;
+    
+    const uint64* prefix = getSquareSumPrefixRow (row);
+    const uint64 sumOfSquares = prefix[endIndex] - prefix[startIndex];
+    
+    return (float) std::sqrt (sumOfSquares / squareSumScale / windowSize);
+}
+
+int AudioBufferManagement::audioBufferManagementType::getLastIndexPositionInHistoryBuffer()
+{
+    return lastSampleIndexHistoryBuffer.load();
+}
+
+
+//==============================================================================
+void AudioBufferManagement::minMaxPyramidType::reset(int numOfSamplesToCover)
+{
+    for (int level = 0; level < numOfLevels; ++level)
+    {
+        const int numOfEntries = numOfSamplesToCover / getEntrySize (level) + 2;
+        levels[level].assign ((size_t) numOfEntries, Range<float>());
+    }
+    
+    numOfSamples = 0;
+    partialMin = partialMax = 0;
+}
+
+void AudioBufferManagement::minMaxPyramidType::addSamples(const float* left, const float* right, int numOfNewSamples)
+{
+    for (int i = 0; i < numOfNewSamples; ++i)
+    {
+        const float sample = left[i] + right[i];
+        const bool isFirstInEntry = (numOfSamples & (baseEntrySize - 1)) == 0;
+        partialMin = isFirstInEntry ? sample : jmin (partialMin, sample);
+        partialMax = isFirstInEntry ? sample : jmax (partialMax, sample);
+        
+        if ((++numOfSamples & (baseEntrySize - 1)) != 0)
+            continue;
+        
+        int64 entryIndex = numOfSamples / baseEntrySize - 1;
+        levels[0][(size_t) (entryIndex % (int64) levels[0].size())] = Range<float> (partialMin, partialMax);
+        
+        // an entry that completes the last of eight children completes its parent as well
+        for (int level = 1; level < numOfLevels && (entryIndex + 1) % levelRatio == 0; ++level)
+        {
+            const std::vector<Range<float>>& children = levels[level - 1];
+            Range<float> parent = children[(size_t) (entryIndex % (int64) children.size())];
+            for (int64 child = entryIndex - levelRatio + 1; child < entryIndex; ++child)
+                parent = parent.getUnionWith (children[(size_t) (child % (int64) children.size())]);
+            
+            entryIndex /= levelRatio;
+            levels[level][(size_t) (entryIndex % (int64) levels[level].size())] = parent;
+        }
+    }
+}
+
+Range<float> AudioBufferManagement::minMaxPyramidType::getMinMax(int64 firstSample, int64 endSample) const
+{
+    int level = numOfLevels - 1;
+    while (level > 0 && getEntrySize (level) > endSample - firstSample)
+        --level;
+    
+    Range<float> result;
+    bool isEmpty = true;
+    addEntriesInRange (level, firstSample, endSample, result, isEmpty);
+    return result;
+}
+
+void AudioBufferManagement::minMaxPyramidType::addEntriesInRange(int level, int64 firstSample, int64 endSample, Range<float>& result, bool& isEmpty) const
+{
+    const int64 entrySize = getEntrySize (level);
+    const int64 numOfEntries = (int64) levels[level].size();
+    const int64 numOfCompleteEntries = numOfSamples / entrySize;
+    
+    const int64 firstEntry = jmax ((firstSample + entrySize - 1) / entrySize, numOfCompleteEntries - numOfEntries + 1, (int64) 0);
+    
+    for (int64 entry = firstEntry; entry * entrySize < endSample; ++entry)
+    {
+        if (entry < numOfCompleteEntries)
+        {
+            const Range<float>& values = levels[level][(size_t) (entry % numOfEntries)];
+            result = isEmpty ? values : result.getUnionWith (values);
+            isEmpty = false;
+        }
+        else if (level > 0)
+        {
+            // the newest entry is still open, take what its children already hold
+            addEntriesInRange (level - 1, entry * entrySize, jmin (endSample, (entry + 1) * entrySize), result, isEmpty);
+        }
+    }
+}
+
+//==============================================================================
+void AudioBufferManagement::captureRingType::reset(int ch, int sS, int nS)
+{
+    jassert (isPowerOfTwo (nS));
+    
+    numOfChannels = ch;
+    slotSize      = sS;
+    numOfSlots    = nS;
+    
+    slotData.setSize (2 * ch, sS * nS);
+    slotData.clear();
+    
+    slotSequence.reset     (new std::atomic<int64>[nS]);
+    slotNumOfSamples.reset (new int[nS]);
+    for (auto slot = 0; slot < nS; ++slot)
+    {
+        slotSequence[slot].store (-1);
+        slotNumOfSamples[slot] = 0;
+    }
+    
+    numOfPublishedBlocks.store (0);
+    numOfOverrunBlocks.store (0);
+    numOfPublishedSamples.store (0);
+    nextBlockToWrite  = 0;
+    numOfPendingSlots = 0;
+    numOfPendingSamples = 0;
+    nextBlockToRead   = 0;
+}
+
+void AudioBufferManagement::captureRingType::writePreBlock(const AudioBuffer<float> &fromBuffer, int numOfSamples)
+{
+    // invalidating the slots before overwriting them, so a reader that is still
+    // copying one of them notices it on the second sequence check.
+    numOfPendingSlots = jmin (numOfSlots, (numOfSamples + slotSize - 1) / slotSize);
+    numOfPendingSamples = numOfSamples;
+    for (auto i = 0; i < numOfPendingSlots; ++i)
+        slotSequence[(nextBlockToWrite + i) & (numOfSlots - 1)].store (-1, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_release);
+    
+    writeTapIntoSlots (fromBuffer, numOfSamples, 0);
+}
+
+void AudioBufferManagement::captureRingType::writePostBlock(const AudioBuffer<float> &fromBuffer, int numOfSamples)
+{
+    writeTapIntoSlots (fromBuffer, numOfSamples, numOfChannels);
+}
+
+void AudioBufferManagement::captureRingType::publishBlock()
+{
+    for (auto i = 0; i < numOfPendingSlots; ++i)
+    {
+        const int64 block = nextBlockToWrite + i;
+        slotSequence[block & (numOfSlots - 1)].store (block, std::memory_order_release);
+    }
+    nextBlockToWrite += numOfPendingSlots;
+    numOfPendingSlots = 0;
+    
+    numOfPublishedBlocks.store (nextBlockToWrite, std::memory_order_release);
+    numOfPublishedSamples.store (numOfPublishedSamples.load (std::memory_order_relaxed) + numOfPendingSamples, std::memory_order_release);
+    numOfPendingSamples = 0;
+}
+
+void AudioBufferManagement::captureRingType::writeTapIntoSlots(const AudioBuffer<float> &fromBuffer, int numOfSamples, int firstChannel)
+{
+    // blocks bigger than a slot are split, if even the whole ring is too small only the newest samples are kept
+    const int numOfChannelsToCopy = jmin (numOfChannels, fromBuffer.getNumChannels());
+    const int firstSample = jmax (0, numOfSamples - numOfPendingSlots * slotSize);
+    
+    for (auto i = 0; i < numOfPendingSlots; ++i)
+    {
+        const int slot = (int) ((nextBlockToWrite + i) & (numOfSlots - 1));
+        const int offset = firstSample + i * slotSize;
+        const int size = jmin (slotSize, numOfSamples - offset);
+        
+        for (auto ch = 0; ch < numOfChannelsToCopy; ++ch)
+            slotData.copyFrom (firstChannel + ch, slot * slotSize, fromBuffer, ch, offset, size);
+        
+        slotNumOfSamples[slot] = size;
+    }
+}
+
+bool AudioBufferManagement::captureRingType::readNextBlock(AudioBuffer<float> &toBuffer, int &numOfSamples)
+{
+    for (;;)
+    {
+        const int64 numOfPublished = numOfPublishedBlocks.load (std::memory_order_acquire);
+        if (nextBlockToRead >= numOfPublished)
+            return false;
+        
+        // the writer has lapped us, jumping to the middle of the ring leaves room before it laps us again
+        if (numOfPublished - nextBlockToRead > numOfSlots)
+        {
+            const int64 newBlockToRead = numOfPublished - numOfSlots / 2;
+            numOfOverrunBlocks.fetch_add (newBlockToRead - nextBlockToRead, std::memory_order_relaxed);
+            nextBlockToRead = newBlockToRead;
+        }
+        
+        const int slot = (int) (nextBlockToRead & (numOfSlots - 1));
+        
+        const int64 sequenceBefore = slotSequence[slot].load (std::memory_order_acquire);
+        const int size = slotNumOfSamples[slot];
+        for (auto ch = 0; ch < slotData.getNumChannels(); ++ch)
+            toBuffer.copyFrom (ch, 0, slotData, ch, slot * slotSize, size);
+        std::atomic_thread_fence (std::memory_order_acquire);
+        const int64 sequenceAfter = slotSequence[slot].load (std::memory_order_relaxed);
+        
+        if (sequenceBefore == nextBlockToRead && sequenceAfter == nextBlockToRead)
+        {
+            numOfSamples = size;
+            ++nextBlockToRead;
+            return true;
+        }
+        
+        // the slot has been overwritten while copying it, skipping ahead
+        const int64 newBlockToRead = numOfPublishedBlocks.load (std::memory_order_acquire) - numOfSlots / 2;
+        numOfOverrunBlocks.fetch_add (jmax ((int64) 1, newBlockToRead - nextBlockToRead), std::memory_order_relaxed);
+        nextBlockToRead = jmax (nextBlockToRead + 1, newBlockToRead);
+    }
+}
+
+//==============================================================================
+forwardFFT::planType::planType (int size, int length)
+:
+fftSize (size),
+windowLength (jlimit (1, size, length)),
+fft (roundToInt (std::log2 (size))),
+windowTable (numOfWindowTypes, windowLength)
+{
+    // cosine sums: Hann, 4 term Blackman-Harris (-92 dB sidelobes), flat top (amplitude error < 0.01 dB)
+    const double coefficients[numOfWindowTypes][5] =
+    {
+        { 0.5,        0.5,        0.0,         0.0,         0.0 },
+        { 0.35875,    0.48829,    0.14128,     0.01168,     0.0 },
+        { 0.21557895, 0.41663158, 0.277263158, 0.083578947, 0.006947368 }
+    };
+    
+    double hannSum = 0;
+    for (int type = 0; type < numOfWindowTypes; ++type)
+    {
+        float* window = windowTable.getWritePointer (type);
+        double sum = 0;
+        
+        for (auto i = 0; i < windowLength; i++)
+        {
+            const double phase = (2 * juce::double_Pi * i) / jmax (1, windowLength - 1);
+            double value = 0;
+            for (int k = 0; k < 5; ++k)
+                value += (k % 2 == 0 ? 1 : -1) * coefficients[type][k] * std::cos (k * phase);
+            
+            window[i] = (float) value;
+            sum += value;
+        }
+        
+        if (type == hannWindow)
+            hannSum = sum;
+        else if (sum > 0)
+            FloatVectorOperations::multiply (window, (float) (hannSum / sum), windowLength);
+    }
+}
+
+class forwardFFT::PlanJob  : public ThreadPoolJob
+{
+public:
+    PlanJob (forwardFFT& owner, planKey k)
+    : ThreadPoolJob ("FFT plan " + String (k.first)), fFFT (owner), key (k)
+    {
+    }
+    
+    JobStatus runJob() override
+    {
+        planPtr plan = std::make_shared<const planType> (key.first, key.second);
+        
+        {
+            std::lock_guard<std::mutex> lock (fFFT.cacheLock);
+            fFFT.storePlan (key, plan);
+        }
+        fFFT.planBuilt.notify_all();
+        return jobHasFinished;
+    }
+    
+private:
+    forwardFFT& fFFT;
+    const planKey key;
+};
+
+forwardFFT::~forwardFFT()
+{
+    planBuilder.removeAllJobs (true, 5000);
+}
+
+void forwardFFT::performFFT( AudioBuffer<float>& audioBuffer )
+{
+    // a plan is never changed once it is built, holding it is all the locking needed
+    const planPtr plan = std::atomic_load (&currentPlan);
+    const int numOfChannels = audioBuffer.getNumChannels();
+    const int windowType = jlimit (0, numOfWindowTypes - 1, windowTypeAt.load());
+    jassert (audioBuffer.getNumSamples() >= 2 * plan->fftSize);
+    
+    for (auto channel = 0; channel < numOfChannels; channel++)
+    {
+        float* data = audioBuffer.getWritePointer(channel);
+        FloatVectorOperations::multiply (data, plan->windowTable.getReadPointer(windowType), plan->windowLength);
+        
+        if (plan->fftSize <= maxRealOnlySize)
+            plan->fft.performRealOnlyForwardTransform (data);
+        else
+            performComplexTransform (*plan, data);
+    }
+}
+
+void forwardFFT::performComplexTransform (const planType& plan, float* data)
+{
+    jassert (complexSize >= plan.fftSize);
+    
+    for (auto i = 0; i < plan.fftSize; ++i)
+        complexInput[i] = dsp::Complex<float> (data[i], 0.0f);
+    
+    plan.fft.perform (complexInput, complexOutput, false);
+    
+    // same layout as performRealOnlyForwardTransform, only bins 0 .. fftSize / 2 are read
+    for (auto i = 0; i <= plan.fftSize / 2; ++i)
+    {
+        data[2 * i]     = complexOutput[i].real();
+        data[2 * i + 1] = complexOutput[i].imag();
+    }
+}
+
+void forwardFFT::changeFFTSize(int newSize, int windowLength)
+{
+    const planKey key (newSize, windowLength);
+    planPtr plan;
+    {
+        // a pending entry has its PlanJob queued, building the plan here as well would do the work twice
+        std::unique_lock<std::mutex> lock (cacheLock);
+        planBuilt.wait (lock, [&] { auto cached = planCache.find (key); return cached == planCache.end() || cached->second.plan != nullptr; });
+        
+        auto cached = planCache.find (key);
+        if (cached != planCache.end())
+        {
+            markUsed (cached->second);
+            plan = cached->second.plan;
+        }
+    }
+    
+    if (plan == nullptr)
+    {
+        plan = std::make_shared<const planType> (newSize, windowLength);
+        
+        std::lock_guard<std::mutex> lock (cacheLock);
+        storePlan (key, plan);
+    }
+    
+    if (newSize > maxRealOnlySize && newSize > complexSize)
+    {
+        complexInput  .allocate ((size_t) newSize, false);
+        complexOutput .allocate ((size_t) newSize, false);
+        complexSize = newSize;
+    }
+    std::atomic_store (&currentPlan, plan);
+}
+
+bool forwardFFT::preparePlan (int size, int windowLength)
+{
+    const planKey key (size, windowLength);
+    
+    std::lock_guard<std::mutex> lock (cacheLock);
+    auto cached = planCache.find (key);
+    if (cached != planCache.end())
+    {
+        markUsed (cached->second);
+        return cached->second.plan != nullptr;
+    }
+    
+    storePlan (key, nullptr);
+    planBuilder.addJob (new PlanJob (*this, key), true);
+    return false;
+}
+
+void forwardFFT::storePlan (planKey key, planPtr plan)
+{
+    cachedPlanType& stored = planCache[key];
+    stored.plan = plan;
+    markUsed (stored);
+    
+    // pending entries have a job that will fill them and the current plan is about to be
+    // used again, everything else can be rebuilt when it is asked for
+    const planPtr current = std::atomic_load (&currentPlan);
+    while ((int) planCache.size() > maxNumOfCachedPlans)
+    {
+        auto oldest = planCache.end();
+        for (auto it = planCache.begin(); it != planCache.end(); ++it)
+            if (it->second.plan != nullptr && it->second.plan != current && it->first != key
+                && (oldest == planCache.end() || it->second.lastUsed < oldest->second.lastUsed))
+                oldest = it;
+        
+        if (oldest == planCache.end())
+            break;
+        planCache.erase (oldest);
+    }
+}
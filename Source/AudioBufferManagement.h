@@ -0,0 +1,221 @@
+#pragma once
+
+// The engine is shared with the tools: "JuceHeader.h" comes through each project's include
+// path, so every project compiles it with its own AppConfig.
+#include "JuceHeader.h"
+#include <condition_variable>
+#include <map>
+#include <mutex>
+
+//==============================================================================
+class AudioBufferManagement
+{
+private:
+    std::mutex threadMutex;
+public:
+    struct captureRingType
+    {
+        // Wait-free single producer / single consumer ring for the pre & post taps.
+        // Each slot holds the pre and the post samples of the same audio block and is
+        // stamped with its absolute block number once published. The audio thread only
+        // ever publishes: when the reader falls behind, it detects the overrun from the
+        // slot sequence and skips ahead instead of the writer dropping data.
+        AudioBuffer<float> slotData; // channels [0, nC) pre, [nC, 2 * nC) post
+        std::unique_ptr<std::atomic<int64>[]> slotSequence;
+        std::unique_ptr<int[]> slotNumOfSamples;
+        
+        int numOfChannels;
+        int numOfSlots;
+        int slotSize;
+        
+        std::atomic<int64> numOfPublishedBlocks;
+        std::atomic<int64> numOfOverrunBlocks;
+        std::atomic<int64> numOfPublishedSamples; // audio clock, advanced by every published block
+        
+        captureRingType (int ch, int sS, int nS) { reset (ch, sS, nS); }
+        void reset (int ch, int sS, int nS);
+        
+        // audio thread
+        void writePreBlock  ( const AudioBuffer<float> &fromBuffer, int numOfSamples );
+        void writePostBlock ( const AudioBuffer<float> &fromBuffer, int numOfSamples );
+        void publishBlock();
+        
+        // reader thread
+        bool readNextBlock ( AudioBuffer<float> &toBuffer, int &numOfSamples );
+        
+    private:
+        void writeTapIntoSlots ( const AudioBuffer<float> &fromBuffer, int numOfSamples, int firstChannel );
+        
+        int64 nextBlockToWrite = 0;
+        int numOfPendingSlots = 0;
+        int numOfPendingSamples = 0;
+        int64 nextBlockToRead = 0;
+    };
+    
+    struct minMaxPyramidType
+    {
+        // Min / max summary of the mono sum (L + R) at 32, 256 and 2048 samples per entry.
+        // Entry k of a level covers the absolute samples [k * size, (k + 1) * size) and lives
+        // in slot k % numOfEntries, it is written once when its last sample arrives. Coarser
+        // levels are built from the eight entries below them, so every sample is touched once.
+        enum { numOfLevels = 3, baseEntrySize = 32, levelRatio = 8 };
+        
+        void reset (int numOfSamplesToCover);
+        void addSamples (const float* left, const float* right, int numOfSamples);
+        
+        // Union of the entries starting inside [firstSample, endSample), read from the coarsest
+        // level whose entries are not longer than the range. Empty when nothing is summarised.
+        Range<float> getMinMax (int64 firstSample, int64 endSample) const;
+        int64 getNumOfSamples() const { return numOfSamples; }
+        
+    private:
+        static int getEntrySize (int level) { return baseEntrySize << (3 * level); }
+        void addEntriesInRange (int level, int64 firstSample, int64 endSample, Range<float>& result, bool& isEmpty) const;
+        
+        std::vector<Range<float>> levels[numOfLevels];
+        int64 numOfSamples = 0;
+        float partialMin = 0, partialMax = 0;
+    };
+    
+    struct audioBufferManagementType
+    {
+        AudioBuffer<float> historyBuffer;
+        
+        // Running sums of the squared samples, one row per channel plus one for the
+        // mono sum (L + R). Entry i holds the sum up to and including history sample i,
+        // so the energy of any window inside the history is the difference of two entries.
+        // The sums are fixed point and wrap modulo 2^64, which keeps every difference exact.
+        std::vector<uint64> squareSumPrefix;
+        
+        // Summary of the mono waveform, covers twice the history length.
+        minMaxPyramidType monoMinMax;
+        
+        std::atomic<int> lastSampleIndexHistoryBuffer;
+        std::atomic<int64> numOfWrittenSamples;    // since the last reset, lets readers find the samples they have not seen
+        std::atomic<int> processorDelay;
+        std::atomic<float> alignmentOffset; // measured error of processorDelay, in (fractional) samples
+        
+        String name;
+        std::mutex& threadMutex;
+        
+        audioBufferManagementType (int ch, int sHb, String n, std::mutex& tM)
+        : historyBuffer (ch, sHb),
+        lastSampleIndexHistoryBuffer(0),
+        numOfWrittenSamples(0),
+        processorDelay(0),
+        alignmentOffset(0),
+        name(n),
+        threadMutex(tM)
+        {}
+        void reset (int ch, int sHb);
+        void writeBlockIntoHistoryBuffer  ( const AudioBuffer<float> &fromBuffer, int firstChannel, int numOfSamples );
+        void copySamplesFromHistoryBuffer ( AudioBuffer<float> &toBuffer, int numOfSamples );
+        void copyDelayedSamplesFromHistoryBuffer ( AudioBuffer<float> &toBuffer, int numOfSamples, float delay );
+        float getAlignmentDelay() const { return jmax (0.0f, processorDelay.load() + alignmentOffset.load()); }
+        float getRMSMonoValueInSample (int samplesInThePast, int windowSize);
+        float getRMSChannelValueInSample (int samplesInThePast, int windowSize, int channel);
+        int getLastIndexPositionInHistoryBuffer();
+        
+    private:
+        float getRMSFromSquareSumPrefix (int samplesInThePast, int windowSize, int row) const;
+        const uint64* getSquareSumPrefixRow (int row) const { return squareSumPrefix.data() + row * historyBuffer.getNumSamples(); }
+        uint64* getSquareSumPrefixRow (int row) { return squareSumPrefix.data() + row * historyBuffer.getNumSamples(); }
+    };
+    
+    std::atomic<int> visualizersSemaphore;
+    captureRingType captureRing;
+    audioBufferManagementType bufferPre;
+    audioBufferManagementType bufferPost;
+
+    AudioBufferManagement (int channels, int maxBlockSize, int sizeCaptureRing, int sizeHistoryBuffer );
+    ~AudioBufferManagement(){};
+    void pushAudioBufferIntoHistoryBuffer();
+    void reset(int newChannel, int newMaxBlockSize, int newSizeCaptureRing, int newSizeHistoryBuffer);
+    
+private:
+    AudioBuffer<float> captureReadBuffer;
+};
+
+//==============================================================================
+struct forwardFFT
+{
+    enum windowType { hannWindow = 0, blackmanHarrisWindow, flatTopWindow, numOfWindowTypes };
+    
+    /** Everything a transform of one size needs. Built once, never changed afterwards,
+        so the analysis thread can use it without a lock while others are being built.
+        The window covers the first windowLength samples, the rest of the transform is
+        zero padding. */
+    struct planType
+    {
+        planType (int fftSize, int windowLength);
+        
+        const int fftSize;
+        const int windowLength;
+        const dsp::FFT fft;
+        // One row per window type, each scaled to the coherent gain of the Hann window, so a
+        // sine reads the same magnitude whichever window is selected.
+        AudioBuffer<float> windowTable;
+    };
+    typedef std::shared_ptr<const planType> planPtr;
+    
+    std::atomic<int> windowTypeAt;
+
+    forwardFFT (int fS)
+    :
+    windowTypeAt(hannWindow),
+    planBuilder(1)
+    {
+        changeFFTSize (fS, fS);
+    }
+    ~forwardFFT();
+    
+    /** Analysis thread: transforms every channel in place with the current plan. */
+    void performFFT( AudioBuffer<float>& audioBuffer);
+    
+    /** Analysis thread, or before it runs: switches to the plan of this size. Waits for
+        it when preparePlan() is building it already, builds it first when nobody is. */
+    void changeFFTSize( int newSize, int windowLength);
+    
+    /** Any thread: starts building the plan of this size on a background thread.
+        Returns true when it is cached already, changeFFTSize() will not block then. */
+    bool preparePlan (int size, int windowLength);
+    
+    int getFFTSize() const          { return std::atomic_load (&currentPlan)->fftSize; }
+    int getWindowLength() const     { return std::atomic_load (&currentPlan)->windowLength; }
+    
+    // Above this size the real-only transform of JUCE's fallback engine takes its scratch
+    // space from the heap, those sizes run the complex transform on preallocated buffers.
+    enum { maxRealOnlySize = 16384, maxFFTSize = 131072 };
+    
+    // Every size and window length the user steps through would stay cached otherwise,
+    // the least recently used plans beyond this are dropped.
+    enum { maxNumOfCachedPlans = 8 };
+    
+private:
+    class PlanJob;
+    typedef std::pair<int, int> planKey;    // fftSize, windowLength
+    
+    struct cachedPlanType
+    {
+        planPtr plan;           // nullptr while the plan is being built
+        int64 lastUsed = 0;
+    };
+    
+    /** Callers hold cacheLock. */
+    void storePlan (planKey key, planPtr plan);
+    void markUsed (cachedPlanType& cached)  { cached.lastUsed = ++numOfCacheUses; }
+    void performComplexTransform (const planType& plan, float* data);
+    
+    std::mutex cacheLock;
+    std::condition_variable planBuilt;
+    std::map<planKey, cachedPlanType> planCache;
+    int64 numOfCacheUses = 0;
+    planPtr currentPlan;
+    
+    // analysis thread, sized by changeFFTSize()
+    HeapBlock<dsp::Complex<float>> complexInput;
+    HeapBlock<dsp::Complex<float>> complexOutput;
+    int complexSize = 0;
+    
+    ThreadPool planBuilder;
+};
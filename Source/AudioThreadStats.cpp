@@ -0,0 +1,234 @@
+#include "AudioThreadStats.h"
+
+//==============================================================================
+// TIMING HISTOGRAM
+timingHistogramType::timingHistogramType()
+: numOfValues (0),
+  sumNs (0),
+  minNs (0),
+  maxNs (0),
+  resetRequested (false)
+{
+    for (auto& count : counts)
+        count.store (0);
+}
+
+int timingHistogramType::getBucket (int64 ns)
+{
+    if (ns < 1)
+        return 0;
+
+    // two buckets per octave: the highest set bit, then the bit below it
+    int highestBit = 0;
+    for (uint64 value = (uint64) ns; value > 1; value >>= 1)
+        ++highestBit;
+
+    const int halfOctave = highestBit > 0 ? (int) ((ns >> (highestBit - 1)) & 1) : 0;
+    return jmin ((int) numOfBuckets - 1, 2 * highestBit + halfOctave);
+}
+
+void timingHistogramType::record (int64 ns)
+{
+    // single writer: plain load / store instead of read-modify-write instructions
+    if (resetRequested.load (std::memory_order_acquire))
+    {
+        for (auto& bucketCount : counts)
+            bucketCount.store (0, std::memory_order_relaxed);
+        sumNs.store (0, std::memory_order_relaxed);
+        minNs.store (0, std::memory_order_relaxed);
+        maxNs.store (0, std::memory_order_relaxed);
+        numOfValues.store (0, std::memory_order_release);
+        resetRequested.store (false, std::memory_order_relaxed);
+    }
+
+    std::atomic<int64>& count = counts[getBucket (ns)];
+    count.store (count.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sumNs.store (sumNs.load (std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+    if (ns > maxNs.load (std::memory_order_relaxed))
+        maxNs.store (ns, std::memory_order_relaxed);
+
+    const int64 numOfRecorded = numOfValues.load (std::memory_order_relaxed);
+    if (numOfRecorded == 0 || ns < minNs.load (std::memory_order_relaxed))
+        minNs.store (ns, std::memory_order_relaxed);
+
+    numOfValues.store (numOfRecorded + 1, std::memory_order_release);
+}
+
+timingHistogramType::snapshotType timingHistogramType::getSnapshot() const
+{
+    snapshotType snapshot;
+    snapshot.numOfValues = numOfValues.load (std::memory_order_acquire);
+    for (int bucket = 0; bucket < numOfBuckets; ++bucket)
+        snapshot.counts[bucket] = counts[bucket].load (std::memory_order_relaxed);
+    snapshot.sumNs = sumNs.load (std::memory_order_relaxed);
+    snapshot.minNs = minNs.load (std::memory_order_relaxed);
+    snapshot.maxNs = maxNs.load (std::memory_order_relaxed);
+    return snapshot;
+}
+
+timingHistogramType::snapshotType timingHistogramType::snapshotType::getDifference (const snapshotType& older) const
+{
+    // the histogram was reset in between, everything it holds is newer than `older`
+    if (numOfValues < older.numOfValues)
+        return *this;
+
+    snapshotType difference;
+    for (int bucket = 0; bucket < numOfBuckets; ++bucket)
+        difference.counts[bucket] = counts[bucket] - older.counts[bucket];
+    difference.numOfValues = numOfValues - older.numOfValues;
+    difference.sumNs       = sumNs - older.sumNs;
+    difference.minNs       = minNs;
+    difference.maxNs       = maxNs;
+    return difference;
+}
+
+double timingHistogramType::snapshotType::getPercentileNs (double percentile) const
+{
+    // the buckets are read one by one while the writer goes on, so count them again
+    int64 numOfCounted = 0;
+    for (auto count : counts)
+        numOfCounted += count;
+
+    const int64 rank = (int64) std::ceil (numOfCounted * percentile / 100.0);
+    int64 numBelow = 0;
+    for (int bucket = 0; bucket < numOfBuckets; ++bucket)
+    {
+        if (numBelow + counts[bucket] >= rank && counts[bucket] > 0)
+        {
+            // the bucket edges are up to a factor 1.5 apart, its upper edge alone would overstate the value
+            const double lowerEdge = getBucketLowerEdgeNs (bucket);
+            const double upperEdge = getBucketUpperEdgeNs (bucket);
+            const double valueNs = lowerEdge + (upperEdge - lowerEdge) * (double) (rank - numBelow) / (double) counts[bucket];
+            return maxNs > 0 ? jlimit ((double) minNs, (double) maxNs, valueNs) : valueNs;
+        }
+        numBelow += counts[bucket];
+    }
+    return 0.0;
+}
+
+//==============================================================================
+// AUDIO THREAD STATS
+const double audioThreadStatsType::nsPerTick = 1.0e9 / (double) Time::getHighResolutionTicksPerSecond();
+
+audioThreadStatsType::audioThreadStatsType()
+: numOfBlocks (0),
+  numOfChainSwaps (0),
+  numOfCutCrossfades (0),
+  numOfDroppedSamples (0),
+  sampleRate (0),
+  blockSize (0)
+{
+}
+
+slotTimingType audioThreadStatsType::getSlotTiming (int slot) const
+{
+    return getSlotTiming (slot, slotTimingType());
+}
+
+slotTimingType audioThreadStatsType::getSlotTiming (int slot, const slotTimingType& previous) const
+{
+    jassert (isPositiveAndBelow (slot, (int) numOfSlots));
+
+    slotTimingType timing;
+    timing.snapshot = slotTime[slot].getSnapshot();
+    const timingHistogramType::snapshotType interval = timing.snapshot.getDifference (previous.snapshot);
+
+    timing.numOfBlocks = interval.numOfValues;
+    timing.minUs  = timing.snapshot.minNs / 1000.0;
+    timing.maxUs  = timing.snapshot.maxNs / 1000.0;
+    timing.meanUs = interval.getMeanNs() / 1000.0;
+    timing.p99Us  = interval.getPercentileNs (99) / 1000.0;
+
+    const int rate = sampleRate.load();
+    timing.deadlineUs = rate > 0 ? 1.0e6 * blockSize.load() / rate : 0.0;
+    return timing;
+}
+
+bool audioThreadStatsType::dumpToFile (const File& file, int64 numOfCaptureOverrunBlocks) const
+{
+    String csv;
+    csv << "counter,value\n"
+        << "blocks," << numOfBlocks.load() << "\n"
+        << "chain_swaps," << numOfChainSwaps.load() << "\n"
+        << "cut_crossfades," << numOfCutCrossfades.load() << "\n"
+        << "dropped_samples," << numOfDroppedSamples.load() << "\n"
+        << "capture_overrun_blocks," << numOfCaptureOverrunBlocks << "\n"
+        << "sample_rate," << sampleRate.load() << "\n"
+        << "block_size," << blockSize.load() << "\n\n";
+
+    csv << "histogram,count,mean_ns,p50_ns,p99_ns,min_ns,max_ns";
+    for (int bucket = 0; bucket < timingHistogramType::numOfBuckets; ++bucket)
+        csv << ",le_" << String ((int64) timingHistogramType::getBucketUpperEdgeNs (bucket)) << "_ns";
+    csv << "\n";
+
+    auto addHistogram = [&csv] (const String& name, const timingHistogramType& histogram)
+    {
+        const timingHistogramType::snapshotType snapshot = histogram.getSnapshot();
+        csv << name << "," << snapshot.numOfValues << "," << String (snapshot.getMeanNs(), 1)
+            << "," << String (snapshot.getPercentileNs (50), 0) << "," << String (snapshot.getPercentileNs (99), 0)
+            << "," << snapshot.minNs << "," << snapshot.maxNs;
+        for (auto count : snapshot.counts)
+            csv << "," << count;
+        csv << "\n";
+    };
+
+    addHistogram ("block",   blockTime);
+    addHistogram ("chain",   chainTime);
+    addHistogram ("capture", captureTime);
+    for (int slot = 0; slot < numOfSlots; ++slot)
+        addHistogram ("slot" + String (slot + 1), slotTime[slot]);
+
+    return file.replaceWithText (csv);
+}
+
+//==============================================================================
+// SLOT TIMING PROCESSOR
+SlotTimingProcessor::SlotTimingProcessor (AudioPluginInstance* pluginToWrap, timingHistogramType& histogram)
+: plugin (pluginToWrap),
+  slotTime (histogram)
+{
+    jassert (plugin != nullptr);
+    setPlayConfigDetails (plugin->getTotalNumInputChannels(), plugin->getTotalNumOutputChannels(),
+                          plugin->getSampleRate(), plugin->getBlockSize());
+    setLatencySamples (plugin->getLatencySamples());
+}
+
+SlotTimingProcessor::~SlotTimingProcessor()
+{
+}
+
+AudioProcessor* SlotTimingProcessor::getHostedProcessor (AudioProcessor* processor)
+{
+    if (auto* slot = dynamic_cast<SlotTimingProcessor*> (processor))
+        return slot->plugin.get();
+    return processor;
+}
+
+void SlotTimingProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
+{
+    // both the graph and the chain renderer prepare the slots, the plugin only needs it once
+    const ScopedLock sl (prepareLock);
+    if (sampleRate == preparedSampleRate && samplesPerBlock == preparedBlockSize)
+        return;
+
+    preparedSampleRate = sampleRate;
+    preparedBlockSize  = samplesPerBlock;
+    plugin->setRateAndBufferSizeDetails (sampleRate, samplesPerBlock);
+    plugin->prepareToPlay (sampleRate, samplesPerBlock);
+    setLatencySamples (plugin->getLatencySamples());
+}
+
+void SlotTimingProcessor::releaseResources()
+{
+    const ScopedLock sl (prepareLock);
+    preparedSampleRate = 0;
+    preparedBlockSize  = 0;
+    plugin->releaseResources();
+}
+
+void SlotTimingProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
+{
+    const int64 start = Time::getHighResolutionTicks();
+    plugin->processBlock (buffer, midiMessages);
+    slotTime.record (audioThreadStatsType::ticksToNs (Time::getHighResolutionTicks() - start));
+}
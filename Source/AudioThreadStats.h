@@ -0,0 +1,148 @@
+#pragma once
+#include "JuceHeader.h"
+
+//==============================================================================
+/** Duration histogram written by a single thread (the audio thread) without locks.
+    Every octave of nanoseconds [2^k, 2^(k+1)) is split at 1.5 * 2^k into two buckets,
+    so the 64 buckets span 1 ns .. ~4 s. The counters only grow until a reset is requested;
+    a reader takes snapshots and subtracts the previous one to get the values of its own interval.
+*/
+struct timingHistogramType
+{
+    enum { numOfBuckets = 64 };
+
+    struct snapshotType
+    {
+        int64 counts[numOfBuckets] = {};
+        int64 numOfValues = 0;
+        int64 sumNs = 0;
+        int64 minNs = 0;    // min and max are since the last reset,
+        int64 maxNs = 0;    // they cannot be taken apart per interval
+
+        snapshotType getDifference (const snapshotType& older) const;
+        double getMeanNs() const      { return numOfValues > 0 ? (double) sumNs / numOfValues : 0.0; }
+        /** Interpolated linearly inside the bucket the percentile falls into, clamped to min and max. */
+        double getPercentileNs (double percentile) const;
+    };
+
+    timingHistogramType();
+
+    void record (int64 ns);          // writer thread only
+    snapshotType getSnapshot() const;
+
+    /** Any thread: the writer clears everything before it records its next value. */
+    void requestReset()              { resetRequested.store (true, std::memory_order_release); }
+
+    static int getBucket (int64 ns);
+    static double getBucketLowerEdgeNs (int bucket) { return bucket > 0 ? std::ldexp ((bucket & 1) != 0 ? 1.5 : 1.0, bucket / 2) : 0.0; }
+    static double getBucketUpperEdgeNs (int bucket) { return std::ldexp ((bucket & 1) != 0 ? 2.0 : 1.5, bucket / 2); }
+
+private:
+    std::atomic<int64> counts[numOfBuckets];
+    std::atomic<int64> numOfValues;
+    std::atomic<int64> sumNs;
+    std::atomic<int64> minNs;
+    std::atomic<int64> maxNs;
+    std::atomic<bool> resetRequested;
+};
+
+//==============================================================================
+/** Processing time of one hosted plugin slot, relative to the block deadline. */
+struct slotTimingType
+{
+    timingHistogramType::snapshotType snapshot;   // pass it back to get the next interval
+    int64 numOfBlocks = 0;
+    double minUs = 0, meanUs = 0, p99Us = 0, maxUs = 0;
+    double deadlineUs = 0;                        // blockSize / sampleRate
+
+    /** Part of the deadline a duration takes, 1.0 means the whole block period. */
+    double getDeadlineFraction (double us) const  { return deadlineUs > 0 ? us / deadlineUs : 0.0; }
+};
+
+//==============================================================================
+/** Per-block counters and timings of processBlock, recorded on the audio thread
+    and drained by the editor's overlay or by any log thread.
+*/
+struct audioThreadStatsType
+{
+    enum { numOfSlots = 6 };
+
+    audioThreadStatsType();
+
+    static int64 ticksToNs (int64 ticks)
+    {
+        return (int64) (ticks * nsPerTick);
+    }
+
+    timingHistogramType blockTime;      // the whole processBlock
+    timingHistogramType chainTime;      // the hosted chain
+    timingHistogramType captureTime;    // pre & post copies into the capture ring
+    timingHistogramType slotTime[numOfSlots];
+
+    std::atomic<int64> numOfBlocks;
+    std::atomic<int64> numOfChainSwaps;            // new chain topologies swapped in
+    std::atomic<int64> numOfCutCrossfades;         // the block outgrew the crossfade scratch space, the swap was a hard cut
+    std::atomic<int64> numOfDroppedSamples;        // did not fit into the capture ring slots
+    std::atomic<int> sampleRate;
+    std::atomic<int> blockSize;
+
+    /** Slot timings since the plugin was loaded (slot 0..5), callable from any thread. */
+    slotTimingType getSlotTiming (int slot) const;
+    /** Same, with mean and p99 over the blocks processed since the previous call returned `previous`. */
+    slotTimingType getSlotTiming (int slot, const slotTimingType& previous) const;
+
+    /** Writes the counters and every histogram as CSV, callable from any non-audio thread. */
+    bool dumpToFile (const File& file, int64 numOfCaptureOverrunBlocks) const;
+
+private:
+    static const double nsPerTick;
+};
+
+//==============================================================================
+/** Wraps a hosted plugin in one of the six slots and times its processBlock.
+    The graph only sees this processor; everything that needs the plugin itself
+    (editor, description, state) goes through getHostedProcessor().
+*/
+class SlotTimingProcessor  : public AudioProcessor
+{
+public:
+    SlotTimingProcessor (AudioPluginInstance* pluginToWrap, timingHistogramType& slotTime);
+    ~SlotTimingProcessor();
+
+    /** The plugin inside a slot node, or the processor itself when it is not wrapped. */
+    static AudioProcessor* getHostedProcessor (AudioProcessor* processor);
+
+    const String getName() const override                   { return plugin->getName(); }
+    void prepareToPlay (double sampleRate, int samplesPerBlock) override;
+    void releaseResources() override;
+    void processBlock (AudioBuffer<float>& buffer, MidiBuffer& midiMessages) override;
+    void reset() override                                   { plugin->reset(); }
+
+    double getTailLengthSeconds() const override            { return plugin->getTailLengthSeconds(); }
+    bool acceptsMidi() const override                       { return plugin->acceptsMidi(); }
+    bool producesMidi() const override                      { return plugin->producesMidi(); }
+
+    AudioProcessorEditor* createEditor() override           { return nullptr; }
+    bool hasEditor() const override                         { return false; }
+
+    int getNumPrograms() override                           { return plugin->getNumPrograms(); }
+    int getCurrentProgram() override                        { return plugin->getCurrentProgram(); }
+    void setCurrentProgram (int index) override             { plugin->setCurrentProgram (index); }
+    const String getProgramName (int index) override        { return plugin->getProgramName (index); }
+    void changeProgramName (int index, const String& name) override { plugin->changeProgramName (index, name); }
+
+    void getStateInformation (MemoryBlock& destData) override           { plugin->getStateInformation (destData); }
+    void setStateInformation (const void* data, int sizeInBytes) override { plugin->setStateInformation (data, sizeInBytes); }
+
+private:
+    std::unique_ptr<AudioPluginInstance> plugin;
+    timingHistogramType& slotTime;
+
+    // the graph and the chain renderer both prepare the slot, from whatever thread they run on:
+    // the settings are checked and the plugin prepared under one lock
+    CriticalSection prepareLock;
+    double preparedSampleRate = 0;
+    int preparedBlockSize = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SlotTimingProcessor)
+};
@@ -0,0 +1,922 @@
+#include "ChainRenderer.h"
+#include "AudioThreadStats.h"
+
+#if JUCE_MAC || JUCE_IOS
+ #include <mach/mach.h>
+ #include <mach/thread_policy.h>
+#endif
+
+//==============================================================================
+// CHAIN WORKER POOL
+namespace
+{
+    // the scheduler class of an audio I/O thread, macOS only: this much of every period is guaranteed
+    void setRealtimeConstraint (double periodSeconds)
+    {
+       #if JUCE_MAC || JUCE_IOS
+        mach_timebase_info_data_t timebase;
+        mach_timebase_info (&timebase);
+        const double ticksPerSecond = 1.0e9 * timebase.denom / timebase.numer;
+        const uint32_t period = (uint32_t) (jlimit (0.001, 0.05, periodSeconds) * ticksPerSecond);
+
+        thread_time_constraint_policy_data_t policy;
+        policy.period      = period;
+        policy.computation = period / 2;
+        policy.constraint  = period;
+        policy.preemptible = true;
+        thread_policy_set (pthread_mach_thread_np (pthread_self()), THREAD_TIME_CONSTRAINT_POLICY,
+                           (thread_policy_t) &policy, THREAD_TIME_CONSTRAINT_POLICY_COUNT);
+       #else
+        ignoreUnused (periodSeconds);
+       #endif
+    }
+}
+
+class ChainWorkerPool::Worker  : public Thread
+{
+public:
+    Worker (ChainWorkerPool& p, int index, double period)
+    : Thread ("Chain worker " + String (index)),
+      runningTaskAt (notRunning),
+      isParkedAt (false),
+      pool (p),
+      periodSeconds (period)
+    {
+    }
+
+    void run() override
+    {
+        ScopedNoDenormals noDenormals;
+        setRealtimeConstraint (periodSeconds);
+        const int64 spinTicks = Time::secondsToHighResolutionTicks (spinSeconds);
+        int64 lastTaskTicks = Time::getHighResolutionTicks();
+
+        while (! threadShouldExit())
+        {
+            if (pool.runNextTask (&runningTaskAt))
+            {
+                lastTaskTicks = Time::getHighResolutionTicks();
+                continue;
+            }
+
+            // a short poll catches the next chunk of a block in progress, after that the worker parks
+            if (Time::getHighResolutionTicks() - lastTaskTicks < spinTicks)
+                continue;
+
+            // parked first, then checked: run() publishes its batch first, then wakes the parked workers
+            isParkedAt.store (true);
+            if (! pool.hasTaskToClaim())
+                wait (-1);
+            isParkedAt.store (false);
+            lastTaskTicks = Time::getHighResolutionTicks();
+        }
+    }
+
+    std::atomic<uint64> runningTaskAt;    // the claim state of the task it runs, notRunning between tasks
+    std::atomic<bool> isParkedAt;
+
+private:
+    ChainWorkerPool& pool;
+    const double periodSeconds;
+    static constexpr double spinSeconds = 10.0e-6;
+};
+
+ChainWorkerPool::ChainWorkerPool()
+: waitDeadlineTicksAt (0),
+  claimState (noTaskIndex),
+  finishedState (0),
+  currentTasks (nullptr),
+  numOfCurrentTasks (0)
+{
+}
+
+ChainWorkerPool::~ChainWorkerPool()
+{
+    setNumOfWorkers (0, blockPeriod);
+}
+
+void ChainWorkerPool::setNumOfWorkers (int numOfWorkers, double blockPeriodSeconds)
+{
+    const int numOfKeptWorkers = blockPeriodSeconds == blockPeriod ? numOfWorkers : 0;
+    blockPeriod = blockPeriodSeconds;
+    waitDeadlineTicksAt.store (Time::secondsToHighResolutionTicks (blockPeriod / 2));
+
+    // a worker may be inside a plugin's processBlock: it is told to stop and waited for, however long
+    // the plugin takes, as killing it there would leave the plugin's locks and state behind
+    while (workers.size() > numOfKeptWorkers)
+    {
+        workers.getLast()->stopThread (-1);
+        workers.removeLast();
+    }
+
+    while (workers.size() < numOfWorkers)
+    {
+        Worker* worker = workers.add (new Worker (*this, workers.size() + 1, blockPeriod));
+        worker->startThread (10);
+    }
+}
+
+uint32 ChainWorkerPool::run (taskListType& tasks, int numOfTasks)
+{
+    jassert (numOfTasks <= maxNumOfTasks);
+
+    // a worker was late not long ago: the tasks run here, in order, without waiting for anybody
+    if (numOfSerialBatchesLeft > 0)
+    {
+        --numOfSerialBatchesLeft;
+        for (int index = 0; index < numOfTasks; ++index)
+            tasks.runTask (index);
+        return 0;
+    }
+
+    // a new batch without any task to claim first, so nobody can claim from
+    // the previous batch while the tasks and their number are replaced
+    const uint64 batch = (claimState.load (std::memory_order_relaxed) >> 32) + 1;
+    claimState.store (batch << 32 | noTaskIndex, std::memory_order_release);
+
+    finishedState.store (batch << 32, std::memory_order_relaxed);
+    currentTasks.store (&tasks, std::memory_order_relaxed);
+    numOfCurrentTasks.store (numOfTasks, std::memory_order_relaxed);
+    claimState.store (batch << 32);
+    wakeWorkers();
+
+    // the calling thread claims tasks as well, then only waits for the ones already running on a worker
+    while (runNextTask (nullptr))
+        ;
+
+    const uint64 allTasks = ((uint64) 1 << numOfTasks) - 1;
+    const int64 deadline = Time::getHighResolutionTicks() + waitDeadlineTicksAt.load (std::memory_order_relaxed);
+
+    for (;;)
+    {
+        const uint64 finishedTasks = finishedState.load (std::memory_order_acquire) & noTaskIndex;
+        if (finishedTasks == allTasks)
+            return 0;
+
+        // a running task cannot be taken over: it is left to its worker, and the next blocks do not depend on the workers
+        if (Time::getHighResolutionTicks() > deadline)
+        {
+            numOfSerialBatchesLeft = numOfSerialBatchesAfterLateWorker;
+            return (uint32) (allTasks & ~finishedTasks);
+        }
+    }
+}
+
+uint32 ChainWorkerPool::getRunningTasks() const
+{
+    uint32 runningTasks = 0;
+
+    for (const Worker* worker : workers)
+    {
+        const uint64 state = worker->runningTaskAt.load();
+        if (state != notRunning)
+            runningTasks |= (uint32) 1 << (state & noTaskIndex);
+    }
+
+    return runningTasks;
+}
+
+bool ChainWorkerPool::hasTaskToClaim() const
+{
+    return (claimState.load() & noTaskIndex) < (uint64) numOfCurrentTasks.load (std::memory_order_relaxed);
+}
+
+void ChainWorkerPool::wakeWorkers()
+{
+    // a worker that still polls sees the batch on its own, only the parked ones need the system call
+    for (Worker* worker : workers)
+        if (worker->isParkedAt.load())
+            worker->notify();
+}
+
+bool ChainWorkerPool::runNextTask (std::atomic<uint64>* runningTask)
+{
+    uint64 state = claimState.load (std::memory_order_acquire);
+
+    for (;;)
+    {
+        const uint64 index = state & noTaskIndex;
+        if (index >= (uint64) numOfCurrentTasks.load (std::memory_order_relaxed))
+            break;
+
+        taskListType* const tasks = currentTasks.load (std::memory_order_relaxed);
+
+        // shown as running before the claim, so getRunningTasks() never misses a claimed task
+        if (runningTask != nullptr)
+            runningTask->store (state);
+
+        if (claimState.compare_exchange_weak (state, state + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            tasks->runTask ((int) index);
+
+            // a task its batch has given up on is not counted in the next one
+            const uint64 batch = state >> 32;
+            uint64 finished = finishedState.load (std::memory_order_relaxed);
+            while ((finished >> 32) == batch
+                   && ! finishedState.compare_exchange_weak (finished, finished | (uint64) 1 << index, std::memory_order_acq_rel, std::memory_order_relaxed))
+                ;
+
+            if (runningTask != nullptr)
+                runningTask->store (notRunning);
+            return true;
+        }
+    }
+
+    if (runningTask != nullptr)
+        runningTask->store (notRunning);
+    return false;
+}
+
+//==============================================================================
+// CHAIN LAYOUT
+bool chainLayoutType::operator== (const chainLayoutType& other) const
+{
+    if (splitMode != other.splitMode)
+        return false;
+
+    for (int slot = 0; slot < numOfSlots; ++slot)
+        if (getBranch (slot) != other.getBranch (slot))
+            return false;
+
+    return true;
+}
+
+bool chainSequenceType::hasSameLayout (const chainSequenceType& other) const
+{
+    if (layout != other.layout)
+        return false;
+
+    // the delay lines only carry over when they keep their length
+    if (isSplit())
+        for (int branch = 0; branch < numOfBranches; ++branch)
+            if (getBranchDelay (branch) != other.getBranchDelay (branch))
+                return false;
+
+    return true;
+}
+
+//==============================================================================
+// SAVED CHAIN
+void savedChainType::writeToXml (XmlElement& rootXml) const
+{
+    for (int slot = 0; slot < numOfSlots; ++slot)
+    {
+        const String prefix ("plugin" + String (slot + 1));
+        rootXml.setAttribute (prefix + "_state",     slots[slot].isLoaded);
+        rootXml.setAttribute (prefix + "_bypass",    slots[slot].isBypassed);
+        rootXml.setAttribute (prefix + "_isVisible", slots[slot].isVisible);
+        rootXml.setAttribute (prefix + "_branch",    layout.slotBranch[slot]);
+    }
+    rootXml.setAttribute ("split_mode", (int) layout.splitMode);
+
+    // one description and one state per loaded slot, in slot order
+    XmlElement* descriptions = rootXml.createNewChildElement ("LoadedPluginsDescriptions");
+    XmlElement* states       = rootXml.createNewChildElement ("LoadedPluginsProcessorState");
+
+    for (int slot = 0; slot < numOfSlots; ++slot)
+    {
+        if (! slots[slot].isLoaded)
+            continue;
+
+        descriptions->addChildElement (slots[slot].description.createXml());
+        states->createNewChildElement ("Plugin" + String (slot))->addTextElement (slots[slot].state.toBase64Encoding());
+    }
+}
+
+void savedChainType::readFromXml (const XmlElement& rootXml)
+{
+    for (int slot = 0; slot < numOfSlots; ++slot)
+    {
+        const String prefix ("plugin" + String (slot + 1));
+        slots[slot].isLoaded   = rootXml.getBoolAttribute (prefix + "_state");
+        slots[slot].isBypassed = rootXml.getBoolAttribute (prefix + "_bypass");
+        slots[slot].isVisible  = rootXml.getBoolAttribute (prefix + "_isVisible");
+        layout.slotBranch[slot] = rootXml.getIntAttribute (prefix + "_branch") == 1 ? 1 : 0;
+    }
+    layout.splitMode = (chainLayoutType::splitModeType) jlimit (0, 2, rootXml.getIntAttribute ("split_mode"));
+
+    const XmlElement* descriptions = rootXml.getChildByName ("LoadedPluginsDescriptions");
+    const XmlElement* states       = rootXml.getChildByName ("LoadedPluginsProcessorState");
+    const XmlElement* description  = descriptions != nullptr ? descriptions->getFirstChildElement() : nullptr;
+    const XmlElement* state        = states       != nullptr ? states->getFirstChildElement()       : nullptr;
+
+    for (slotType& slot : slots)
+    {
+        slot.description = PluginDescription();
+        slot.state.reset();
+
+        if (! slot.isLoaded)
+            continue;
+
+        slot.isLoaded = description != nullptr && slot.description.loadFromXml (*description);
+        if (description != nullptr)
+            description = description->getNextElement();
+
+        if (state != nullptr)
+        {
+            slot.state.fromBase64Encoding (state->getAllSubText());
+            state = state->getNextElement();
+        }
+    }
+}
+
+//==============================================================================
+// CHAIN RENDERER
+ChainRenderer::ChainRenderer()
+: pendingAt (nullptr),
+  activeAt (nullptr),
+  fadingAt (nullptr),
+  latencySamplesAt (0),
+  crossfadeLengthAt (2)
+{
+    lastSlotNodes.insertMultiple (0, nullptr, chainSequenceType::numOfSlots);
+    laterChunkMidi.ensureSize (2048);
+
+    for (int branch = 0; branch < chainSequenceType::numOfBranches; ++branch)
+    {
+        branchMidi[branch].ensureSize (2048);
+        runsBranchAt[branch].store (false);
+    }
+
+    for (std::atomic<chainSequenceType*>& lateSequence : lateSequencesAt)
+        lateSequence.store (nullptr);
+
+    startTimer (50);
+}
+
+ChainRenderer::~ChainRenderer()
+{
+    stopTimer();
+}
+
+void ChainRenderer::prepare (double newSampleRate, int newMaxBlockSize, int newNumOfChannels)
+{
+    sampleRate    = newSampleRate;
+    maxBlockSize  = newMaxBlockSize;
+    numOfChannels = jmax (1, newNumOfChannels);
+    crossfadeLengthAt.store (jmax (2, roundToInt (sampleRate * crossfadeSeconds)));
+
+    // a branch left running by a late worker is done before its processors are prepared again:
+    // stopping the workers waits for it
+    workerPool.setNumOfWorkers (0, 0);
+    lateBranches = 0;
+    numOfLateProcessors = 0;
+    for (std::atomic<chainSequenceType*>& lateSequence : lateSequencesAt)
+        lateSequence.store (nullptr);
+
+    // the audio thread is stopped, so everything in flight can go and the new sequence runs as it is;
+    // with nothing in flight every slot is prepared with the new settings
+    queuedSequence = nullptr;
+    sequencesInFlight.clear();
+    const sequencePtr sequence = createSequence (lastSlotNodes, lastLayout);
+    sequencesInFlight.push_back (sequence);
+    releasePool.add (sequence);
+    updateNumOfWorkers();
+
+    active = sequence.get();
+    fading = nullptr;
+    crossfadePosition = 0;
+    pendingAt.store (nullptr);
+    fadingAt.store (nullptr);
+    activeAt.store (active);
+    latencySamplesAt.store (active->latencySamples);
+}
+
+void ChainRenderer::setChain (const slotNodesType& slotNodes, const chainLayoutType& layout)
+{
+    jassert (slotNodes.size() == chainSequenceType::numOfSlots);
+    lastSlotNodes = slotNodes;
+    lastLayout    = layout;
+
+    const sequencePtr sequence = createSequence (slotNodes, layout);
+
+    if (pendingAt.load() == nullptr)
+    {
+        publish (sequence);
+    }
+    else
+    {
+        queuedSequence = sequence;   // an unpublished one it replaces was never seen by the audio thread
+        updateNumOfWorkers();
+    }
+}
+
+bool ChainRenderer::isInFlight (const AudioProcessorGraph::Node* node) const
+{
+    for (const sequencePtr& sequence : sequencesInFlight)
+        for (const AudioProcessorGraph::Node::Ptr& slot : sequence->slots)
+            if (slot.get() == node)
+                return true;
+
+    return false;
+}
+
+ChainRenderer::sequencePtr ChainRenderer::createSequence (const slotNodesType& slotNodes, const chainLayoutType& layout)
+{
+    sequencePtr sequence (new chainSequenceType());
+    sequence->layout = layout;
+    int numOfScratchChannels = numOfChannels;
+
+    for (int slot = 0; slot < chainSequenceType::numOfSlots; ++slot)
+    {
+        AudioProcessorGraph::Node::Ptr node = slotNodes[slot];
+        if (node.get() == nullptr)
+            continue;
+
+        // the audio thread may be running a processor of a sequence in flight, it is left alone:
+        // it was prepared when it joined, and the settings only change in prepare(), with the audio stopped.
+        // Before the host's first prepareToPlay there are no settings yet.
+        AudioProcessor* processor = node->getProcessor();
+        if (sampleRate > 0 && maxBlockSize > 0 && ! isInFlight (node.get()))
+        {
+            processor->setProcessingPrecision (AudioProcessor::singlePrecision);
+            processor->setRateAndBufferSizeDetails (sampleRate, maxBlockSize);
+            processor->prepareToPlay (sampleRate, maxBlockSize);
+        }
+
+        sequence->slots[slot] = node;
+        sequence->branchLatency[layout.getBranch (slot)] += SlotTimingProcessor::getHostedProcessor (processor)->getLatencySamples();
+        numOfScratchChannels = jmax (numOfScratchChannels, processor->getTotalNumInputChannels(), processor->getTotalNumOutputChannels());
+    }
+
+    // the branches are joined at the latency of the longer one
+    sequence->latencySamples = sequence->isSplit() ? jmax (sequence->branchLatency[0], sequence->branchLatency[1])
+                                                   : sequence->branchLatency[0];
+
+    // the sequence this one will fade from may need more channels than its own slots
+    for (const sequencePtr& sequenceInFlight : sequencesInFlight)
+        numOfScratchChannels = jmax (numOfScratchChannels, sequenceInFlight->wetBuffers[0].getNumChannels());
+
+    const int blockCapacity = jmax (1, maxBlockSize);
+    for (int branch = 0; branch < chainSequenceType::numOfBranches; ++branch)
+    {
+        sequence->wetBuffers[branch].setSize (numOfScratchChannels, blockCapacity);
+
+        if (! sequence->isSplit())
+            continue;
+
+        sequence->branchBuffers[branch].setSize (numOfChannels, blockCapacity);
+
+        const int delay = sequence->getBranchDelay (branch);
+        if (delay > 0)
+        {
+            sequence->delayBuffers[branch].setSize (numOfChannels, delay + 1);
+            sequence->delayBuffers[branch].clear();
+        }
+    }
+
+    return sequence;
+}
+
+void ChainRenderer::publish (const sequencePtr& sequence)
+{
+    sequencesInFlight.push_back (sequence);
+    releasePool.add (sequence);
+    updateNumOfWorkers();    // the workers are up before the audio thread can see the sequence
+    pendingAt.store (sequence.get());
+}
+
+void ChainRenderer::updateNumOfWorkers()
+{
+    // one worker per branch beyond the first, as long as there is a core for it. The pool only
+    // shrinks once no split sequence is in flight: before that the audio thread may be waiting
+    // in run() for a task on the very worker that would be stopped.
+    bool needsWorkers = queuedSequence != nullptr && queuedSequence->isSplit();
+    for (const sequencePtr& sequence : sequencesInFlight)
+        needsWorkers = needsWorkers || sequence->isSplit();
+
+    const double blockPeriod = sampleRate > 0 ? maxBlockSize / sampleRate : 0.01;
+    workerPool.setNumOfWorkers (needsWorkers ? jmin (chainSequenceType::numOfBranches - 1, SystemStats::getNumCpus() - 1) : 0, blockPeriod);
+}
+
+void ChainRenderer::timerCallback()
+{
+    if (queuedSequence != nullptr && pendingAt.load() == nullptr)
+    {
+        publish (queuedSequence);
+        queuedSequence = nullptr;
+    }
+
+    // read in the order the audio thread moves a sequence: pending -> active -> fading,
+    // so a sequence on its way from one to the next is always seen in one of them
+    const chainSequenceType* const pending = pendingAt.load();
+    const chainSequenceType* const current = activeAt.load();
+    const chainSequenceType* const old     = fadingAt.load();
+
+    // a branch becomes late while its sequence is active or fading, so it is seen here after those
+    const chainSequenceType* late[2 * chainSequenceType::numOfBranches];
+    for (int i = 0; i < 2 * chainSequenceType::numOfBranches; ++i)
+        late[i] = lateSequencesAt[i].load();
+
+    // what is dropped here is deleted by the release pool, on this thread
+    sequencesInFlight.erase (std::remove_if (sequencesInFlight.begin(), sequencesInFlight.end(),
+                                             [&] (const sequencePtr& sequence)
+                                             {
+                                                 if (sequence.get() == pending || sequence.get() == current || sequence.get() == old)
+                                                     return false;
+
+                                                 return std::find (std::begin (late), std::end (late), sequence.get()) == std::end (late);
+                                             }),
+                             sequencesInFlight.end());
+    updateNumOfWorkers();
+}
+
+int ChainRenderer::process (AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
+{
+    int result = renderedBlock;
+
+    if (lateBranches != 0)
+        updateLateBranches (lateBranches & workerPool.getRunningTasks());
+
+    // a new sequence only comes in once the previous crossfade is done
+    if (fading == nullptr)
+    {
+        if (chainSequenceType* next = pendingAt.load())
+        {
+            fading = active;
+            active = next;
+            crossfadePosition = 0;
+
+            fadingAt.store (fading);
+            activeAt.store (active);
+            pendingAt.store (nullptr);
+            latencySamplesAt.store (active->latencySamples);
+            result |= swappedSequence;
+
+            // the branch delay lines go on where the old sequence left them, a late branch's is still in use
+            if (fading != nullptr && active->isSplit() && active->hasSameLayout (*fading))
+            {
+                for (int branch = 0; branch < chainSequenceType::numOfBranches; ++branch)
+                {
+                    if (isLate (branch))
+                        continue;
+
+                    active->delayBuffers[branch].makeCopyOf (fading->delayBuffers[branch], true);
+                    active->delayPositions[branch] = fading->delayPositions[branch];
+                }
+            }
+        }
+    }
+
+    if (active == nullptr)
+        return result;
+
+    const int numOfSamples = buffer.getNumSamples();
+
+    // without enough scratch space for a ramp the new sequence takes over at once
+    if (fading != nullptr && numOfSamples > active->wetBuffers[0].getNumSamples())
+    {
+        fading = nullptr;
+        fadingAt.store (nullptr);
+        result |= cutCrossfade;
+    }
+
+    if (fading == nullptr)
+    {
+        renderSequence (*active, nullptr, buffer, midiMessages);
+        return result;
+    }
+
+    const float crossfadeLength = (float) crossfadeLengthAt.load();
+
+    if (active->hasSameLayout (*fading))
+    {
+        // every slot that comes or goes is faded against its own input, the others run as they are
+        startGain = jmin (1.0f, crossfadePosition / crossfadeLength);
+        endGain   = jmin (1.0f, (crossfadePosition + numOfSamples) / crossfadeLength);
+        renderSequence (*active, fading, buffer, midiMessages);
+        startGain = endGain = 1.0f;
+    }
+    else
+    {
+        // slots cannot be faded one by one across layouts:
+        // the old sequence fades out over the first half, the new one in over the second
+        const float halfLength = crossfadeLength / 2;
+        const float start = (float) crossfadePosition, end = (float) (crossfadePosition + numOfSamples);
+
+        if (crossfadePosition < halfLength)
+        {
+            renderSequence (*fading, nullptr, buffer, midiMessages);
+            buffer.applyGainRamp (0, numOfSamples, jmax (0.0f, 1.0f - start / halfLength), jmax (0.0f, 1.0f - end / halfLength));
+        }
+        else
+        {
+            renderSequence (*active, nullptr, buffer, midiMessages);
+            buffer.applyGainRamp (0, numOfSamples, jmin (1.0f, start / halfLength - 1.0f), jmin (1.0f, end / halfLength - 1.0f));
+        }
+    }
+
+    crossfadePosition += numOfSamples;
+    if (crossfadePosition >= crossfadeLength)
+    {
+        fading = nullptr;
+        fadingAt.store (nullptr);
+    }
+
+    return result;
+}
+
+void ChainRenderer::renderSequence (chainSequenceType& sequence, chainSequenceType* transitionFrom,
+                                    AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
+{
+    if (sequence.isSplit())
+    {
+        renderSplit (sequence, transitionFrom, buffer, midiMessages);
+        return;
+    }
+
+    branchJobType job;
+    job.sequence     = &sequence;
+    job.from         = transitionFrom;
+    job.numOfSamples = buffer.getNumSamples();
+    job.startGain    = startGain;
+    job.endGain      = endGain;
+    job.skippedSlots = getSkippedSlots (sequence, transitionFrom);
+    renderBranch (job, 0, buffer, midiMessages);
+}
+
+void ChainRenderer::renderSplit (chainSequenceType& sequence, chainSequenceType* transitionFrom,
+                                 AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
+{
+    const int numOfSamples = buffer.getNumSamples();
+
+    // a host block longer than announced goes through in pieces, the gains ramp across all of them
+    const int blockCapacity = sequence.branchBuffers[0].getNumSamples();
+    if (numOfSamples > blockCapacity)
+    {
+        const float blockStartGain = startGain, blockEndGain = endGain;
+
+        for (int start = 0; start < numOfSamples; start += blockCapacity)
+        {
+            const int numOfChunkSamples = jmin (blockCapacity, numOfSamples - start);
+            startGain = blockStartGain + (blockEndGain - blockStartGain) * start / numOfSamples;
+            endGain   = blockStartGain + (blockEndGain - blockStartGain) * (start + numOfChunkSamples) / numOfSamples;
+
+            AudioBuffer<float> chunk (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, numOfChunkSamples);
+            laterChunkMidi.clear();
+            renderSplit (sequence, transitionFrom, chunk, start == 0 ? midiMessages : laterChunkMidi);
+        }
+
+        startGain = blockStartGain;
+        endGain   = blockEndGain;
+        return;
+    }
+
+    const int numOfBranchChannels = jmin (buffer.getNumChannels(), sequence.branchBuffers[0].getNumChannels());
+    const bool isMidSide = sequence.layout.splitMode == chainLayoutType::midSide && numOfBranchChannels >= 2;
+    const uint32 skippedSlots = getSkippedSlots (sequence, transitionFrom);
+
+    // a late branch's buffers and job still belong to its worker, it is left out of this block
+    for (int branch = 0; branch < chainSequenceType::numOfBranches; ++branch)
+    {
+        runsBranchAt[branch].store (! isLate (branch), std::memory_order_relaxed);
+        if (isLate (branch))
+            continue;
+
+        AudioBuffer<float>& branchBuffer = sequence.branchBuffers[branch];
+
+        if (isMidSide)
+        {
+            // mid = (L + R) / 2 into every channel of branch 0, side = (L - R) / 2 into branch 1
+            const float* left  = buffer.getReadPointer (0);
+            const float* right = buffer.getReadPointer (1);
+            if (branch == 0)
+                FloatVectorOperations::add      (branchBuffer.getWritePointer (0), left, right, numOfSamples);
+            else
+                FloatVectorOperations::subtract (branchBuffer.getWritePointer (0), left, right, numOfSamples);
+            FloatVectorOperations::multiply (branchBuffer.getWritePointer (0), 0.5f, numOfSamples);
+
+            for (int channel = 1; channel < numOfBranchChannels; ++channel)
+                branchBuffer.copyFrom (channel, 0, branchBuffer, 0, 0, numOfSamples);
+        }
+        else
+        {
+            for (int channel = 0; channel < numOfBranchChannels; ++channel)
+                branchBuffer.copyFrom (channel, 0, buffer, channel, 0, numOfSamples);
+        }
+
+        // every branch runs on its own copy of the MIDI, branch 0's goes out with the block
+        branchMidi[branch].clear();
+        branchMidi[branch].addEvents (midiMessages, 0, numOfSamples, 0);
+
+        branchJobType& job = branchJobs[branch];
+        job.sequence     = &sequence;
+        job.from         = transitionFrom;
+        job.numOfSamples = numOfSamples;
+        job.startGain    = startGain;
+        job.endGain      = endGain;
+        job.skippedSlots = skippedSlots;
+    }
+
+    const uint32 lateBranchesBefore = lateBranches;
+    const uint32 newLateBranches = workerPool.run (*this, chainSequenceType::numOfBranches) & ~lateBranchesBefore;
+    if (newLateBranches != 0)
+        updateLateBranches (lateBranchesBefore | newLateBranches);
+
+    AudioBuffer<float>& branch0 = sequence.branchBuffers[0];
+    AudioBuffer<float>& branch1 = sequence.branchBuffers[1];
+
+    if (isMidSide)
+    {
+        // left and right each come from their own channel of the branches, a dropped branch adds nothing
+        float* left  = buffer.getWritePointer (0);
+        float* right = buffer.getWritePointer (1);
+        FloatVectorOperations::clear (left,  numOfSamples);
+        FloatVectorOperations::clear (right, numOfSamples);
+
+        if (! isLate (0))
+        {
+            FloatVectorOperations::add (left,  branch0.getReadPointer (0), numOfSamples);
+            FloatVectorOperations::add (right, branch0.getReadPointer (1), numOfSamples);
+        }
+        if (! isLate (1))
+        {
+            FloatVectorOperations::add      (left,  branch1.getReadPointer (0), numOfSamples);
+            FloatVectorOperations::subtract (right, right, branch1.getReadPointer (1), numOfSamples);
+        }
+    }
+    else
+    {
+        for (int channel = 0; channel < numOfBranchChannels; ++channel)
+        {
+            buffer.clear (channel, 0, numOfSamples);
+            for (int branch = 0; branch < chainSequenceType::numOfBranches; ++branch)
+                if (! isLate (branch))
+                    buffer.addFrom (channel, 0, sequence.branchBuffers[branch], channel, 0, numOfSamples);
+        }
+    }
+
+    // without branch 0 the block's MIDI goes out as it came in
+    if (! isLate (0))
+    {
+        midiMessages.clear();
+        midiMessages.addEvents (branchMidi[0], 0, numOfSamples, 0);
+    }
+}
+
+void ChainRenderer::runTask (int branch)
+{
+    // a branch that is still late from an earlier block is left to its worker
+    if (! runsBranchAt[branch].load (std::memory_order_relaxed))
+        return;
+
+    const branchJobType& job = branchJobs[branch];
+    chainSequenceType& sequence = *job.sequence;
+    const int numOfSamples = job.numOfSamples;
+
+    AudioBuffer<float>& branchBuffer = sequence.branchBuffers[branch];
+    AudioBuffer<float> branchBlock (branchBuffer.getArrayOfWritePointers(), branchBuffer.getNumChannels(), numOfSamples);
+
+    renderBranch (job, branch, branchBlock, branchMidi[branch]);
+
+    // the shorter branch waits for the longer one, so both are joined sample aligned
+    const int delay = sequence.getBranchDelay (branch);
+    if (delay <= 0)
+        return;
+
+    AudioBuffer<float>& delayBuffer = sequence.delayBuffers[branch];
+    const int delayLength = delayBuffer.getNumSamples();
+    const int startPosition = sequence.delayPositions[branch];
+    int position = startPosition;
+
+    for (int channel = 0; channel < delayBuffer.getNumChannels(); ++channel)
+    {
+        float* samples = branchBlock.getWritePointer (channel);
+        float* delayLine = delayBuffer.getWritePointer (channel);
+        position = startPosition;
+
+        // a ring of delay + 1 samples: the slot after the one just written holds the oldest sample
+        for (int i = 0; i < numOfSamples; ++i)
+        {
+            delayLine[position] = samples[i];
+            if (++position == delayLength)
+                position = 0;
+            samples[i] = delayLine[position];
+        }
+    }
+
+    sequence.delayPositions[branch] = position;
+}
+
+void ChainRenderer::renderBranch (const branchJobType& job, int branch, AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
+{
+    const chainSequenceType& sequence = *job.sequence;
+    AudioBuffer<float>& wetBuffer = job.sequence->wetBuffers[branch];
+
+    for (int slot = 0; slot < chainSequenceType::numOfSlots; ++slot)
+    {
+        if (sequence.layout.getBranch (slot) != branch)
+            continue;
+
+        // a processor a late worker is still running is bypassed
+        AudioProcessorGraph::Node* const to   = (job.skippedSlots >> slot) & 1 ? nullptr : sequence.slots[slot].get();
+        AudioProcessorGraph::Node* const from = job.from == nullptr ? to
+                                              : (job.skippedSlots >> (chainSequenceType::numOfSlots + slot)) & 1 ? nullptr
+                                              : job.from->slots[slot].get();
+
+        if (from == to)
+        {
+            if (to != nullptr)
+                processSlot (*to->getProcessor(), buffer, midiMessages, wetBuffer, 1.0f, 1.0f);
+            continue;
+        }
+
+        if (from != nullptr)
+            processSlot (*from->getProcessor(), buffer, midiMessages, wetBuffer, 1.0f - job.startGain, 1.0f - job.endGain);
+        if (to != nullptr)
+            processSlot (*to->getProcessor(), buffer, midiMessages, wetBuffer, job.startGain, job.endGain);
+    }
+}
+
+void ChainRenderer::updateLateBranches (uint32 runningBranches)
+{
+    lateBranches = runningBranches;
+    numOfLateProcessors = 0;
+
+    for (int branch = 0; branch < chainSequenceType::numOfBranches; ++branch)
+    {
+        std::atomic<chainSequenceType*>* const lateSequences = lateSequencesAt + 2 * branch;
+
+        if (! isLate (branch))
+        {
+            lateSequences[0].store (nullptr);
+            lateSequences[1].store (nullptr);
+            continue;
+        }
+
+        const branchJobType& job = branchJobs[branch];
+        lateSequences[0].store (job.sequence);
+        lateSequences[1].store (job.from);
+
+        for (int slot = 0; slot < chainSequenceType::numOfSlots; ++slot)
+        {
+            if (job.sequence->layout.getBranch (slot) != branch)
+                continue;
+
+            if (AudioProcessorGraph::Node* to = job.sequence->slots[slot].get())
+                lateProcessors[numOfLateProcessors++] = to->getProcessor();
+            if (job.from != nullptr)
+                if (AudioProcessorGraph::Node* from = job.from->slots[slot].get())
+                    lateProcessors[numOfLateProcessors++] = from->getProcessor();
+        }
+    }
+}
+
+uint32 ChainRenderer::getSkippedSlots (const chainSequenceType& sequence, const chainSequenceType* from) const
+{
+    if (numOfLateProcessors == 0)
+        return 0;
+
+    auto isLateNode = [this] (const AudioProcessorGraph::Node::Ptr& node)
+    {
+        return node != nullptr && std::find (lateProcessors, lateProcessors + numOfLateProcessors, node->getProcessor()) != lateProcessors + numOfLateProcessors;
+    };
+
+    uint32 skippedSlots = 0;
+    for (int slot = 0; slot < chainSequenceType::numOfSlots; ++slot)
+    {
+        if (isLateNode (sequence.slots[slot]))
+            skippedSlots |= (uint32) 1 << slot;
+        if (from != nullptr && isLateNode (from->slots[slot]))
+            skippedSlots |= (uint32) 1 << (chainSequenceType::numOfSlots + slot);
+    }
+
+    return skippedSlots;
+}
+
+void ChainRenderer::processSlot (AudioProcessor& processor, AudioBuffer<float>& buffer, MidiBuffer& midiMessages,
+                                 AudioBuffer<float>& wetBuffer, float slotStartGain, float slotEndGain)
+{
+    const int numOfSamples = buffer.getNumSamples();
+    const int numOfBufferChannels = buffer.getNumChannels();
+    const int numOfProcessorChannels = jmax (processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels());
+
+    const bool fitsScratch = numOfSamples <= wetBuffer.getNumSamples() && numOfProcessorChannels <= wetBuffer.getNumChannels();
+    const bool isFullyWet  = slotStartGain == 1.0f && slotEndGain == 1.0f;
+
+    // in place when possible, the channels the processor does not have pass through
+    if ((isFullyWet && numOfProcessorChannels <= numOfBufferChannels) || ! fitsScratch)
+    {
+        AudioBuffer<float> processorBuffer (buffer.getArrayOfWritePointers(), jmin (numOfProcessorChannels, numOfBufferChannels), numOfSamples);
+        processor.processBlock (processorBuffer, midiMessages);
+        return;
+    }
+
+    AudioBuffer<float> processorBuffer (wetBuffer.getArrayOfWritePointers(), numOfProcessorChannels, numOfSamples);
+    for (int channel = 0; channel < numOfProcessorChannels; ++channel)
+    {
+        if (channel < numOfBufferChannels)
+            processorBuffer.copyFrom (channel, 0, buffer, channel, 0, numOfSamples);
+        else
+            processorBuffer.clear (channel, 0, numOfSamples);
+    }
+
+    processor.processBlock (processorBuffer, midiMessages);
+
+    // buffer = dry + gain * (wet - dry), with the gain ramping over the block
+    for (int channel = 0; channel < jmin (numOfBufferChannels, numOfProcessorChannels); ++channel)
+    {
+        buffer.applyGainRamp (channel, 0, numOfSamples, 1.0f - slotStartGain, 1.0f - slotEndGain);
+        buffer.addFromWithRamp (channel, 0, processorBuffer.getReadPointer (channel), numOfSamples, slotStartGain, slotEndGain);
+    }
+}
@@ -0,0 +1,260 @@
+#pragma once
+#include "JuceHeader.h"
+#include "ReleasePool.h"
+
+//==============================================================================
+/** Runs the tasks of one block on a few real-time worker threads and on the calling
+    (audio) thread. Every thread takes the next task nobody has claimed yet from one
+    shared counter. This is not work stealing, there are no per-thread queues: with a
+    handful of tasks per block one counter is all the balancing there is to do.
+
+    Workers run at the highest priority JUCE offers (SCHED_RR on Linux, time critical on
+    Windows) and on macOS with a time constraint policy of one block period, like an audio
+    I/O thread. After its last task a worker polls for a few microseconds, then parks
+    until run() wakes it for the next batch.
+
+    A task a worker has started cannot be taken back, no plugin may run on two threads.
+    run() waits for the workers' tasks for half a block period at most, then returns without
+    the late ones and reports them; their data belongs to the worker until getRunningTasks()
+    no longer has them. The next blocks run on the calling thread alone for a while, instead
+    of handing tasks to a worker that the system is not scheduling.
+*/
+class ChainWorkerPool
+{
+public:
+    struct taskListType
+    {
+        virtual ~taskListType() {}
+        virtual void runTask (int index) = 0;
+    };
+
+    enum { maxNumOfTasks = 32 };
+
+    ChainWorkerPool();
+    ~ChainWorkerPool();
+
+    /** Message thread: starts or stops workers, for blocks of this duration. Workers only
+        take a new period when they start, so a new period restarts them; call it with the
+        audio stopped then. A worker that is stopped finishes its task first, it is never killed. */
+    void setNumOfWorkers (int numOfWorkers, double blockPeriodSeconds);
+
+    /** Audio thread: runs tasks 0 .. numOfTasks - 1 and returns when all of them are done,
+        or when half a block period has passed. Returns a bit mask of the tasks that were
+        still running on a worker then. */
+    uint32 run (taskListType& tasks, int numOfTasks);
+
+    /** Audio thread, between two run() calls: a bit mask of the tasks that are still
+        running on a worker, late ones of an earlier batch. */
+    uint32 getRunningTasks() const;
+
+private:
+    class Worker;
+
+    bool runNextTask (std::atomic<uint64>* runningTask);   // any thread: claims and runs one task, false when none is left
+    bool hasTaskToClaim() const;
+    void wakeWorkers();
+
+    OwnedArray<Worker> workers;
+    double blockPeriod = 0;
+    std::atomic<int64> waitDeadlineTicksAt;
+    int numOfSerialBatchesLeft = 0;             // audio thread
+    static const int numOfSerialBatchesAfterLateWorker = 256;
+
+    std::atomic<uint64> claimState;             // batch number << 32 | index of the next task
+    std::atomic<uint64> finishedState;          // batch number << 32 | bit mask of the finished tasks
+    static const uint64 noTaskIndex = 0xffffffff;
+    static const uint64 notRunning = ~(uint64) 0;
+    std::atomic<taskListType*> currentTasks;
+    std::atomic<int> numOfCurrentTasks;
+
+    JUCE_DECLARE_NON_COPYABLE (ChainWorkerPool)
+};
+
+//==============================================================================
+/** How the six slots are arranged: one series chain, or two branches that each run
+    their slots in series and are joined again with their latencies compensated.
+*/
+struct chainLayoutType
+{
+    enum { numOfSlots = 6, numOfBranches = 2 };
+
+    enum splitModeType
+    {
+        series = 0,     // every slot in slot order, the branches are ignored
+        parallel,       // both branches get the input, their outputs are summed
+        midSide         // branch 0 gets mid, branch 1 side, decoded back to left / right
+    };
+
+    splitModeType splitMode = series;
+    int slotBranch[numOfSlots] = {};
+
+    int getBranch (int slot) const      { return splitMode == series ? 0 : slotBranch[slot]; }
+    bool operator== (const chainLayoutType& other) const;
+    bool operator!= (const chainLayoutType& other) const   { return ! operator== (other); }
+};
+
+//==============================================================================
+/** The hosted chain as the plugin's state stores it: per slot the plugin with its own
+    state, bypass and branch, and the split mode. The offline tools read it as well, so a
+    chain saved by a host is rebuilt without the plugin.
+*/
+struct savedChainType
+{
+    enum { numOfSlots = chainLayoutType::numOfSlots };
+
+    struct slotType
+    {
+        bool isLoaded   = false;
+        bool isBypassed = false;
+        bool isVisible  = false;        // its plugin window was open
+        PluginDescription description;
+        MemoryBlock state;
+    };
+
+    slotType slots[numOfSlots];
+    chainLayoutType layout;
+
+    /** Adds the slot attributes and the descriptions and states of the loaded plugins to the plugin's root element. */
+    void writeToXml (XmlElement& rootXml) const;
+
+    /** A loaded slot without a description comes back empty. */
+    void readFromXml (const XmlElement& rootXml);
+};
+
+//==============================================================================
+/** One immutable topology of the hosted chain: the nodes that run, in slot order. */
+struct chainSequenceType
+{
+    enum { numOfSlots = chainLayoutType::numOfSlots, numOfBranches = chainLayoutType::numOfBranches };
+
+    AudioProcessorGraph::Node::Ptr slots[numOfSlots];   // nullptr for empty or bypassed slots
+    chainLayoutType layout;
+    int branchLatency[numOfBranches] = {};
+    int latencySamples = 0;
+
+    bool isSplit() const                { return layout.splitMode != chainLayoutType::series; }
+    int getBranchDelay (int branch) const  { return latencySamples - branchLatency[branch]; }
+    bool hasSameLayout (const chainSequenceType& other) const;
+
+    // one set per branch, as the branches run at the same time
+    AudioBuffer<float> wetBuffers[numOfBranches];       // slots with more channels than the strip, crossfades
+    AudioBuffer<float> branchBuffers[numOfBranches];
+    AudioBuffer<float> delayBuffers[numOfBranches];     // the shorter branch waits for the longer one
+    int delayPositions[numOfBranches] = {};
+};
+
+//==============================================================================
+/** Renders the hosted chain on the audio thread without ever taking a lock.
+    A new topology is built on the message thread and handed over through an atomic
+    pointer; the audio thread swaps it in at a block boundary and crossfades every slot
+    that comes or goes. A new layout dips the old sequence out and the new one in.
+    Replaced sequences are retired through a ReleasePool.
+
+    A branch a worker does not finish in time is dropped from the block, it adds silence.
+    Until the worker is done its processors are bypassed in every sequence, and the
+    sequences it renders stay in flight.
+*/
+class ChainRenderer  : private Timer,
+                       private ChainWorkerPool::taskListType
+{
+public:
+    typedef Array<AudioProcessorGraph::Node::Ptr> slotNodesType;
+
+    ChainRenderer();
+    ~ChainRenderer();
+
+    /** Message thread, with the audio stopped: new settings, the chain is rebuilt and installed at once. */
+    void prepare (double sampleRate, int maxBlockSize, int numOfChannels);
+
+    /** Message thread: one node per slot, nullptr for the slots that do not run.
+        Prepares the processors no sequence in flight runs yet and queues the new sequence for the audio thread.
+    */
+    void setChain (const slotNodesType& slotNodes, const chainLayoutType& layout);
+
+    enum processResultType { renderedBlock = 0, swappedSequence = 1, cutCrossfade = 2 };
+
+    /** Audio thread. Returns processResultType flags: swappedSequence when a new sequence was
+        swapped in at the start of this block, cutCrossfade when the block did not fit the
+        crossfade scratch space and the new sequence took over without a ramp. */
+    int process (AudioBuffer<float>& buffer, MidiBuffer& midiMessages);
+
+    /** Latency of the sequence the audio thread is running. */
+    int getLatencySamples() const       { return latencySamplesAt.load(); }
+
+private:
+    typedef std::shared_ptr<chainSequenceType> sequencePtr;
+
+    sequencePtr createSequence (const slotNodesType& slotNodes, const chainLayoutType& layout);
+    bool isInFlight (const AudioProcessorGraph::Node* node) const;
+    void publish (const sequencePtr& sequence);
+    void updateNumOfWorkers();
+    void timerCallback() override;
+
+    /** What one branch renders. The workers only read the job of their branch, and the job
+        of a late branch is not touched until its worker is done with it. */
+    struct branchJobType
+    {
+        chainSequenceType* sequence = nullptr;
+        chainSequenceType* from = nullptr;        // per slot crossfade from this sequence, or nullptr
+        int numOfSamples = 0;
+        float startGain = 1.0f, endGain = 1.0f;
+        uint32 skippedSlots = 0;                  // bit slot: bypass the slot's processor, bit numOfSlots + slot: the one it fades from
+    };
+
+    void renderSequence (chainSequenceType& sequence, chainSequenceType* transitionFrom,
+                         AudioBuffer<float>& buffer, MidiBuffer& midiMessages);
+    void renderSplit (chainSequenceType& sequence, chainSequenceType* transitionFrom,
+                      AudioBuffer<float>& buffer, MidiBuffer& midiMessages);
+    void runTask (int branch) override;
+    void renderBranch (const branchJobType& job, int branch, AudioBuffer<float>& buffer, MidiBuffer& midiMessages);
+    void processSlot (AudioProcessor& processor, AudioBuffer<float>& buffer, MidiBuffer& midiMessages,
+                      AudioBuffer<float>& wetBuffer, float startGain, float endGain);
+
+    bool isLate (int branch) const      { return (lateBranches >> branch) & 1; }
+    void updateLateBranches (uint32 runningBranches);
+    uint32 getSkippedSlots (const chainSequenceType& sequence, const chainSequenceType* from) const;
+
+    // message thread
+    ReleasePool releasePool;
+    std::vector<sequencePtr> sequencesInFlight;   // published, the audio thread may hold them
+    sequencePtr queuedSequence;                   // waits until the previous swap is done
+    slotNodesType lastSlotNodes;
+    chainLayoutType lastLayout;
+    double sampleRate = 0;
+    int maxBlockSize = 0;
+    int numOfChannels = 2;
+
+    // handed from the message thread to the audio thread and back
+    std::atomic<chainSequenceType*> pendingAt;
+    std::atomic<chainSequenceType*> activeAt;
+    std::atomic<chainSequenceType*> fadingAt;
+    std::atomic<int> latencySamplesAt;
+    std::atomic<int> crossfadeLengthAt;
+
+    // audio thread
+    chainSequenceType* active = nullptr;
+    chainSequenceType* fading = nullptr;
+    int crossfadePosition = 0;
+
+    float startGain = 1.0f, endGain = 1.0f;
+    MidiBuffer laterChunkMidi;                    // the block's MIDI goes with its first chunk only
+
+    // the branches of the block being rendered, each read by the thread that runs it
+    branchJobType branchJobs[chainSequenceType::numOfBranches];
+    MidiBuffer branchMidi[chainSequenceType::numOfBranches];
+    std::atomic<bool> runsBranchAt[chainSequenceType::numOfBranches];
+
+    // branches a worker was still running at the deadline, and their processors (audio thread)
+    uint32 lateBranches = 0;
+    AudioProcessor* lateProcessors[2 * chainSequenceType::numOfSlots];
+    int numOfLateProcessors = 0;
+
+    // the sequences of the late branches, the message thread keeps them in flight
+    std::atomic<chainSequenceType*> lateSequencesAt[2 * chainSequenceType::numOfBranches];
+
+    ChainWorkerPool workerPool;
+
+    static constexpr double crossfadeSeconds = 0.01;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChainRenderer)
+};
@@ -95,7 +95,9 @@ ChannelStripAnalyserAudioProcessorEditor::ChannelStripAnalyserAudioProcessorEdit
         processor (p),
         parameters (params),
         mainAudioBufferSystem (bufSys),
-        forwFFT (fftSize, processor. getTotalNumInputChannels())
+        forwFFT (fftSize),
+        stftAnalyser (fftSize, (int) p.getSampleRate(), mainAudioBufferSystem, forwFFT),
+        analysisThread (mainAudioBufferSystem, stftAnalyser, *this)
 {
     myOpenGLContext.attachTo(*this);
     addUiElements();
@@ -107,11 +109,13 @@ ChannelStripAnalyserAudioProcessorEditor::ChannelStripAnalyserAudioProcessorEdit
     const int sampleRate = processor.getSampleRate();
     
     addAndMakeVisible
-        (spectrumAnalyser   = new SpectrumAnalyser   (sampleRate, fftSize, numOfChannels, mainAudioBufferSystem, forwFFT));
+        (spectrumAnalyser   = new SpectrumAnalyser   (sampleRate, fftSize, numOfChannels, mainAudioBufferSystem, stftAnalyser));
     addAndMakeVisible
-        (spectrumDifference = new SpectrumDifference (sampleRate, fftSize, numOfChannels, mainAudioBufferSystem, forwFFT));
+        (spectrumDifference = new SpectrumDifference (sampleRate, fftSize, numOfChannels, mainAudioBufferSystem, stftAnalyser));
     addAndMakeVisible
-        ( phaseDifference   = new PhaseDifference    (sampleRate, fftSize, numOfChannels, mainAudioBufferSystem, forwFFT));
+        ( phaseDifference   = new PhaseDifference    (sampleRate, fftSize, numOfChannels, mainAudioBufferSystem, stftAnalyser));
+    addChildComponent
+        (coherenceAnalyser  = new CoherenceAnalyser  (sampleRate, fftSize, mainAudioBufferSystem, stftAnalyser));
     addAndMakeVisible
         (stereoAnalyser     = new StereoAnalyser     (sampleRate, fftSize, mainAudioBufferSystem, forwFFT));
     addAndMakeVisible
@@ -119,6 +123,26 @@ ChannelStripAnalyserAudioProcessorEditor::ChannelStripAnalyserAudioProcessorEdit
     addAndMakeVisible
         (levelMeter         = new LevelMeter         (sampleRate, fftSize, mainAudioBufferSystem));
     
+    // addUiElements() ran before the views existed, the toggles take their defaults now
+    vectorscopePersistenceButton     .setToggleState (stereoAnalyser   -> persistenceModeAt.load(), dontSendNotification);
+    vectorscopeBandCorrelationButton .setToggleState (stereoAnalyser   -> bandCorrelationAt.load(), dontSendNotification);
+    spectrumInterpolationButton      .setToggleState (spectrumAnalyser -> interpolationAt.load(),   dontSendNotification);
+    
+    alignmentEstimator = new AlignmentEstimator (sampleRate, mainAudioBufferSystem);
+    
+    addChildComponent
+        (audioThreadStatsOverlay = new AudioThreadStatsOverlay (processor.audioThreadStats, mainAudioBufferSystem));
+    audioThreadStatsOverlay -> setBounds (20, 100, 340, 240);
+    
+    analysisThread.addClient (alignmentEstimator);
+    analysisThread.addClient (spectrumAnalyser);
+    analysisThread.addClient (spectrumDifference);
+    analysisThread.addClient (phaseDifference);
+    analysisThread.addClient (coherenceAnalyser);
+    analysisThread.addClient (stereoAnalyser);
+    analysisThread.addClient (waveformAnalyser);
+    analysisThread.addClient (levelMeter);
+    
     createParametersAttachments();
     
     pluginWinState   = false;
@@ -130,6 +154,9 @@ ChannelStripAnalyserAudioProcessorEditor::ChannelStripAnalyserAudioProcessorEdit
         editors.add(nullptr);
     }
     
+    if (processor.getSampleRate() > 0)
+        analysisThread.setHopSize (roundToInt (processor.getSampleRate() * ( 43 / 1000.0 ))); // one frame every ~43 ms of audio
+    analysisThread.startThread();
     triggerAsyncUpdate();
     Timer::startTimer(100);
 }
@@ -137,31 +164,27 @@ ChannelStripAnalyserAudioProcessorEditor::ChannelStripAnalyserAudioProcessorEdit
 ChannelStripAnalyserAudioProcessorEditor::~ChannelStripAnalyserAudioProcessorEditor()
 {
     Timer::stopTimer();
-    HighResolutionTimer::stopTimer();
-}
-
-void ChannelStripAnalyserAudioProcessorEditor::hiResTimerCallback()
-{
-    mainAudioBufferSystem.pushAudioBufferIntoHistoryBuffer();
-    
-    if (isUpdatePending()) cancelPendingUpdate();
-    triggerAsyncUpdate();
+    analysisThread.stopThread (2000);
 }
 
 void ChannelStripAnalyserAudioProcessorEditor::handleAsyncUpdate()
 {
-    if ( ! HighResolutionTimer::isTimerRunning())
-        HighResolutionTimer::startTimer(43);
-    
     spectrumAnalyser   -> repaint();
     spectrumDifference -> repaint();
     phaseDifference    -> repaint();
+    coherenceAnalyser  -> repaint();
     stereoAnalyser     -> repaint();
     waveformAnalyser   -> repaint();
     levelMeter         -> repaint();
     
-    String processorDelay   = (String) ( processor.graph.getLatencySamples() );
+    // the reported chain latency, corrected by what the alignment estimator measured
+    const float alignmentOffset = alignmentEstimator -> getOffset();
+    String processorDelay   = (String) ( processor.getChainLatencySamples() );
+    if (std::abs (alignmentOffset) >= 0.01f)
+        processorDelay = String (processor.getChainLatencySamples() + alignmentOffset, 2);
     textEditorTotalDelay -> setText(processorDelay);
+    textEditorTotalDelay -> setTooltip ("reported " + String (processor.getChainLatencySamples()) + ", measured offset "
+                                        + String (alignmentOffset, 2) + " samples (peak / rms " + String (alignmentEstimator -> getConfidence(), 1) + ")");
 }
 
 void ChannelStripAnalyserAudioProcessorEditor::timerCallback()
@@ -188,6 +211,12 @@ void ChannelStripAnalyserAudioProcessorEditor::timerCallback()
         if (processor.plugIns[i])
             if (editors[i] != nullptr) processor.shownPlugins[i] = editors[i]->isVisible();
     }
+    
+    if (audioThreadStatsOverlay -> isVisible())
+        audioThreadStatsOverlay -> update();
+    
+    if (++numOfTimerCallbacks % 5 == 0)
+        updateSlotTimings();
 }
 
 PluginDescription* ChannelStripAnalyserAudioProcessorEditor::getChosenType(const int menuID) const
@@ -235,6 +264,32 @@ void ChannelStripAnalyserAudioProcessorEditor::createNewPlugin(const PluginDescr
     }
 }
 
+void ChannelStripAnalyserAudioProcessorEditor::updateSlotTimings()
+{
+    // p99 and max time of each hosted plugin as a part of the block period, under its name
+    for (auto i = 0; i < 6; i++)
+    {
+        Label* timingLabel = pluginTimingLabels[i];
+        slotTimings[i] = processor.audioThreadStats.getSlotTiming (i, slotTimings[i]);
+        const slotTimingType& timing = slotTimings[i];
+        
+        if (! processor.plugIns[i] || timing.numOfBlocks == 0 || timing.deadlineUs <= 0)
+        {
+            timingLabel->setText (String(), dontSendNotification);
+            timingLabel->setTooltip (String());
+            continue;
+        }
+        
+        const double p99Load = timing.getDeadlineFraction (timing.p99Us);
+        const double maxLoad = timing.getDeadlineFraction (timing.maxUs);
+        timingLabel->setText ("p99 " + String (100.0 * p99Load, 1) + "%   max " + String (100.0 * maxLoad, 1) + "%", dontSendNotification);
+        timingLabel->setColour (Label::textColourId, maxLoad >= 1.0 ? Colours::red : (p99Load >= 0.5 ? Colours::orange : Colours::aliceblue));
+        timingLabel->setTooltip ("min " + String (timing.minUs, 1) + " us, mean " + String (timing.meanUs, 1)
+                                 + " us, p99 " + String (timing.p99Us, 1) + " us, max " + String (timing.maxUs, 1)
+                                 + " us of a " + String (timing.deadlineUs, 0) + " us block");
+    }
+}
+
 void ChannelStripAnalyserAudioProcessorEditor::deletePlugin(int i)
 {
     
@@ -262,56 +317,49 @@ void ChannelStripAnalyserAudioProcessorEditor::deletePlugin(int i)
 
 void ChannelStripAnalyserAudioProcessorEditor::fftSizeChanged() 
 {
-    cancelPendingUpdate();
-    if (HighResolutionTimer::isTimerRunning())
-        HighResolutionTimer::stopTimer();
-
-    const int numOfChannels = processor.getTotalNumInputChannels();
-    const int sampleRate = processor.getSampleRate();
-
-    switch (fftSizeButton->getSelectedId())
-    {
-        case 1:
-            forwFFT.changeFFTSize(1024);
-            fftSize = 1024;
-            spectrumAnalyser.reset   ( new SpectrumAnalyser   (sampleRate, fftSize, numOfChannels, mainAudioBufferSystem, forwFFT));
-            spectrumDifference.reset ( new SpectrumDifference (sampleRate, fftSize, numOfChannels, mainAudioBufferSystem, forwFFT));
-            phaseDifference.reset    ( new PhaseDifference    (sampleRate, fftSize, numOfChannels, mainAudioBufferSystem, forwFFT));
-            break;
-            
-        case 2:
-            forwFFT.changeFFTSize(2048);
-            fftSize = 2048;
-            spectrumAnalyser.reset   ( new SpectrumAnalyser   (sampleRate, fftSize, numOfChannels, mainAudioBufferSystem, forwFFT));
-            spectrumDifference.reset ( new SpectrumDifference (sampleRate, fftSize, numOfChannels, mainAudioBufferSystem, forwFFT));
-            phaseDifference.reset    ( new PhaseDifference    (sampleRate, fftSize, numOfChannels, mainAudioBufferSystem, forwFFT));
-            break;
-            
-        case 3:
-            forwFFT.changeFFTSize(4096);
-            fftSize = 4096;
-            spectrumAnalyser.reset   ( new SpectrumAnalyser   (sampleRate, fftSize, numOfChannels, mainAudioBufferSystem, forwFFT));
-            spectrumDifference.reset ( new SpectrumDifference (sampleRate, fftSize, numOfChannels, mainAudioBufferSystem, forwFFT));
-            phaseDifference.reset    ( new PhaseDifference    (sampleRate, fftSize, numOfChannels, mainAudioBufferSystem, forwFFT));
-            break;
-    }
-    
-    addAndMakeVisible(spectrumAnalyser);
-    addAndMakeVisible(spectrumDifference);
-    addAndMakeVisible(phaseDifference);
-    
-    sliderValueChanged(&sliderSpectrumAnalyserRange);
-    sliderValueChanged(&sliderSpectrumAnalyserReturnTime);
+    // the plan is built in the background; the analysis thread switches the STFT and the
+    // views over once it is ready, until then the old size keeps being drawn
+    // 1: 1024 ... 7: 65536
+    const int selectedId = fftSizeButton->getSelectedId();
+    if (selectedId < 1 || selectedId > 7)
+        return;
+    
+    fftSize = 1024 << (selectedId - 1);
+    stftAnalyser.setFFTSize (fftSize);
+}
 
-    sliderValueChanged(&sliderSpectrumDifferenceRange);
-    sliderValueChanged(&sliderSpectrumDifferenceTimeAverage);
 
+void ChannelStripAnalyserAudioProcessorEditor::lowerViewChanged()
+{
+    // 1: phase difference, 2: coherence in third octaves, 3: coherence in ERBs
+    const int viewId = lowerViewBox->getSelectedId();
+    
+    if (viewId > 1)
+        coherenceAnalyser -> bandScaleAt.store (viewId == 2 ? frequencyBandTable::thirdOctaveBands
+                                                            : frequencyBandTable::erbBands);
+    phaseDifference   -> setVisible (viewId <= 1);
+    coherenceAnalyser -> setVisible (viewId > 1);
+}
 
-    if ( ! HighResolutionTimer::isTimerRunning())
-        HighResolutionTimer::startTimer(43);
 
+chainLayoutType ChannelStripAnalyserAudioProcessorEditor::getChainLayoutPreset (int presetId)
+{
+    // 1: series, 2: parallel 1-3 | 4-6, 3: mid/side 1-3 | 4-6, 4: dry | 1-6
+    chainLayoutType layout;
+    layout.splitMode = presetId == 2 || presetId == 4 ? chainLayoutType::parallel
+                     : presetId == 3                  ? chainLayoutType::midSide
+                                                      : chainLayoutType::series;
+    for (int slot = 0; slot < chainLayoutType::numOfSlots; ++slot)
+        layout.slotBranch[slot] = presetId == 4 || slot >= 3 ? 1 : 0;
+    return layout;
 }
 
+void ChannelStripAnalyserAudioProcessorEditor::chainLayoutChanged()
+{
+    // the renderer swaps the new layout in at a block boundary, dipping the old one out
+    processor.chainLayout = getChainLayoutPreset (chainLayoutBox->getSelectedId());
+    processor.AudioPluginChannelConfiguration();
+}
 
 //==============================================================================
 void ChannelStripAnalyserAudioProcessorEditor::paint (Graphics& g)
@@ -529,18 +577,22 @@ void ChannelStripAnalyserAudioProcessorEditor::sliderValueChanged (Slider* slide
             case 1:
                 spectrumDifference -> numOfHistorySamplesAt.store(3);
                 phaseDifference    -> numOfHistorySamplesAt.store(3);
+                coherenceAnalyser  -> numOfHistorySamplesAt.store(3);
                 break;
             case 2:
                 spectrumDifference -> numOfHistorySamplesAt.store(5);
                 phaseDifference    -> numOfHistorySamplesAt.store(5);
+                coherenceAnalyser  -> numOfHistorySamplesAt.store(5);
                 break;
             case 3:
                 spectrumDifference -> numOfHistorySamplesAt.store(8);
                 phaseDifference    -> numOfHistorySamplesAt.store(8);
+                coherenceAnalyser  -> numOfHistorySamplesAt.store(8);
                 break;
             case 4:
                 spectrumDifference -> numOfHistorySamplesAt.store(12);
                 phaseDifference    -> numOfHistorySamplesAt.store(12);
+                coherenceAnalyser  -> numOfHistorySamplesAt.store(12);
                 break;
         }
         //[/UserSliderCode_sliderTimeAverage]
@@ -572,19 +624,44 @@ void ChannelStripAnalyserAudioProcessorEditor::buttonClicked (Button* buttonThat
         if (freezeState == false)
         {
             freezeState = true;
-            HighResolutionTimer::stopTimer();
+            analysisThread.setPaused (true);
             freezeButton->setColour (TextButton::ColourIds::buttonColourId, Colour (0xff42a2c8) );
         }
         else
         {
             freezeState = false;
-            HighResolutionTimer::startTimer(43);
+            analysisThread.setPaused (false);
             freezeButton->setColour (TextButton::ColourIds::buttonColourId, Colour (0xff181f22).darker() );
         }
     }
+    else if (buttonThatWasClicked == audioStatsButton)
+    {
+        const bool showStats = ! audioThreadStatsOverlay -> isVisible();
+        if (showStats)
+            audioThreadStatsOverlay -> update();
+        audioThreadStatsOverlay -> setVisible (showStats);
+        audioStatsButton -> setToggleState (showStats, dontSendNotification);
+    }
     else if (buttonThatWasClicked == compensateDelay)
     {
         processor.triggerGraphPrepareToPlay();
+        alignmentEstimator -> reset();      // measure again against the newly reported latency
+    }
+    else if (buttonThatWasClicked == &vectorscopePersistenceButton)
+    {
+        stereoAnalyser -> persistenceModeAt.store (vectorscopePersistenceButton.getToggleState());
+    }
+    else if (buttonThatWasClicked == &vectorscopeBandCorrelationButton)
+    {
+        stereoAnalyser -> bandCorrelationAt.store (vectorscopeBandCorrelationButton.getToggleState());
+    }
+    else if (buttonThatWasClicked == &spectrumInterpolationButton)
+    {
+        spectrumAnalyser -> interpolationAt.store (spectrumInterpolationButton.getToggleState());
+    }
+    else if (buttonThatWasClicked == &fftMultiResolutionButton)
+    {
+        stftAnalyser.setMultiResolution (fftMultiResolutionButton.getToggleState());
     }
     else if (buttonThatWasClicked == &textButtonMonoMode)
     {
@@ -929,6 +1006,22 @@ void ChannelStripAnalyserAudioProcessorEditor::addUiElements()
     vectorscopeVanishTimeLabelText->setColour (TextEditor::backgroundColourId, Colour (0x00000000));
     vectorscopeVanishTimeLabelText->setBounds (981, 519, 150, 24);
     
+    addAndMakeVisible (vectorscopePersistenceButton);
+    vectorscopePersistenceButton.setButtonText (TRANS("persistence"));
+    vectorscopePersistenceButton.setTooltip (TRANS("the trail decays in place instead of being redrawn from the vanish time history"));
+    vectorscopePersistenceButton.setColour (ToggleButton::textColourId, Colours::black);
+    vectorscopePersistenceButton.setColour (ToggleButton::tickColourId, Colours::black);
+    vectorscopePersistenceButton.addListener (this);
+    vectorscopePersistenceButton.setBounds (905, 544, 105, 20);
+    
+    addAndMakeVisible (vectorscopeBandCorrelationButton);
+    vectorscopeBandCorrelationButton.setButtonText (TRANS("bands"));
+    vectorscopeBandCorrelationButton.setTooltip (TRANS("correlation below 250 Hz, up to 2.5 kHz and above, top to bottom in every bar"));
+    vectorscopeBandCorrelationButton.setColour (ToggleButton::textColourId, Colours::black);
+    vectorscopeBandCorrelationButton.setColour (ToggleButton::tickColourId, Colours::black);
+    vectorscopeBandCorrelationButton.addListener (this);
+    vectorscopeBandCorrelationButton.setBounds (1010, 544, 80, 20);
+    
     // ========================================================================================================================
     // SPECTRUM ANALYSER
 
@@ -1011,6 +1104,17 @@ void ChannelStripAnalyserAudioProcessorEditor::addUiElements()
     spectrumDifferencetimeAverageLabelText->setColour (TextEditor::backgroundColourId, Colour (0x00000000));
     spectrumDifferencetimeAverageLabelText->setBounds (981, 625, 80, 24);
     
+    addAndMakeVisible (differenceEstimatorBox = new ComboBox (String()));
+    differenceEstimatorBox->setColour(ComboBox::outlineColourId, Colours::grey);
+    differenceEstimatorBox->setColour(ComboBox::arrowColourId, Colour (0xff42a2c8));
+    differenceEstimatorBox->setColour(ComboBox::backgroundColourId, Colour (0xff181f22).darker());
+    differenceEstimatorBox->addItem("H1", 1);
+    differenceEstimatorBox->addItem("H2", 2);
+    differenceEstimatorBox->setSelectedId(1, dontSendNotification);
+    differenceEstimatorBox->setTooltip (TRANS("H1: Sxy / Sxx, unbiased by noise after the chain; H2: Syy / Syx, unbiased by noise before it"));
+    differenceEstimatorBox->setBounds (1062, 598, 50, 18);
+    differenceEstimatorBox->onChange = [this] { spectrumDifference -> estimatorAt.store (differenceEstimatorBox->getSelectedId() - 1); };
+    
     
 // ========================================================================================================================
     // MODE MONO STEREO MID/SIDE
@@ -1070,7 +1174,11 @@ void ChannelStripAnalyserAudioProcessorEditor::addUiElements()
     fftSizeButton->setColour(ComboBox::backgroundColourId, Colour (0xff181f22).darker());
     fftSizeButton->addItem("1024", 1);
     fftSizeButton->addItem("2048", 2);
-    fftSizeButton->addItem("4098", 3);
+    fftSizeButton->addItem("4096", 3);
+    fftSizeButton->addItem("8192", 4);
+    fftSizeButton->addItem("16384", 5);
+    fftSizeButton->addItem("32768", 6);
+    fftSizeButton->addItem("65536", 7);
     fftSizeButton->setSelectedId(1);
     fftSizeButton->setBounds (909, 662, 72, 18);
     fftSizeButton->onChange = [this] { fftSizeChanged(); };
@@ -1081,7 +1189,84 @@ void ChannelStripAnalyserAudioProcessorEditor::addUiElements()
     fftSizeLabelText->setEditable (false, false, false);
     fftSizeLabelText->setColour (TextEditor::textColourId, Colours::black);
     fftSizeLabelText->setColour (TextEditor::backgroundColourId, Colour (0x00000000));
-    fftSizeLabelText->setBounds (981, 662, 80, 24);
+    fftSizeLabelText->setBounds (981, 662, 58, 24);
+    
+    addAndMakeVisible (fftPaddingBox = new ComboBox (String()));
+    fftPaddingBox->setColour(ComboBox::outlineColourId, Colours::grey);
+    fftPaddingBox->setColour(ComboBox::arrowColourId, Colour (0xff42a2c8));
+    fftPaddingBox->setColour(ComboBox::backgroundColourId, Colour (0xff181f22).darker());
+    fftPaddingBox->addItem("x1", 1);
+    fftPaddingBox->addItem("x2", 2);
+    fftPaddingBox->addItem("x4", 3);
+    fftPaddingBox->setSelectedId(1, dontSendNotification);
+    fftPaddingBox->setTooltip (TRANS("zero padding: the transform is 2 or 4 times longer than the window, a smoother spectrum at the same resolution"));
+    fftPaddingBox->setBounds (1040, 662, 56, 18);
+    fftPaddingBox->onChange = [this] { stftAnalyser.setZeroPadding (1 << (jlimit (1, 3, fftPaddingBox->getSelectedId()) - 1)); };
+    
+    addAndMakeVisible (spectrumInterpolationButton);
+    spectrumInterpolationButton.setButtonText (TRANS("interp."));
+    spectrumInterpolationButton.setTooltip (TRANS("parabolic interpolation of the spectrum between bins and of its peaks"));
+    spectrumInterpolationButton.setColour (ToggleButton::textColourId, Colours::black);
+    spectrumInterpolationButton.setColour (ToggleButton::tickColourId, Colours::black);
+    spectrumInterpolationButton.addListener (this);
+    spectrumInterpolationButton.setBounds (1036, 687, 70, 20);
+    
+    addAndMakeVisible (fftMultiResolutionButton);
+    fftMultiResolutionButton.setButtonText (TRANS("multi-res"));
+    fftMultiResolutionButton.setTooltip (TRANS("spectrum, difference and phase from FFTs of the history decimated by 2 to 16, one octave more resolution per octave down"));
+    fftMultiResolutionButton.setColour (ToggleButton::textColourId, Colours::black);
+    fftMultiResolutionButton.setColour (ToggleButton::tickColourId, Colours::black);
+    fftMultiResolutionButton.addListener (this);
+    fftMultiResolutionButton.setBounds (1100, 661, 85, 20);
+    
+    addAndMakeVisible (fftWindowBox = new ComboBox (String()));
+    fftWindowBox->setColour(ComboBox::outlineColourId, Colours::grey);
+    fftWindowBox->setColour(ComboBox::arrowColourId, Colour (0xff42a2c8));
+    fftWindowBox->setColour(ComboBox::backgroundColourId, Colour (0xff181f22).darker());
+    fftWindowBox->addItem("Hann", 1 + forwardFFT::hannWindow);
+    fftWindowBox->addItem("Blackman-Harris", 1 + forwardFFT::blackmanHarrisWindow);
+    fftWindowBox->addItem("flat top", 1 + forwardFFT::flatTopWindow);
+    fftWindowBox->setSelectedId(1 + forwFFT.windowTypeAt.load(), dontSendNotification);
+    fftWindowBox->setTooltip (TRANS("FFT window: Hann, Blackman-Harris for low leakage, flat top for exact peak levels"));
+    fftWindowBox->setBounds (747, 694, 72, 18);
+    fftWindowBox->onChange = [this] { stftAnalyser.setWindowType ((forwardFFT::windowType) (fftWindowBox->getSelectedId() - 1)); };
+    
+    addAndMakeVisible (fftOverlapBox = new ComboBox (String()));
+    fftOverlapBox->setColour(ComboBox::outlineColourId, Colours::grey);
+    fftOverlapBox->setColour(ComboBox::arrowColourId, Colour (0xff42a2c8));
+    fftOverlapBox->setColour(ComboBox::backgroundColourId, Colour (0xff181f22).darker());
+    fftOverlapBox->addItem("0 %", 1);
+    fftOverlapBox->addItem("50 %", 2);
+    fftOverlapBox->addItem("75 %", 3);
+    fftOverlapBox->setSelectedId(2, dontSendNotification);
+    fftOverlapBox->setTooltip (TRANS("overlap of the FFT windows, every window since the last frame is averaged (Welch)"));
+    fftOverlapBox->setBounds (825, 694, 58, 18);
+    fftOverlapBox->onChange = [this]
+    {
+        const int overlaps[] = { 0, 50, 75 };
+        stftAnalyser.setOverlap (overlaps[jlimit (1, 3, fftOverlapBox->getSelectedId()) - 1]);
+    };
+    
+    // LOWER VIEW
+    addAndMakeVisible (lowerViewBox = new ComboBox (String()));
+    lowerViewBox->setColour(ComboBox::outlineColourId, Colours::grey);
+    lowerViewBox->setColour(ComboBox::arrowColourId, Colour (0xff42a2c8));
+    lowerViewBox->setColour(ComboBox::backgroundColourId, Colour (0xff181f22).darker());
+    lowerViewBox->addItem("phase", 1);
+    lowerViewBox->addItem("coh. 1/3 oct", 2);
+    lowerViewBox->addItem("coh. ERB", 3);
+    lowerViewBox->setSelectedId(1, dontSendNotification);
+    lowerViewBox->setTooltip (TRANS("lower view: pre / post phase difference, or the stereo correlation and coherence per band"));
+    lowerViewBox->setBounds (909, 688, 72, 18);
+    lowerViewBox->onChange = [this] { lowerViewChanged(); };
+    
+    addAndMakeVisible (lowerViewLabelText = new Label (String(),TRANS("view\n")));
+    lowerViewLabelText->setFont (Font ("Avenir Next", 15.00f, Font::plain).withTypefaceStyle ("Regular"));
+    lowerViewLabelText->setJustificationType (Justification::centredLeft);
+    lowerViewLabelText->setEditable (false, false, false);
+    lowerViewLabelText->setColour (TextEditor::textColourId, Colours::black);
+    lowerViewLabelText->setColour (TextEditor::backgroundColourId, Colour (0x00000000));
+    lowerViewLabelText->setBounds (981, 688, 52, 24);
     
     // DELAY
     addAndMakeVisible (textEditorTotalDelay = new TextEditor (String()));
@@ -1112,12 +1297,34 @@ void ChannelStripAnalyserAudioProcessorEditor::addUiElements()
     freezeButton->setColour (TextButton::buttonOnColourId, Colour (0xff181f22).brighter());
     freezeButton->setBounds (915, 720, 125, 40);
     
+    addAndMakeVisible (chainLayoutBox = new ComboBox (String()));
+    chainLayoutBox->setColour(ComboBox::outlineColourId, Colours::grey);
+    chainLayoutBox->setColour(ComboBox::arrowColourId, Colour (0xff42a2c8));
+    chainLayoutBox->setColour(ComboBox::backgroundColourId, Colour (0xff181f22).darker());
+    chainLayoutBox->addItem("series", 1);
+    chainLayoutBox->addItem("parallel 1-3 | 4-6", 2);
+    chainLayoutBox->addItem("mid/side 1-3 | 4-6", 3);
+    chainLayoutBox->addItem("dry | 1-6", 4);
+    for (int presetId = 1; presetId <= 4; ++presetId)
+        if (getChainLayoutPreset (presetId) == processor.chainLayout)
+            chainLayoutBox->setSelectedId (presetId, dontSendNotification);
+    chainLayoutBox->setTooltip (TRANS("chain layout: split branches run on their own threads and are joined latency compensated"));
+    chainLayoutBox->setBounds (915, 764, 125, 18);
+    chainLayoutBox->onChange = [this] { chainLayoutChanged(); };
+    
     addAndMakeVisible (compensateDelay = new TextButton (String()));
     compensateDelay->setButtonText (TRANS("compensate delay"));
     compensateDelay->addListener (this);
     compensateDelay->setColour (TextButton::buttonColourId, Colour (0xff181f22).darker());
     compensateDelay->setColour (TextButton::buttonOnColourId, Colour (0xff181f22).brighter());
     compensateDelay->setBounds (747, 742, 136, 18);
+    
+    addAndMakeVisible (audioStatsButton = new TextButton (String()));
+    audioStatsButton->setButtonText (TRANS("audio stats"));
+    audioStatsButton->addListener (this);
+    audioStatsButton->setColour (TextButton::buttonColourId, Colour (0xff181f22).darker());
+    audioStatsButton->setColour (TextButton::buttonOnColourId, Colour (0xff181f22).brighter());
+    audioStatsButton->setBounds (747, 764, 136, 18);
 
 // ========================================================================================================================
     // PLUGIN SLOTS
@@ -1310,6 +1517,18 @@ void ChannelStripAnalyserAudioProcessorEditor::addUiElements()
     pluginBypassButton6.addListener (this);
     pluginBypassButton6.setBounds (1056, 16, 24, 24);
     
+    // SLOT TIMINGS
+    for (auto i = 0; i < 6; i++)
+    {
+        Label* timingLabel = pluginTimingLabels.add (new Label());
+        timingLabel->setFont (Font (9.5f));
+        timingLabel->setJustificationType (Justification::centredLeft);
+        timingLabel->setColour (Label::textColourId, Colours::aliceblue);
+        timingLabel->setBorderSize (BorderSize<int> (0, 2, 0, 2));
+        timingLabel->setBounds (184 + i * 152, 72, 136, 9);
+        addAndMakeVisible (timingLabel);
+    }
+    
     // PLUGIN TITLE
     addAndMakeVisible (channelStripNameTitle = new Label (String(),TRANS("CHANNEL STRIP")));
     channelStripNameTitle->setFont (Font ("DIN Alternate", 20.80f, Font::plain));
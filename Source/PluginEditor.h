@@ -9,7 +9,6 @@
 //==============================================================================
 class ChannelStripAnalyserAudioProcessorEditor  : public AudioProcessorEditor,
                                                   public Timer,
-                                                  public HighResolutionTimer,
                                                   public Slider::Listener,
                                                   public Button::Listener,
                                                   public AsyncUpdater
@@ -19,7 +18,6 @@ public:
     ChannelStripAnalyserAudioProcessorEditor (ChannelStripAnalyserAudioProcessor& p, AudioProcessorValueTreeState& parameters, AudioBufferManagement& mainAudioBufferSystem);
     ~ChannelStripAnalyserAudioProcessorEditor();
     //==============================================================================
-    void hiResTimerCallback() override;
     void handleAsyncUpdate() override;
     void timerCallback() override;
     void paint (Graphics& g) override;
@@ -28,6 +26,8 @@ public:
     void sliderValueChanged (Slider* sliderThatWasMoved) override;
     void buttonClicked (Button* buttonThatWasClicked) override;
     void fftSizeChanged ();
+    void chainLayoutChanged();
+    void lowerViewChanged();
 
 private:
     
@@ -36,6 +36,8 @@ private:
     PluginDescription* getChosenType(const int menuID) const;
     void deletePlugin(int i);
     void createNewPlugin(const PluginDescription* desc, int i);
+    void updateSlotTimings();
+    static chainLayoutType getChainLayoutPreset (int presetId);
     
     void createBackgroundUi();
     
@@ -47,13 +49,18 @@ private:
     AudioProcessorValueTreeState& parameters;
     AudioBufferManagement& mainAudioBufferSystem;
     forwardFFT forwFFT;
+    STFTAnalyser stftAnalyser;
+    AnalysisThread analysisThread;
     
     ScopedPointer <SpectrumAnalyser>   spectrumAnalyser;
     ScopedPointer <SpectrumDifference> spectrumDifference;
     ScopedPointer <PhaseDifference>    phaseDifference;
+    ScopedPointer <CoherenceAnalyser>  coherenceAnalyser;
     ScopedPointer <StereoAnalyser>     stereoAnalyser;
     ScopedPointer <WaveformAnalyser>   waveformAnalyser;
     ScopedPointer <LevelMeter>         levelMeter;
+    ScopedPointer <AlignmentEstimator> alignmentEstimator;
+    ScopedPointer <AudioThreadStatsOverlay> audioThreadStatsOverlay;
     
     class PluginListWindow;
     ScopedPointer <PluginListWindow> pluginListWindow;
@@ -62,6 +69,9 @@ private:
     ReferenceCountedArray<SimplePluginWindow> editors;
     int chosenPlugins[6];
     bool freezeState = false;
+    slotTimingType slotTimings[6];
+    int numOfTimerCallbacks = 0;
+    TooltipWindow tooltipWindow { this };
     
 
     // GUI to save parameters
@@ -90,6 +100,8 @@ private:
     Slider sliderVectorscopeVanishTime;
     std::unique_ptr <SliderAttachment> sliderVectorscopeRangeAttach;
     std::unique_ptr <SliderAttachment> sliderVectorscopeVanishTimeAttach;
+    ToggleButton vectorscopePersistenceButton;
+    ToggleButton vectorscopeBandCorrelationButton;
     
     // SPECTRUM ANALYSER
     ScopedPointer<Label> spectrumAnalyserNameTitle;
@@ -104,6 +116,7 @@ private:
     ScopedPointer<Label> spectrumDifferenceNameTitle;
     ScopedPointer<Label> spectrumDifferenceRangeLabelText;
     ScopedPointer<Label> spectrumDifferencetimeAverageLabelText;
+    ScopedPointer<ComboBox> differenceEstimatorBox;
     Slider sliderSpectrumDifferenceRange;
     Slider sliderSpectrumDifferenceTimeAverage;
     std::unique_ptr <SliderAttachment> sliderSpectrumDifferenceRangeAttach;
@@ -123,6 +136,15 @@ private:
     // FFT
     ScopedPointer<Label> fftSizeLabelText;
     ScopedPointer<ComboBox> fftSizeButton;
+    ScopedPointer<ComboBox> fftWindowBox;
+    ScopedPointer<ComboBox> fftOverlapBox;
+    ScopedPointer<ComboBox> fftPaddingBox;
+    ToggleButton spectrumInterpolationButton;
+    ToggleButton fftMultiResolutionButton;
+    
+    // LOWER VIEW
+    ScopedPointer<Label> lowerViewLabelText;
+    ScopedPointer<ComboBox> lowerViewBox;
     
     // DELAY
     ScopedPointer<Label> totalDelayLabelText;
@@ -132,6 +154,12 @@ private:
     // FREEZE
     ScopedPointer<TextButton> freezeButton;
 
+    // CHAIN LAYOUT
+    ScopedPointer<ComboBox> chainLayoutBox;
+
+    // AUDIO THREAD STATS
+    ScopedPointer<TextButton> audioStatsButton;
+
     // PLUGIN SLOTS
     ToggleButton pluginBypassButton1;
     ToggleButton pluginBypassButton2;
@@ -158,6 +186,7 @@ private:
     ScopedPointer<TextButton> pluginLoadButton6;
     ScopedPointer<TextEditor> pluginInfoButton6;
     ScopedPointer<TextButton> pluginOpenButton6;
+    OwnedArray<Label> pluginTimingLabels;
     
     std::unique_ptr <ButtonAttachment> pluginBypassButton1Attach;
     std::unique_ptr <ButtonAttachment> pluginBypassButton2Attach;
@@ -13,7 +13,7 @@ ChannelStripAnalyserAudioProcessor::ChannelStripAnalyserAudioProcessor()
                      #endif
                        ),
         parameters (*this, nullptr),
-        mainAudioBufferSystem  (2, 1, 1)
+        mainAudioBufferSystem  (2, 1, 1, 1)
 #endif
 {
     formatManager.addDefaultFormats();
@@ -73,19 +73,23 @@ void ChannelStripAnalyserAudioProcessor::prepareToPlay (double sampleRate, int s
     graph.setProcessingPrecision (AudioProcessor::singlePrecision);
     asampleRate.store (sampleRate);
     ablockSize.store  (samplesPerBlock);
-    AudioPluginChannelConfiguration();
+    audioThreadStats.sampleRate.store ((int) sampleRate);
+    audioThreadStats.blockSize.store  (samplesPerBlock);
     
     const GenericScopedTryLock <CriticalSection> myTryLock (graph.getCallbackLock());
     if ( myTryLock.isLocked())
     {
         graph.prepareToPlay(sampleRate, samplesPerBlock);
     }
+    // the renderer takes the new settings first, the chain built from the current slots is prepared with them
+    chainRenderer.prepare (sampleRate, samplesPerBlock, jmax (getTotalNumInputChannels(), getTotalNumOutputChannels()));
+    AudioPluginChannelConfiguration();
     
     const int numOfChannelsInInputStream = getTotalNumInputChannels();
-    const int sizeOfAudioBuffer   =  getSampleRate(); //size of audioBuffer is ~1s (fftSize multiple)
+    const int sizeOfCaptureRing   =  getSampleRate(); //size of captureRing is ~1s
     const int sizeOfHistoryBuffer =  5 * getSampleRate(); //size of historyBuffer is ~5s (fftSize multiple)
 
-    mainAudioBufferSystem.reset (numOfChannelsInInputStream, sizeOfAudioBuffer, sizeOfHistoryBuffer);
+    mainAudioBufferSystem.reset (numOfChannelsInInputStream, samplesPerBlock, sizeOfCaptureRing, sizeOfHistoryBuffer);
 }
 
 void ChannelStripAnalyserAudioProcessor::releaseResources()
@@ -130,21 +134,40 @@ void ChannelStripAnalyserAudioProcessor::processBlock (AudioBuffer<float>& buffe
     
     const int numOfSamplesInIncomingBlock = buffer.getNumSamples();
     
-    mainAudioBufferSystem.bufferPre.writeBufferIntoAudioBuffer (buffer, numOfSamplesInIncomingBlock);
+    const int64 blockStartTicks = Time::getHighResolutionTicks();
+    mainAudioBufferSystem.captureRing.writePreBlock (buffer, numOfSamplesInIncomingBlock);
+    int64 captureTicks = Time::getHighResolutionTicks() - blockStartTicks;
     
-    if (graphLatencySamples != graph.getLatencySamples() )
-    {
-        graphLatencySamples = graph.getLatencySamples();
-        mainAudioBufferSystem.bufferPre.processorDelay.store (graphLatencySamples);
-    }
+    // hosted chain audio stream processing, a new topology is swapped in here without locking
+    const int64 chainStartTicks = Time::getHighResolutionTicks();
+    const int chainResult = chainRenderer.process (buffer, midiMessages);
+    if ((chainResult & ChainRenderer::swappedSequence) != 0)
+        audioThreadStats.numOfChainSwaps.store (audioThreadStats.numOfChainSwaps.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if ((chainResult & ChainRenderer::cutCrossfade) != 0)
+        audioThreadStats.numOfCutCrossfades.store (audioThreadStats.numOfCutCrossfades.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    audioThreadStats.chainTime.record (audioThreadStatsType::ticksToNs (Time::getHighResolutionTicks() - chainStartTicks));
     
-    // graph audio stream processing
-    const GenericScopedTryLock <CriticalSection> myTryLock (graph.getCallbackLock());
-    if ( myTryLock.isLocked())
+    if (chainLatencySamples != chainRenderer.getLatencySamples() )
     {
-        graph.processBlock (buffer, midiMessages);
+        chainLatencySamples = chainRenderer.getLatencySamples();
+        mainAudioBufferSystem.bufferPre.processorDelay.store (chainLatencySamples);
     }
-    mainAudioBufferSystem.bufferPost.writeBufferIntoAudioBuffer (buffer, numOfSamplesInIncomingBlock);
+    
+    const int64 postCaptureStartTicks = Time::getHighResolutionTicks();
+    mainAudioBufferSystem.captureRing.writePostBlock (buffer, numOfSamplesInIncomingBlock);
+    mainAudioBufferSystem.captureRing.publishBlock();
+    const int64 blockEndTicks = Time::getHighResolutionTicks();
+    captureTicks += blockEndTicks - postCaptureStartTicks;
+    
+    // instrumentation counters, the audio thread is their only writer
+    const int captureCapacity = mainAudioBufferSystem.captureRing.slotSize * mainAudioBufferSystem.captureRing.numOfSlots;
+    if (numOfSamplesInIncomingBlock > captureCapacity)
+        audioThreadStats.numOfDroppedSamples.store (audioThreadStats.numOfDroppedSamples.load (std::memory_order_relaxed)
+                                                    + numOfSamplesInIncomingBlock - captureCapacity, std::memory_order_relaxed);
+    
+    audioThreadStats.captureTime.record (audioThreadStatsType::ticksToNs (captureTicks));
+    audioThreadStats.blockTime.record (audioThreadStatsType::ticksToNs (blockEndTicks - blockStartTicks));
+    audioThreadStats.numOfBlocks.store (audioThreadStats.numOfBlocks.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
 }
 
 //==============================================================================
@@ -224,240 +247,99 @@ void ChannelStripAnalyserAudioProcessor::changeProgramName (int index, const Str
 //==============================================================================
 void ChannelStripAnalyserAudioProcessor::getStateInformation (MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
-    
     // creating main XML element
     std::unique_ptr<XmlElement> rootXml ( new XmlElement("root_xml"));
     
-    for (auto i=0; i<6; i++) {
-        rootXml->setAttribute("plugin" + (String)(i+1) + "_state", plugIns[i]);
-        rootXml->setAttribute("plugin" + (String)(i+1) + "_bypass", bypassFlag[i]);
-        rootXml->setAttribute("plugin" + (String)(i+1) + "_isVisible", shownPlugins[i]);
-    }
-    
-    // Creating internal state XML representation and adding it to the main XML element
-    ScopedPointer<XmlElement> internalParameters (parameters.copyState().createXml());
-    rootXml->addChildElement(internalParameters);
-    
-    // for each loaded plugin; exporting the plugin description and the actual state of the processor and saving them in different XML elements
-    ScopedPointer <XmlElement> loadedPluginsDescriptions (new XmlElement("LoadedPluginsDescriptions"));
-    ScopedPointer <XmlElement> loadedPluginsProcessorState (new XmlElement("LoadedPluginsProcessorState"));
+    // the hosted chain: for each loaded plugin its description and the actual state of the processor
+    savedChainType savedChain;
+    savedChain.layout = chainLayout;
     
     for (auto i=0; i<6; i++)
     {
+        savedChainType::slotType& slot = savedChain.slots[i];
+        slot.isLoaded   = plugIns[i];
+        slot.isBypassed = bypassFlag[i];
+        slot.isVisible  = shownPlugins[i];
+        
         if (plugIns[i])
         {
-            PluginDescription pd;
-            auto* plugin = dynamic_cast<AudioPluginInstance*> (graph.getNodeForId(juce::uint32(i+3))->getProcessor());
-            plugin->fillInPluginDescription(pd);
-            loadedPluginsDescriptions ->addChildElement(pd.createXml());
-            
-            MemoryBlock m;
-            graph.getNodeForId(juce::uint32(i+3))->getProcessor()->getStateInformation (m);
-            loadedPluginsProcessorState ->addChildElement(new XmlElement("Plugin" + (String)(i)));
-            loadedPluginsProcessorState ->getChildByName("Plugin" + (String)(i)) ->addTextElement(m.toBase64Encoding());
+            AudioProcessor* slotProcessor = graph.getNodeForId (juce::uint32(i+3))->getProcessor();
+            auto* plugin = dynamic_cast<AudioPluginInstance*> (SlotTimingProcessor::getHostedProcessor (slotProcessor));
+            plugin->fillInPluginDescription (slot.description);
+            slotProcessor->getStateInformation (slot.state);
         }
     }
     
-    // adding the created XML elements to the main XML element
-    rootXml->addChildElement(loadedPluginsDescriptions);
-    rootXml->addChildElement(loadedPluginsProcessorState);
+    // Creating internal state XML representation and adding it to the main XML element
+    rootXml->addChildElement (parameters.copyState().createXml());
+    savedChain.writeToXml (*rootXml);
     
     // exporting the main XML to the data block
     copyXmlToBinary(*rootXml,destData);
-    
-    // de-attaching the different XML elements
-    for (auto i=0; i<6; i++)
-    {
-        if (plugIns[i]) loadedPluginsProcessorState->removeChildElement(loadedPluginsProcessorState->getChildByName((String)(i)), true);
-    }
-    rootXml->removeChildElement(loadedPluginsProcessorState, false);
-    rootXml->removeChildElement(loadedPluginsDescriptions, false);
-    rootXml->removeChildElement(internalParameters, false);
 }
 
 void ChannelStripAnalyserAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
-    
     // importing the data into a XML element
     ScopedPointer<XmlElement> rootXml (getXmlFromBinary(data, sizeInBytes));
+    if (rootXml == nullptr)
+        return;
     
-    for (auto i=0; i<6; i++)
-    {
-        plugIns[i]         = rootXml->getBoolAttribute("plugin" + (String)(i+1) + "_state");
-        bypassFlag[i]      = rootXml->getBoolAttribute("plugin" + (String)(i+1) + "_bypass");
-        recalledPlugins[i] = rootXml->getBoolAttribute("plugin" + (String)(i+1) + "_isVisible");
-    }
-    
-    // exporting internal parameters from main XML element
-    ScopedPointer<XmlElement> internalParameters  (new XmlElement (*rootXml->getChildByName("plugin_parameters")));
-    
-    // exporting plugin descriptions from the main XML element
-    ScopedPointer<XmlElement> pluginsDescriptions (new XmlElement (*rootXml->getChildByName("LoadedPluginsDescriptions")));
-    ScopedPointer<XmlElement> pluginsStates (new XmlElement (*rootXml->getChildByName("LoadedPluginsProcessorState")));
+    savedChainType savedChain;
+    savedChain.readFromXml (*rootXml);
+    chainLayout = savedChain.layout;
     
     for (auto i=0; i<6; i++)
     {
-        if (plugIns[i])
+        const savedChainType::slotType& slot = savedChain.slots[i];
+        plugIns[i]         = slot.isLoaded;
+        bypassFlag[i]      = slot.isBypassed;
+        recalledPlugins[i] = slot.isVisible;
+        
+        if (slot.isLoaded)
         {
-            {
-                PluginDescription pd;
-                ScopedPointer <XmlElement> pdXml (pluginsDescriptions->getFirstChildElement());
-                pd.loadFromXml (*pdXml);
-                createPluginProcessor(&pd, i+1);
-                pluginsDescriptions->removeChildElement(pdXml, false);
-            }
-            {
-                MemoryBlock m;
-                ScopedPointer<XmlElement> psXml (pluginsStates->getFirstChildElement());
-                m.fromBase64Encoding (psXml->getAllSubText());
-                graph.getNodeForId (juce::uint32(i+3)) -> getProcessor() -> setStateInformation (m.getData(), (int) m.getSize());
-                pluginsStates -> removeChildElement (psXml, false);
-            }
+            createPluginProcessor (&slot.description, i+1);
+            if (AudioProcessorGraph::Node* node = graph.getNodeForId (juce::uint32(i+3)))
+                node->getProcessor()->setStateInformation (slot.state.getData(), (int) slot.state.getSize());
         }
     }
     
     // exporting internal parameters from main XML element
-    if (internalParameters!= nullptr)
+    if (XmlElement* internalParameters = rootXml->getChildByName ("plugin_parameters"))
     {
         if (internalParameters-> hasTagName(parameters.state.getType()))
         {
             parameters.replaceState(ValueTree::fromXml(*internalParameters));
         }
     }
-    
-    // removing elements from the main XML element
-    rootXml->removeChildElement (pluginsDescriptions, false);
-    rootXml->removeChildElement (internalParameters,  false);
-    rootXml->removeAllAttributes();
-    
 }
 
 //==============================================================================
 void ChannelStripAnalyserAudioProcessor::AudioPluginChannelConfiguration()
 {
-    // creates the layout of the graph, connecting the active nodes beetwen them and the input/output nodes
+    // creates the layout of the chain, the active nodes (created and not bypassed) in slot order.
+    // The graph only owns the nodes; the renderer prepares the new chain here and the audio
+    // thread swaps it in at its next block, crossfading the slots that come or go.
     
-    bool firstTime = true;
-    int lastOn=0;
-    
-    graph.disconnectNode(1); // input node
-    graph.disconnectNode(2); // output node
+    ChainRenderer::slotNodesType slotNodes;
     
     for (int i = 3; i < 9; i++)
     {
-        graph.disconnectNode(juce::uint32(i));
-        
-        if ((bypassFlag[i-3] == false) && (plugIns[i-3] == true)) // is not bypassed and has been created
-        {
-            
-            if (firstTime == true)
-            {
-                AudioProcessorGraph::NodeAndChannel nodeFromL;
-                nodeFromL.channelIndex = 0;
-                nodeFromL.nodeID = 1;
-                AudioProcessorGraph::NodeAndChannel nodeFromR;
-                nodeFromR.channelIndex = 1;
-                nodeFromR.nodeID = 1;
-                
-                AudioProcessorGraph::NodeAndChannel nodeToL;
-                nodeToL.channelIndex = 0;
-                nodeToL.nodeID = juce::uint32(i);
-                AudioProcessorGraph::NodeAndChannel nodeToR;
-                nodeToR.channelIndex = 1;
-                nodeToR.nodeID = juce::uint32(i);
-                
-                AudioProcessorGraph::Connection connectionL(nodeFromL,nodeToL);
-                AudioProcessorGraph::Connection connectionR(nodeFromR,nodeToR);
-                
-                graph.addConnection(connectionL);
-                graph.addConnection(connectionR);
-                
-                lastOn = i;
-                firstTime = false;
-            }
-            else
-            {
-                AudioProcessorGraph::NodeAndChannel nodeFromL;
-                nodeFromL.channelIndex = 0;
-                nodeFromL.nodeID = juce::uint32(lastOn);;
-                AudioProcessorGraph::NodeAndChannel nodeFromR;
-                nodeFromR.channelIndex = 1;
-                nodeFromR.nodeID = juce::uint32(lastOn);;
-                
-                AudioProcessorGraph::NodeAndChannel nodeToL;
-                nodeToL.channelIndex = 0;
-                nodeToL.nodeID = juce::uint32(i);
-                AudioProcessorGraph::NodeAndChannel nodeToR;
-                nodeToR.channelIndex = 1;
-                nodeToR.nodeID = juce::uint32(i);
-                
-                AudioProcessorGraph::Connection connectionL(nodeFromL,nodeToL);
-                AudioProcessorGraph::Connection connectionR(nodeFromR,nodeToR);
-                
-                graph.addConnection(connectionL);
-                graph.addConnection(connectionR);
-                
-                lastOn = i;
-            }
-        }
+        const bool isActive = (bypassFlag[i-3] == false) && (plugIns[i-3] == true);
+        slotNodes.add (isActive ? graph.getNodeForId (juce::uint32(i)) : nullptr);
     }
     
-    if (lastOn == 0)
-    {
-        AudioProcessorGraph::NodeAndChannel nodeFromL;
-        nodeFromL.channelIndex = 0;
-        nodeFromL.nodeID = 1;
-        AudioProcessorGraph::NodeAndChannel nodeFromR;
-        nodeFromR.channelIndex = 1;
-        nodeFromR.nodeID = 1;
-        
-        AudioProcessorGraph::NodeAndChannel nodeToL;
-        nodeToL.channelIndex = 0;
-        nodeToL.nodeID = 2;
-        AudioProcessorGraph::NodeAndChannel nodeToR;
-        nodeToR.channelIndex = 1;
-        nodeToR.nodeID = 2;
-        
-        AudioProcessorGraph::Connection connectionL(nodeFromL,nodeToL);
-        AudioProcessorGraph::Connection connectionR(nodeFromR,nodeToR);
-        
-        graph.addConnection(connectionL);
-        graph.addConnection(connectionR);
-    }
-    else
-    {
-        AudioProcessorGraph::NodeAndChannel nodeFromL;
-        nodeFromL.channelIndex = 0;
-        nodeFromL.nodeID = juce::uint32(lastOn);
-        AudioProcessorGraph::NodeAndChannel nodeFromR;
-        nodeFromR.channelIndex = 1;
-        nodeFromR.nodeID = juce::uint32(lastOn);
-        
-        AudioProcessorGraph::NodeAndChannel nodeToL;
-        nodeToL.channelIndex = 0;
-        nodeToL.nodeID = 2;
-        AudioProcessorGraph::NodeAndChannel nodeToR;
-        nodeToR.channelIndex = 1;
-        nodeToR.nodeID = 2;
-        
-        AudioProcessorGraph::Connection connectionL(nodeFromL,nodeToL);
-        AudioProcessorGraph::Connection connectionR(nodeFromR,nodeToR);
-        
-        graph.addConnection(connectionL);
-        graph.addConnection(connectionR);
-    }
+    chainRenderer.setChain (slotNodes, chainLayout);
 }
 
 void ChannelStripAnalyserAudioProcessor::createPluginProcessor(const PluginDescription* desc, int i)
 {
     plugIns[i-1] = true;
     String errorMessage;
-    graph.addNode (formatManager.createPluginInstance (*desc, getSampleRate(), getBlockSize(), errorMessage),juce::uint32(i+2));
+    audioThreadStats.slotTime[i-1].requestReset();    // the slot's timings start over with the new plugin
+    // every slot is timed by a thin wrapper around the hosted plugin
+    if (AudioPluginInstance* plugin = formatManager.createPluginInstance (*desc, getSampleRate(), getBlockSize(), errorMessage))
+        graph.addNode (new SlotTimingProcessor (plugin, audioThreadStats.slotTime[i-1]), juce::uint32(i+2));
     AudioPluginChannelConfiguration();
 }
 
@@ -514,6 +396,7 @@ void ChannelStripAnalyserAudioProcessor::createParameters()
 void ChannelStripAnalyserAudioProcessor::triggerGraphPrepareToPlay()
 {
     graph.prepareToPlay(getSampleRate(), getBlockSize());
+    AudioPluginChannelConfiguration(); // a new chain picks up the plugins' current latencies
 }
 //==============================================================================
 // This creates new instances of the plugin..
@@ -521,265 +404,3 @@ AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 {
     return new ChannelStripAnalyserAudioProcessor();
 }
-
-//==============================================================================
-AudioBufferManagement::AudioBufferManagement (int channels, int sizeAudioBuffer, int sizeHistoryBuffer)
-:
-bufferPre  (channels, sizeAudioBuffer, sizeHistoryBuffer, "bufferPre", threadMutex),
-bufferPost (channels, sizeAudioBuffer, sizeHistoryBuffer, "bufferPost", threadMutex)
-{
-    visualizersSemaphore.store(0);
-}
-
-void AudioBufferManagement::pushAudioBufferIntoHistoryBuffer()
-{
-    if (bufferPre.abstractFifoAudio.getNumReady() != bufferPost.abstractFifoAudio.getNumReady())
-        return;
-    
-    for (int bufferPrePost = 0; bufferPrePost < 2; bufferPrePost++)
-    {
-        audioBufferManagementType& buffer ( bufferPrePost ? bufferPost : bufferPre);
-        
-        const int historyFifoFreespace = buffer.abstractFifoHistory.getFreeSpace();
-        const int numOfNewSamplesInAudioBuffer = buffer.abstractFifoAudio.getNumReady();
-        const int numOfSamplesInHistoryBuffer = buffer.abstractFifoHistory.getTotalSize();
-        const int numOfChannels = buffer.historyBuffer.getNumChannels();
-        
-        if ( historyFifoFreespace < numOfNewSamplesInAudioBuffer)
-        {
-            buffer.abstractFifoHistory.finishedRead (numOfNewSamplesInAudioBuffer - historyFifoFreespace);
-        }
-        
-        int writeIndex1, writeSize1, writeIndex2, writeSize2;
-        int readIndex1, readSize1, readIndex2, readSize2;
-        buffer.abstractFifoHistory .prepareToWrite (numOfNewSamplesInAudioBuffer, writeIndex1, writeSize1, writeIndex2, writeSize2);
-        buffer.abstractFifoAudio   .prepareToRead  (numOfNewSamplesInAudioBuffer, readIndex1, readSize1, readIndex2, readSize2);
-        
-        if (writeSize2 == 0)
-        {
-            for (int ch = 0; ch < numOfChannels ; ++ch)
-            {
-                buffer.historyBuffer.copyFrom (ch, writeIndex1, buffer.audioBuffer, ch, readIndex1, readSize1);
-                if (readSize2 > 0)
-                    buffer.historyBuffer.copyFrom (ch, writeIndex1 + readSize1, buffer.audioBuffer, ch, readIndex2, readSize2);
-            }
-        }
-        else
-        {
-            if (readSize1 > writeSize1)
-            {
-                for (int ch = 0; ch < numOfChannels ; ++ch)
-                {
-                    buffer.historyBuffer.copyFrom (ch, writeIndex1, buffer.audioBuffer, ch, readIndex1, writeSize1);
-                    buffer.historyBuffer.copyFrom (ch, 0, buffer.audioBuffer, ch, readIndex1 + writeSize1, readSize1 - writeSize1);
-                    if (readSize2 > 0)
-                        buffer.historyBuffer.copyFrom (ch, readSize1 - writeSize1, buffer.audioBuffer, ch, readIndex2, readSize2);
-                }
-            }
-            else
-            {
-                if (readSize1 + readSize2 > writeSize1)
-                {
-                    const int numOfSamplesToTheEnd = ( readSize1 + readSize2 ) - writeSize1;
-                    for (int ch = 0; ch < numOfChannels ; ++ch)
-                    {
-                        buffer.historyBuffer.copyFrom (ch, writeIndex1, buffer.audioBuffer, ch, readIndex1, readSize1);
-                        buffer.historyBuffer.copyFrom (ch, writeIndex1 + readSize1, buffer.audioBuffer, ch, readIndex2, readSize2 - numOfSamplesToTheEnd);
-                        buffer.historyBuffer.copyFrom (ch, 0, buffer.audioBuffer, ch, readIndex2 + readSize2 - numOfSamplesToTheEnd, numOfSamplesToTheEnd);
-                    }
-                    
-                }
-                
-            }
-            
-        }
-        int lastSampleIndex;
-        int absoluteIndex = writeIndex1 + writeSize1 + writeSize2;
-        if (absoluteIndex > numOfSamplesInHistoryBuffer )
-            lastSampleIndex = absoluteIndex % (numOfSamplesInHistoryBuffer);
-        else
-            lastSampleIndex = absoluteIndex;
-        
-        buffer.lastSampleIndexHistoryBuffer.store  (lastSampleIndex);
-        buffer.abstractFifoHistory  .finishedWrite (readSize1 + readSize2);
-        buffer.abstractFifoAudio    .finishedRead  (readSize1 + readSize2);
-
-    }
-}
-
-void AudioBufferManagement::reset(int newChannel, int newSizeAudioBuffer, int newSizeHistoryBuffer)
-{
-    bufferPre.reset(newChannel, newSizeAudioBuffer, newSizeHistoryBuffer);
-    bufferPost.reset(newChannel, newSizeAudioBuffer, newSizeHistoryBuffer);
-}
-
-void AudioBufferManagement::audioBufferManagementType::reset(int ch, int sAb, int sHb)
-{
-    historyBuffer.clear();
-    abstractFifoHistory.reset();
-    audioBuffer.clear();
-    abstractFifoAudio.reset();
-    
-    historyBuffer.setSize(ch, sHb);
-    abstractFifoHistory.setTotalSize(sHb > 0 ? sHb : 1);
-    audioBuffer.setSize(ch, sAb);
-    abstractFifoAudio.setTotalSize(sAb > 0 ? sAb : 1);
-    
-    lastSampleIndexAudioBuffer.store(0);
-    lastSampleIndexHistoryBuffer.store(0);
-}
-
-void AudioBufferManagement::audioBufferManagementType::writeBufferIntoAudioBuffer(AudioBuffer<float> &fromBuffer, int numOfSamples)
-{
-    int index1, size1, index2, size2;
-    
-    const int fifoFreeSpace = abstractFifoAudio.getFreeSpace();
-    const int numOfSamplesInInputBlock = fromBuffer.getNumSamples();
-    
-    // if there is no space for the incoming audioBlock, make room for it.
-    if (fifoFreeSpace < numOfSamplesInInputBlock )
-    {
-        abstractFifoAudio.finishedRead ( numOfSamplesInInputBlock - fifoFreeSpace ); //sets the oldest data to readed
-    }
-    
-    // copying the data to the audioBuffer
-    abstractFifoAudio.prepareToWrite (numOfSamples, index1, size1, index2, size2);
-    if (size1 > 0)
-    {
-        for (int ch = 0; ch < audioBuffer.getNumChannels(); ++ch)
-            audioBuffer.copyFrom(ch, index1, fromBuffer, ch, 0, size1);
-    }
-    if (size2 > 0)
-    {
-        for (int ch = 0; ch < audioBuffer.getNumChannels(); ++ch)
-            audioBuffer.copyFrom(ch, index2, fromBuffer, ch, size1, size2);
-    }
-    
-    int lastSampleIndex = size2 == 0 ? index1 + size1 : index2 + size2;
-    
-    lastSampleIndexAudioBuffer.store  (lastSampleIndex);
-    abstractFifoAudio.finishedWrite ( size1 + size2 );
-    
-}
-
-void AudioBufferManagement::audioBufferManagementType::copySamplesFromHistoryBuffer(AudioBuffer<float> &toBuffer, int numOfSamples)
-{
-    const int procDelay = processorDelay.load();
-    const int numOfSamplesInBuffer = historyBuffer.getNumSamples();
-    const int lastSampleIndex = lastSampleIndexHistoryBuffer.load() - procDelay;
-    
-    int firstSampleIndex = lastSampleIndex - numOfSamples;
-    if (firstSampleIndex < 0) firstSampleIndex = numOfSamplesInBuffer + firstSampleIndex;
-    if ( firstSampleIndex + numOfSamples > numOfSamplesInBuffer)
-    {
-        int size1 = numOfSamplesInBuffer - firstSampleIndex;
-        int size2 = numOfSamples - size1;
-        for (auto channel = 0; channel < historyBuffer.getNumChannels(); channel++)
-        {
-            toBuffer.copyFrom(channel, 0, historyBuffer, channel, firstSampleIndex, size1);
-            toBuffer.copyFrom(channel, size1, historyBuffer, channel, 0, size2);
-        }
-    }
-    else
-    {
-        for (auto channel = 0; channel < historyBuffer.getNumChannels(); channel++)
-            toBuffer.copyFrom(channel, 0, historyBuffer, channel, firstSampleIndex, numOfSamples);
-    }
-}
-
-float AudioBufferManagement::audioBufferManagementType::getRMSMonoValueInSample(int samplesInThePast, int windowSize)
-{
-    const int procDelay = processorDelay.load();
-    const int numOfSamplesInBuffer = historyBuffer.getNumSamples();
-    const int lastSampleIndex = lastSampleIndexHistoryBuffer.load() - procDelay - samplesInThePast;
-    
-    AudioBuffer<float> monoBuffer ( 1, windowSize );
-    int firstSampleIndex = lastSampleIndex - windowSize;
-    if (firstSampleIndex < 0) firstSampleIndex = numOfSamplesInBuffer + firstSampleIndex;
-    if ( firstSampleIndex + windowSize > numOfSamplesInBuffer)
-    {
-        int size1 = numOfSamplesInBuffer - firstSampleIndex;
-        int size2 = windowSize - size1;
-        
-        FloatVectorOperations::add
-            (monoBuffer.getWritePointer(0, 0), historyBuffer.getReadPointer(0, firstSampleIndex), historyBuffer.getReadPointer(1, firstSampleIndex), size1);
-        FloatVectorOperations::add
-            (monoBuffer.getWritePointer(0, size1), historyBuffer.getReadPointer(0, 0), historyBuffer.getReadPointer(1, 0), size2);
-    }
-    else
-    {
-        FloatVectorOperations::add
-            (monoBuffer.getWritePointer(0, 0), historyBuffer.getReadPointer(0, firstSampleIndex), historyBuffer.getReadPointer(1, firstSampleIndex), windowSize);
-    }
-    return monoBuffer.getRMSLevel(0, 0, windowSize);
-}
-
-float AudioBufferManagement::audioBufferManagementType::getRMSChannelValueInSample(int samplesInThePast, int windowSize, int channel)
-{
-    const int procDelay = processorDelay.load();
-    const int numOfSamplesInBuffer = historyBuffer.getNumSamples();
-    const int lastSampleIndex = lastSampleIndexHistoryBuffer.load() - procDelay - samplesInThePast;
-    
-    AudioBuffer<float> monoBuffer ( 1, windowSize );
-    int firstSampleIndex = lastSampleIndex - windowSize;
-    if (firstSampleIndex < 0) firstSampleIndex = numOfSamplesInBuffer + firstSampleIndex;
-    if ( firstSampleIndex + windowSize > numOfSamplesInBuffer)
-    {
-        int size1 = numOfSamplesInBuffer - firstSampleIndex;
-        int size2 = windowSize - size1;
-        FloatVectorOperations::copy(monoBuffer.getWritePointer(0, 0), historyBuffer.getReadPointer(channel, firstSampleIndex), size1);
-        FloatVectorOperations::copy(monoBuffer.getWritePointer(0, size1), historyBuffer.getReadPointer(channel, 0), size2);
-    }
-    else
-    {
-        FloatVectorOperations::copy(monoBuffer.getWritePointer(0, 0), historyBuffer.getReadPointer(channel, firstSampleIndex), windowSize);
-    }
-    return monoBuffer.getRMSLevel(0, 0, windowSize);
-}
-
-int AudioBufferManagement::audioBufferManagementType::getLastIndexPositionInHistoryBuffer()
-{
-    return lastSampleIndexHistoryBuffer.load();
-}
-
-
-//==============================================================================
-void forwardFFT::createWindowTable()
-{
-    for (auto i = 0; i < fftSize; i++)
-    {
-        for (int ch = 0; ch < 2; ++ch)
-        {
-            float value = 1 * (0.5f * (1 - std::cos ( (2 * juce::float_Pi * i) / (fftSize - 1) ) ) );
-            windowTable.setSample(ch, i, value);
-        }
-    }
-}
-
-void forwardFFT::performFFT( AudioBuffer<float>& audioBuffer )
-{
-    std::lock_guard<std::mutex> lock (m);
-    const int numOfChannels = audioBuffer.getNumChannels();
-    for (auto channel = 0; channel < numOfChannels; channel++)
-    {
-        FloatVectorOperations::multiply (audioBuffer.getWritePointer(channel), windowTable.getReadPointer(channel), fftSize);
-        forwFFT->performRealOnlyForwardTransform (audioBuffer.getWritePointer(channel));
-    }
-}
-
-void forwardFFT::changeFFTSize(int newSize)
-{
-    std::lock_guard<std::mutex> lock (m);
-    fftSize = newSize;
-    createWindowTable();
-    forwFFT.reset (new dsp::FFT (roundToInt (std::log2 (fftSize))));
-}
-
-
-
-
-
-
-
-
-
@@ -11,6 +11,9 @@
 #pragma once
 
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "AudioBufferManagement.h"
+#include "AudioThreadStats.h"
+#include "ChainRenderer.h"
 #include <deque>
 #include <numeric>
 
@@ -55,103 +58,6 @@
 
 #define SLIDER5_ID "sliderTEST"
 #define SLIDER5_NAME "SliderTEST"
-//==============================================================================
-class AudioBufferManagement
-{
-private:
-    std::mutex threadMutex;
-public:
-    struct audioBufferManagementType
-    {
-        AudioBuffer<float> historyBuffer;
-        AbstractFifo abstractFifoHistory;
-        AudioBuffer<float> audioBuffer;
-        AbstractFifo abstractFifoAudio;
-        
-        std::atomic<int> lastSampleIndexAudioBuffer;
-        std::atomic<int> lastSampleIndexHistoryBuffer;
-        std::atomic<int> processorDelay;
-        
-        String name;
-        std::mutex& threadMutex;
-        
-        audioBufferManagementType (int ch, int sAb, int sHb, String n, std::mutex& tM)
-        : historyBuffer (ch, sHb), abstractFifoHistory (sHb),
-        audioBuffer (ch, sAb), abstractFifoAudio (sAb),
-        lastSampleIndexAudioBuffer(0),
-        lastSampleIndexHistoryBuffer(0),
-        processorDelay(0),
-        name(n),
-        threadMutex(tM)
-        {}
-        void reset (int ch, int sAb, int sHb);
-        void writeBufferIntoAudioBuffer   ( AudioBuffer<float> &fromBuffer, int numOfSamples );
-        void copySamplesFromHistoryBuffer ( AudioBuffer<float> &toBuffer, int numOfSamples );
-        float getRMSMonoValueInSample (int samplesInThePast, int windowSize);
-        float getRMSChannelValueInSample (int samplesInThePast, int windowSize, int channel);
-        int getLastIndexPositionInHistoryBuffer();
-    };
-    
-    std::atomic<int> visualizersSemaphore;
-    audioBufferManagementType bufferPre;
-    audioBufferManagementType bufferPost;
-
-    AudioBufferManagement (int channels, int sizeAudioBuffer, int sizeHistoryBuffer );
-    ~AudioBufferManagement(){};
-    void pushAudioBufferIntoHistoryBuffer();
-    void reset(int newChannel, int newSizeAudioBuffer, int newSizeHistoryBuffer);
-};
-
-//==============================================================================
-class ReleasePool : private Timer
-{
-public:
-    
-    ReleasePool() { startTimer(1000); }
-    
-    template<typename T> void add (const std::shared_ptr<T>& object)
-    {
-        //if (object.empty())
-        //    return;
-        std::lock_guard<std::mutex> lock (m);
-        pool.emplace_back(object);
-    }
-private:
-    void timerCallback() override
-    {
-        std::lock_guard<std::mutex> lock (m);
-        pool.erase(
-                   std::remove_if (
-                                   pool.begin(), pool.end(),
-                                   [] (auto& object) {return object.use_count() <= 1; }),
-                   pool.end());
-    }
-    std::vector<std::shared_ptr<void>> pool;
-    std::mutex m;
-};
-
-//==============================================================================
-struct forwardFFT
-{
-    std::unique_ptr <dsp::FFT> forwFFT;
-    AudioBuffer<float> windowTable;
-    int fftSize;
-    std::mutex m;
-
-    forwardFFT (int fS, int nC)
-    :
-    windowTable ( nC, fS * 2),
-    fftSize(fS)
-    {
-        forwFFT = std::make_unique<dsp::FFT>(std::log2(fS));
-        createWindowTable();
-    }
-    void createWindowTable();
-    void performFFT( AudioBuffer<float>& audioBuffer);
-    void changeFFTSize( int newSize);
-};
-
-
 //==============================================================================
 class ChannelStripAnalyserAudioProcessor  : public AudioProcessor
 {
@@ -198,6 +104,12 @@ public:
     void createParameters();
     void triggerGraphPrepareToPlay(); 
     
+    // latency of the chain the audio thread is running
+    int getChainLatencySamples() const { return chainRenderer.getLatencySamples(); }
+    
+    // pre/post capture of the hosted chain, for the editor and the offline tools
+    AudioBufferManagement& getAudioBufferSystem() { return mainAudioBufferSystem; }
+    
     // Objects for owned windows ===================================================
     AudioPluginFormatManager formatManager;
     KnownPluginList knownPluginList;
@@ -210,17 +122,24 @@ public:
     bool createPluginCue[6];
     bool shownPlugins[6];
     bool recalledPlugins[6];
+    chainLayoutType chainLayout;    // series, or two parallel / mid-side branches of slots
     
     AudioProcessorGraph graph;
     AudioPlayHead::CurrentPositionInfo currentPosition;
     
     std::atomic<int> asampleRate;
     std::atomic<int> ablockSize;
+    
+    // Objects for audio thread instrumentation ====================================
+    audioThreadStatsType audioThreadStats;
 
 private:
     
     int mainAudioBufferSize = 2048 * 8;
-    int graphLatencySamples = 0;
+    int chainLatencySamples = 0;
+    
+    // declared after the graph, so the chain lets go of its nodes first
+    ChainRenderer chainRenderer;
     
     AudioProcessorValueTreeState parameters;
     
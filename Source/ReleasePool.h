@@ -0,0 +1,31 @@
+#pragma once
+#include "JuceHeader.h"
+
+//==============================================================================
+/** Owns objects that were handed to the audio thread, so they are never deleted there.
+    A timer on the message thread deletes every object that nobody else holds any more.
+*/
+class ReleasePool : private Timer
+{
+public:
+    
+    ReleasePool() { startTimer(1000); }
+    
+    template<typename T> void add (const std::shared_ptr<T>& object)
+    {
+        std::lock_guard<std::mutex> lock (m);
+        pool.emplace_back(object);
+    }
+private:
+    void timerCallback() override
+    {
+        std::lock_guard<std::mutex> lock (m);
+        pool.erase(
+                   std::remove_if (
+                                   pool.begin(), pool.end(),
+                                   [] (auto& object) {return object.use_count() <= 1; }),
+                   pool.end());
+    }
+    std::vector<std::shared_ptr<void>> pool;
+    std::mutex m;
+};
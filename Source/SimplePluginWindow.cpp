@@ -1,4 +1,5 @@
 #include "SimplePluginWindow.h"
+#include "AudioThreadStats.h"
 
 SimplePluginWindow::SimplePluginWindow (Component* const uiComp, SimplePluginWindow* owner_, const bool isGeneric_, AudioProcessorGraph::Node* node)
     : DocumentWindow (uiComp->getName(), Colours::lightblue,DocumentWindow::minimiseButton | DocumentWindow::closeButton),
@@ -50,18 +51,18 @@ SimplePluginWindow* SimplePluginWindow::getWindowFor (AudioProcessorGraph::Node*
     
     if (! useGenericView)
     {
-        ui = node->getProcessor()->createEditorIfNeeded();
+        ui = SlotTimingProcessor::getHostedProcessor (node->getProcessor())->createEditorIfNeeded();
         
         if (ui == nullptr)
             useGenericView = true;
     }
     
     if (useGenericView)
-        ui = new GenericAudioProcessorEditor (node->getProcessor());
+        ui = new GenericAudioProcessorEditor (SlotTimingProcessor::getHostedProcessor (node->getProcessor()));
     
     if (ui != nullptr)
     {
-        AudioPluginInstance* const plugin = dynamic_cast <AudioPluginInstance*> (node->getProcessor());
+        AudioPluginInstance* const plugin = dynamic_cast <AudioPluginInstance*> (SlotTimingProcessor::getHostedProcessor (node->getProcessor()));
         
         if (plugin != nullptr)
             ui->setName (plugin->getName());
@@ -0,0 +1,162 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/** Header only and without JUCE, so Tools/SpectrumKernelTest builds it on its own.
+    Inside a JUCE project the SIMD paths follow JUCE_USE_SIMD. */
+#ifndef SPECTRUM_KERNEL_USE_SIMD
+ #ifdef JUCE_USE_SIMD
+  #define SPECTRUM_KERNEL_USE_SIMD JUCE_USE_SIMD
+ #else
+  #define SPECTRUM_KERNEL_USE_SIMD 1
+ #endif
+#endif
+
+#if SPECTRUM_KERNEL_USE_SIMD && defined (__SSE2__)
+ #include <emmintrin.h>
+#elif SPECTRUM_KERNEL_USE_SIMD && (defined (__ARM_NEON__) || defined (__ARM_NEON))
+ #include <arm_neon.h>
+#endif
+
+//==============================================================================
+/** Magnitude kernel for the interleaved (re, im) output of performRealOnlyForwardTransform.
+    One pass does the complex magnitude, the peak hold with decay and the conversion
+    to dB (20 * log10 (mag) + dbOffset, floored at minimumDb) into preallocated arrays.
+*/
+struct spectrumKernel
+{
+    static constexpr float minimumDb = -200.0f;
+
+    // 20 * log10 (x) == dbPerLog2 * log2 (x)
+    static constexpr float dbPerLog2 = 6.0205999f;
+
+    // least-squares fit of log2 (m) over the mantissa range [1, 2), max error ~2e-4 (~0.001 dB)
+    static constexpr float log2Coeff0 = -2.4967738f;
+    static constexpr float log2Coeff1 = 4.0283728f;
+    static constexpr float log2Coeff2 = -2.0810602f;
+    static constexpr float log2Coeff3 = 0.62881573f;
+    static constexpr float log2Coeff4 = -0.079150366f;
+
+    static float fastLog2 (float x)
+    {
+        int32_t bits;
+        std::memcpy (&bits, &x, sizeof (bits));
+
+        const float exponent = (float) (((bits >> 23) & 0xff) - 127);
+        bits = (bits & 0x007fffff) | 0x3f800000;
+
+        float m;
+        std::memcpy (&m, &bits, sizeof (m));
+
+        return exponent + log2Coeff0 + m * (log2Coeff1 + m * (log2Coeff2 + m * (log2Coeff3 + m * log2Coeff4)));
+    }
+
+    static void magnitudeToDbScalar (const float* bins, int numOfBins, float* maxValues, float decayRatio, float dbOffset, float* magnitudeDb)
+    {
+        for (int i = 0; i < numOfBins; ++i)
+        {
+            const float re = bins[2 * i];
+            const float im = bins[2 * i + 1];
+            float magLin = std::sqrt (re * re + im * im);
+
+            if (maxValues[i] > magLin)
+            {
+                magLin = maxValues[i];
+                maxValues[i] = maxValues[i] * decayRatio;
+            }
+            else
+            {
+                maxValues[i] = magLin;
+            }
+
+            // the constants are only read by value, so no out-of-class definition is needed
+            const float db = dbPerLog2 * fastLog2 (magLin) + dbOffset;
+            magnitudeDb[i] = db > minimumDb ? db : minimumDb;
+        }
+    }
+
+    static void magnitudeToDb (const float* bins, int numOfBins, float* maxValues, float decayRatio, float dbOffset, float* magnitudeDb)
+    {
+        int i = 0;
+
+       #if SPECTRUM_KERNEL_USE_SIMD && defined (__SSE2__)
+        const __m128 decay   = _mm_set1_ps (decayRatio);
+        const __m128 dbScale = _mm_set1_ps (dbPerLog2);
+        const __m128 offset  = _mm_set1_ps (dbOffset);
+        const __m128 floorDb = _mm_set1_ps (minimumDb);
+        const __m128i mantissaMask = _mm_set1_epi32 (0x007fffff);
+        const __m128i one          = _mm_set1_epi32 (0x3f800000);
+        const __m128i bias         = _mm_set1_epi32 (127);
+
+        for (; i + 4 <= numOfBins; i += 4)
+        {
+            const __m128 a = _mm_loadu_ps (bins + 2 * i);
+            const __m128 b = _mm_loadu_ps (bins + 2 * i + 4);
+            const __m128 re = _mm_shuffle_ps (a, b, _MM_SHUFFLE (2, 0, 2, 0));
+            const __m128 im = _mm_shuffle_ps (a, b, _MM_SHUFFLE (3, 1, 3, 1));
+            const __m128 mag = _mm_sqrt_ps (_mm_add_ps (_mm_mul_ps (re, re), _mm_mul_ps (im, im)));
+
+            // peak hold: a held bin shows the old max and decays it, otherwise the max restarts here
+            const __m128 oldMax = _mm_loadu_ps (maxValues + i);
+            const __m128 held   = _mm_cmpgt_ps (oldMax, mag);
+            const __m128 magLin = _mm_max_ps (oldMax, mag);
+            _mm_storeu_ps (maxValues + i, _mm_or_ps (_mm_and_ps    (held, _mm_mul_ps (oldMax, decay)),
+                                                     _mm_andnot_ps (held, mag)));
+
+            const __m128i bits  = _mm_castps_si128 (magLin);
+            const __m128 exponent = _mm_cvtepi32_ps (_mm_sub_epi32 (_mm_srli_epi32 (bits, 23), bias));
+            const __m128 m = _mm_castsi128_ps (_mm_or_si128 (_mm_and_si128 (bits, mantissaMask), one));
+
+            __m128 poly = _mm_set1_ps (log2Coeff4);
+            poly = _mm_add_ps (_mm_mul_ps (poly, m), _mm_set1_ps (log2Coeff3));
+            poly = _mm_add_ps (_mm_mul_ps (poly, m), _mm_set1_ps (log2Coeff2));
+            poly = _mm_add_ps (_mm_mul_ps (poly, m), _mm_set1_ps (log2Coeff1));
+            poly = _mm_add_ps (_mm_mul_ps (poly, m), _mm_set1_ps (log2Coeff0));
+
+            const __m128 db = _mm_add_ps (_mm_mul_ps (_mm_add_ps (exponent, poly), dbScale), offset);
+            _mm_storeu_ps (magnitudeDb + i, _mm_max_ps (db, floorDb));
+        }
+       #elif SPECTRUM_KERNEL_USE_SIMD && (defined (__ARM_NEON__) || defined (__ARM_NEON))
+        const float32x4_t decay   = vdupq_n_f32 (decayRatio);
+        const float32x4_t dbScale = vdupq_n_f32 (dbPerLog2);
+        const float32x4_t offset  = vdupq_n_f32 (dbOffset);
+        const float32x4_t floorDb = vdupq_n_f32 (minimumDb);
+        const uint32x4_t mantissaMask = vdupq_n_u32 (0x007fffff);
+        const uint32x4_t one          = vdupq_n_u32 (0x3f800000);
+        const int32x4_t  bias         = vdupq_n_s32 (127);
+
+        for (; i + 4 <= numOfBins; i += 4)
+        {
+            const float32x4x2_t reIm = vld2q_f32 (bins + 2 * i);
+            const float32x4_t power  = vmlaq_f32 (vmulq_f32 (reIm.val[0], reIm.val[0]), reIm.val[1], reIm.val[1]);
+
+            // sqrt through the reciprocal estimate, zero bins stay zero
+            float32x4_t invSqrt = vrsqrteq_f32 (power);
+            invSqrt = vmulq_f32 (invSqrt, vrsqrtsq_f32 (vmulq_f32 (power, invSqrt), invSqrt));
+            invSqrt = vmulq_f32 (invSqrt, vrsqrtsq_f32 (vmulq_f32 (power, invSqrt), invSqrt));
+            const float32x4_t mag = vbslq_f32 (vceqq_f32 (power, vdupq_n_f32 (0.0f)), power, vmulq_f32 (power, invSqrt));
+
+            const float32x4_t oldMax = vld1q_f32 (maxValues + i);
+            const uint32x4_t  held   = vcgtq_f32 (oldMax, mag);
+            const float32x4_t magLin = vmaxq_f32 (oldMax, mag);
+            vst1q_f32 (maxValues + i, vbslq_f32 (held, vmulq_f32 (oldMax, decay), mag));
+
+            const uint32x4_t bits = vreinterpretq_u32_f32 (magLin);
+            const float32x4_t exponent = vcvtq_f32_s32 (vsubq_s32 (vreinterpretq_s32_u32 (vshrq_n_u32 (bits, 23)), bias));
+            const float32x4_t m = vreinterpretq_f32_u32 (vorrq_u32 (vandq_u32 (bits, mantissaMask), one));
+
+            float32x4_t poly = vdupq_n_f32 (log2Coeff4);
+            poly = vmlaq_f32 (vdupq_n_f32 (log2Coeff3), poly, m);
+            poly = vmlaq_f32 (vdupq_n_f32 (log2Coeff2), poly, m);
+            poly = vmlaq_f32 (vdupq_n_f32 (log2Coeff1), poly, m);
+            poly = vmlaq_f32 (vdupq_n_f32 (log2Coeff0), poly, m);
+
+            const float32x4_t db = vmlaq_f32 (offset, vaddq_f32 (exponent, poly), dbScale);
+            vst1q_f32 (magnitudeDb + i, vmaxq_f32 (db, floorDb));
+        }
+       #endif
+
+        magnitudeToDbScalar (bins + 2 * i, numOfBins - i, maxValues + i, decayRatio, dbOffset, magnitudeDb + i);
+    }
+};
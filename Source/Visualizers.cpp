@@ -2,13 +2,16 @@
 
 //==============================================================================
 // SPECTRUM ANALYSER
-SpectrumAnalyser::SpectrumAnalyser(int sR, int fS, int cH, AudioBufferManagement& buffManag, forwardFFT& fFFT)
+SpectrumAnalyser::SpectrumAnalyser(int sR, int fS, int cH, AudioBufferManagement& buffManag, STFTAnalyser& stft)
 :
 axisNeedsUpdate(true),
 scaleModeAt(4),
 decayRatioAt(0.92f),
+interpolationAt(false),
 mainAudioBufferSystem (buffManag),
-forwFFT(fFFT)
+stftAnalyser(stft),
+widthAt(0),
+heightAt(0)
 {
     setTopLeftPosition(9,265); //7, 263
     setSize (710, 277); // 714,281
@@ -16,7 +19,6 @@ forwFFT(fFFT)
     setPaintingIsUnclipped(true);
     setOpaque(true);
 
-    conversionTable.    clear();
     maxValuesPre.       clear();
     maxValuesPost.      clear();
     monoMagDataPre.     clear();
@@ -31,30 +33,13 @@ forwFFT(fFFT)
     createNewAxis();
     
     // Init. the data & indexes Vectors
-    for (auto i = 0; i < fftSize; i++)
-    {
-        maxValuesPre.   push_back(0);
-        maxValuesPost.   push_back(0);
-    }
+    maxValuesPre    .resize (fftSize, 0.0f);
+    maxValuesPost   .resize (fftSize, 0.0f);
+    monoMagDataPre  .reserve (fftSize / 2 + 1);
+    monoMagDataPost .reserve (fftSize / 2 + 1);
     
-    for (auto i = 0; i < getWidth(); i++)
-    {
-        float res = ((float)sampleRate) / ((float)fftSize);
-        float F = std::exp((i * std::log((sampleRate / 2.f) / 10.f ) / getWidth()) + std::log(10));
-        float freqInBinScale = F * (1 / res);
-        
-        int   bin1 = (int)freqInBinScale;
-        float posBin1 = (getWidth() / log((sampleRate / 2) / 10)) * log((bin1 * res) / 10);
-        if (isinf(posBin1)) posBin1 = 0;
-        float posBin2 = (getWidth() / log((sampleRate / 2) / 10)) * log(((bin1 + 1) * res) / 10);
-        
-        std::vector<float> convTab(3,0);
-        convTab[0] = bin1;
-        convTab[1] = posBin1;
-        convTab[2] = posBin2;
-        
-        conversionTable.push_back(convTab);
-    }
+    reductionTable.build (getWidth(), fftSize, sampleRate);
+    pixelMagDb.resize (getWidth());
 }
 
 SpectrumAnalyser::~SpectrumAnalyser()
@@ -63,132 +48,148 @@ SpectrumAnalyser::~SpectrumAnalyser()
 
 void SpectrumAnalyser::paint (Graphics& g)
 {
-    createFrame();
+    if (axisNeedsUpdate.load())
+    {
+        createNewAxis();
+        axisNeedsUpdate.store (false);
+    }
+
+    {
+        const ScopedFrameAllocationCheck allocationCheck (maxNumOfPaintAllocations);
+        createFrame();
+    }
     g.drawImage (spectrumFrame, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
 }
 
 void SpectrumAnalyser::createFrame()
 {
 
-    spectrumFrame = Image(Image::PixelFormat::RGB, getWidth(), getHeight(), true);
+    spectrumFrame.clear (spectrumFrame.getBounds());
     Graphics g (spectrumFrame);
     
     g.setColour (Colour (0xff0f0f1c));
     g.fillRoundedRectangle(0, 0, getWidth(), getHeight(), 8.0f);
 
-    if ( axisNeedsUpdate.load())
-    {
-        createNewAxis();
-        axisNeedsUpdate.store(false);
-    }
-    processAllFftData (mainAudioBufferSystem.bufferPre,  monoMagDataPre,  maxValuesPre);
-    processAllFftData (mainAudioBufferSystem.bufferPost, monoMagDataPost, maxValuesPost);
-    
-    Path drawPathPre, drawPathPost;
-    
-    createPath (monoMagDataPre,  drawPathPre);
-    createPath (monoMagDataPost, drawPathPost);
+    const renderDataType& data = renderData.getReadBuffer();
     
     g.setColour  (Colours::lightgrey);
     g.setOpacity (0.3f);
-    g.strokePath (drawPathPre, PathStrokeType(1, PathStrokeType::beveled));
+    g.strokePath (data.drawPathPre, PathStrokeType(1, PathStrokeType::beveled));
     g.setColour  (Colours::dimgrey);
     g.setOpacity (0.1f);
-    g.fillPath   (drawPathPre);
+    g.fillPath   (data.drawPathPre);
     
     g.setColour  (Colours::whitesmoke);
     g.setOpacity (1.0f);
-    g.strokePath (drawPathPost, PathStrokeType (1.3, PathStrokeType::beveled));
+    g.strokePath (data.drawPathPost, PathStrokeType (1.3, PathStrokeType::beveled));
     g.setColour  (Colours::transparentWhite);
     g.setOpacity (0.1f);
-    g.fillPath   (drawPathPost);
+    g.fillPath   (data.drawPathPost);
     
     g.setOpacity(1.0f);
     g.drawImage (shadeWindow, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
     g.drawImage (axisImage, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
 }
 
-void SpectrumAnalyser::createPath ( std::vector<double>& magnitudeDBmono, Path &drawPath)
+void SpectrumAnalyser::prepareFrame()
+{
+    // the STFT switched to a new size, the per bin state follows it
+    const int fftSize = stftAnalyser.getFFTSize();
+    if (fftSize != fftSizeAt.load())
+    {
+        fftSizeAt.store (fftSize);
+        maxValuesPre    .assign (fftSize, 0.0f);
+        maxValuesPost   .assign (fftSize, 0.0f);
+        monoMagDataPre  .reserve (fftSize / 2 + 1);
+        monoMagDataPost .reserve (fftSize / 2 + 1);
+    }
+    
+    const int width = widthAt.load();
+    frameHeight = heightAt.load();
+    
+    const int numOfLogPoints = stftAnalyser.getNumOfLogPoints();
+    if (! reductionTable.matches (width, fftSizeAt.load(), sampleRateAt.load(), numOfLogPoints))
+    {
+        reductionTable.build (width, fftSizeAt.load(), sampleRateAt.load(), numOfLogPoints);
+        pixelMagDb.resize (width);
+        
+        // the held peaks belong to the old layout
+        std::fill (maxValuesPre.begin(),  maxValuesPre.end(),  0.0f);
+        std::fill (maxValuesPost.begin(), maxValuesPost.end(), 0.0f);
+    }
+    
+    // one lineTo per pixel column plus the closing points; the buffers the message thread
+    // may be reading are left alone, each one grows when it comes up for writing
+    renderDataType& data = renderData.getWriteBuffer();
+    if (data.preallocatedWidth != width)
+    {
+        data.drawPathPre  .preallocateSpace (3 * (width + 4));
+        data.drawPathPost .preallocateSpace (3 * (width + 4));
+        data.preallocatedWidth = width;
+    }
+}
+
+void SpectrumAnalyser::processData()
+{
+    STFTAnalyser::spectrumFramePtr frame = stftAnalyser.getLatestFrame();
+    if (frame == nullptr || frame->fftSize != fftSizeAt.load() || frame->numOfLogPoints != reductionTable.numOfLogPoints)
+        return;
+    
+    // the Welch average of every window since the last frame, or the multi-resolution points
+    const int numOfBins = frame->getViewNumOfBins();
+    processAllFftData (frame->getViewAveragePre  (spectrumFrameType::mid), numOfBins, frame->windowLength, monoMagDataPre,  maxValuesPre);
+    processAllFftData (frame->getViewAveragePost (spectrumFrameType::mid), numOfBins, frame->windowLength, monoMagDataPost, maxValuesPost);
+    
+    renderDataType& data = renderData.getWriteBuffer();
+    data.drawPathPre.clear();
+    data.drawPathPost.clear();
+    createPath (monoMagDataPre,  data.drawPathPre);
+    createPath (monoMagDataPost, data.drawPathPost);
+    renderData.publish();
+}
+
+void SpectrumAnalyser::createPath ( std::vector<float>& magnitudeDBmono, Path &drawPath)
 {
+    if (magnitudeDBmono.empty()) return;
+    
     int maxRange;
     switch (scaleModeAt.load()){
         case 1: maxRange = 54.f; break; case 2: maxRange = 72.f; break;
         case 3: maxRange = 90.f; break; case 4: maxRange = 108.f; break;
     }
-    int index = 0;
-    int finalPoint = getWidth() - 1;
-    int stuff;
+    const int width  = reductionTable.width;
+    const int height = frameHeight;
+    
+    // every bin counts toward its pixel column, the loudest one is drawn
+    reductionTable.reduce (magnitudeDBmono.data(), pixelReductionTable::maxReduction, pixelMagDb.data(), interpolationAt.load());
     
-    drawPath.startNewSubPath  (0, getHeight());
-    while ( index < finalPoint )
+    drawPath.startNewSubPath  (0, height);
+    for (auto x = 0; x < width; ++x)
     {
-        if ( index > 500 &&  index < 708)
-        {
-            stuff = 100;
-        }
-        
-        float posNextBin   = conversionTable [index][2];
-        float magActualBin = magnitudeDBmono [conversionTable [index][0]];
-        
-        float magDb = magActualBin;
-        magDb = ( 1 + (magDb / maxRange) ) * getHeight();
+        float magDb = ( 1 + (pixelMagDb[x] / maxRange) ) * height;
         if (isinf(magDb)  || isnan(magDb))   magDb  = 0;
         
-        drawPath.lineTo          (Point<float> (index, getHeight() - magDb));
-        index = (int)(posNextBin) + 1;
+        drawPath.lineTo          (Point<float> (x, height - magDb));
     }
-    drawPath.lineTo(getWidth(), getHeight());
+    drawPath.lineTo(width, height);
 }
 
-void SpectrumAnalyser::processAllFftData (audioBufferManagementType& buffer,  std::vector<double>& magintudeDbMono, std::vector<float>& maxValues )
+void SpectrumAnalyser::processAllFftData (const float* bins, int numOfBins, int windowLength, std::vector<float>& magnitudeDbMono, std::vector<float>& maxValues )
 {
-    magintudeDbMono.clear();
+    // the level follows the samples under the window, zero padding adds none
+    const float dbOffset = -20.0f * std::log10 (windowLength / 4.0f);
     
-    const int fftSize = fftSizeAt.load();
-    const int numOfChannels = buffer.historyBuffer.getNumChannels();
-     
-    AudioBuffer<float> auxBuffer (numOfChannels, fftSize * 2);
-    auxBuffer.clear();
-    buffer.copySamplesFromHistoryBuffer(auxBuffer, fftSize);
-    forwFFT.performFFT(auxBuffer);
-
-    double decayRatio = decayRatioAt.load();
-    for (auto i = 0; i < fftSize; i++)
-    {
-        float levelReal = 0;
-        float levelImag = 0;
-        
-        for (auto channel = 0; channel < auxBuffer.getNumChannels(); channel++)
-        {
-            levelReal =  auxBuffer.getSample(channel, (2 * i)) + levelReal;
-            levelImag =  auxBuffer.getSample(channel, (2 * i) + 1) + levelImag;
-        }
-        levelReal = levelReal / auxBuffer.getNumChannels();
-        levelImag = levelImag / auxBuffer.getNumChannels();
-        
-        float magLin = sqrt (std::pow(levelReal, 2) + std::pow(levelImag, 2));
-        peakHolder(i, magLin, maxValues, decayRatio);
-        
-        float magInDb = 20 * log10( magLin / (fftSize / 4));
-        magintudeDbMono.push_back(magInDb);
-    }
+    magnitudeDbMono.resize (numOfBins);
+    spectrumKernel::magnitudeToDb (bins, numOfBins, maxValues.data(), (float) decayRatioAt.load(), dbOffset, magnitudeDbMono.data());
 }
 
-void SpectrumAnalyser::peakHolder(int index, float& magLin, std::vector<float>& maxValues, double &decayRatio)
+void SpectrumAnalyser::resized()
 {
-    if ( maxValues[index] > magLin )
-    {
-        magLin = maxValues[index];
-        maxValues[index] = maxValues[index] * decayRatio;
-    }
-    else
-    {
-        maxValues[index] = magLin;
-    }
+    spectrumFrame = Image (Image::PixelFormat::RGB, getWidth(), getHeight(), true);
+    widthAt.store (getWidth());
+    heightAt.store (getHeight());
 }
 
-void SpectrumAnalyser::resized() {}
-
 void SpectrumAnalyser::createNewAxis()
 {
     axisImage = Image(Image::PixelFormat::RGB, getWidth(), getHeight(), true);
@@ -305,7 +306,7 @@ void SpectrumAnalyser::createNewAxis()
 
 //==============================================================================
 // SPECTRUM DIFFERENCE
-SpectrumDifference::SpectrumDifference(int sR, int fS, int cH, AudioBufferManagement& buffManag, forwardFFT& fFFT)
+SpectrumDifference::SpectrumDifference(int sR, int fS, int cH, AudioBufferManagement& buffManag, STFTAnalyser& stft)
 :
     axisNeedsUpdate(true),
     analyseMode(1),
@@ -313,8 +314,11 @@ SpectrumDifference::SpectrumDifference(int sR, int fS, int cH, AudioBufferManage
     fftSizeAt(fS),
     sampleRateAt(sR),
     numOfHistorySamplesAt(8),
+    estimatorAt(transferFunctionType::h1Estimator),
     mainAudioBufferSystem(buffManag),
-    forwFFT(fFFT)
+    stftAnalyser(stft),
+    widthAt(0),
+    heightAt(0)
 {
     setTopLeftPosition(9,552); //7, 263
     setSize (710, 116); // 714,281
@@ -322,15 +326,11 @@ SpectrumDifference::SpectrumDifference(int sR, int fS, int cH, AudioBufferManage
     setPaintingIsUnclipped(true);
     setOpaque(true);
 
-    numOfHistorySamples = numOfHistorySamplesAt.load();
-    
     conversionTable.    clear();
     linGainData1.       clear();
     linGainData2.       clear();
     
-    int sampleRate = sampleRateAt.load();
     int fftSize    = fftSizeAt.load();
-    int numOfHistorySamples = numOfHistorySamplesAt.load();
     
     createNewAxis();
 
@@ -339,22 +339,49 @@ SpectrumDifference::SpectrumDifference(int sR, int fS, int cH, AudioBufferManage
     {
         linGainData1. push_back(0);
         linGainData2. push_back(0);
-        historyValues1.push_back (std::vector<float> (numOfHistorySamples, 1.0f));
-        historyValues2.push_back (std::vector<float> (numOfHistorySamples, 1.0f));
     }
+    transfer1.setSize (fftSize / 2 + 1);
+    transfer2.setSize (fftSize / 2 + 1);
     
-    for (auto i = 0; i < getWidth(); i++)
+    createConversionTable (getWidth());
+}
+
+SpectrumDifference::~SpectrumDifference() 
+{
+}
+
+void SpectrumDifference::createConversionTable (int width)
+{
+    // pixel column -> FFT bin, for the log frequency axis
+    const int sampleRate = sampleRateAt.load();
+    const int fftSize    = fftSizeAt.load();
+    conversionTable.clear();
+    frameWidth = width;
+
+    if (numOfLogPoints > 0)
+    {
+        // multi-resolution points are on the pixel axis already
+        const float pixelsPerPoint = width / (float) numOfLogPoints;
+        for (auto i = 0; i < width; i++)
+        {
+            const int point = jmin (numOfLogPoints - 1, (int) (i / pixelsPerPoint));
+            conversionTable.push_back ({ (float) point, point * pixelsPerPoint, (point + 1) * pixelsPerPoint });
+        }
+        return;
+    }
+
+    for (auto i = 0; i < width; i++)
     {
         float res = ((float)sampleRate) / ((float)fftSize);
-        float F = std::exp((i * std::log((sampleRate / 2.f) / 10.f ) / getWidth()) + std::log(10));
+        float F = std::exp((i * std::log((sampleRate / 2.f) / 10.f ) / width) + std::log(10));
         float freqInBinScale = F * (1 / res);
         
         int   bin1 = (int)freqInBinScale;
-        float posBin1 = (getWidth() / log((sampleRate / 2) / 10))
+        float posBin1 = (width / log((sampleRate / 2) / 10))
         * log((bin1 * res) / 10);
         if (isinf(posBin1)) posBin1 = 0;
         
-        float posBin2 = (getWidth() / log((sampleRate / 2) / 10))
+        float posBin2 = (width / log((sampleRate / 2) / 10))
         * log(((bin1 + 1) * res) / 10);
         
         std::vector<float> convTab(3,0);
@@ -366,72 +393,139 @@ SpectrumDifference::SpectrumDifference(int sR, int fS, int cH, AudioBufferManage
     }
 }
 
-SpectrumDifference::~SpectrumDifference() 
-{
-}
-
 void SpectrumDifference::paint (Graphics& g)
 {
-    createFrame();
+    if (axisNeedsUpdate.load())
+        createNewAxis();
+
+    {
+        const ScopedFrameAllocationCheck allocationCheck (maxNumOfPaintAllocations);
+        createFrame();
+    }
     g.drawImage (mainFrame, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
 }
 
 void SpectrumDifference::createFrame()
 {
 
-    mainFrame = Image(Image::PixelFormat::RGB, getWidth(), getHeight(), true);
+    mainFrame.clear (mainFrame.getBounds());
     Graphics g (mainFrame);
 
     g.setColour (Colour (0xff0f0f1c));
     g.fillRoundedRectangle(0, 0, getWidth(), getHeight(), 8.0f);
 
-    if ( axisNeedsUpdate.load() ) createNewAxis();
-
-    processAllFftData (mainAudioBufferSystem.bufferPre, mainAudioBufferSystem.bufferPost, linGainData1, linGainData2 );
+    const renderDataType& data = renderData.getReadBuffer();
+    
+    // where the shade is low the chain is not linear there, the curve says little
+    g.setColour (Colours::steelblue.withAlpha (0.25f));
+    g.fillPath  (data.coherencePath);
     
-    if (analyseMode.load() == 1 )
+    if (data.analyseMode == 1 )
     {
-        Path drawPath1;
-        createPath (linGainData1, drawPath1);
         g.setColour  (Colours::whitesmoke);
         g.setOpacity (1.0f);
-        g.strokePath (drawPath1, PathStrokeType (1.3, PathStrokeType::beveled));
+        g.strokePath (data.drawPath1, PathStrokeType (1.3, PathStrokeType::beveled));
     }
-    else if (analyseMode.load() == 2 )
+    else if (data.analyseMode == 2 )
     {
-        Path drawPath1, drawPath2;
-        createPath (linGainData1, drawPath1);
-        createPath (linGainData2, drawPath2);
-        
         g.setColour  (Colours::lightgoldenrodyellow);
         g.setOpacity (1.0f);
-        g.strokePath (drawPath1, PathStrokeType (1.3, PathStrokeType::beveled));
+        g.strokePath (data.drawPath1, PathStrokeType (1.3, PathStrokeType::beveled));
         
         g.setColour  (Colours::skyblue);
         g.setOpacity (1.0f);
-        g.strokePath (drawPath2, PathStrokeType (1.3, PathStrokeType::beveled));
+        g.strokePath (data.drawPath2, PathStrokeType (1.3, PathStrokeType::beveled));
     }
-    else if (analyseMode.load() == 3 )
+    else if (data.analyseMode == 3 )
     {
-        Path drawPath1, drawPath2;
-        createPath (linGainData1, drawPath1);
-        createPath (linGainData2, drawPath2);
-        
         g.setColour  (Colours::whitesmoke);
         g.setOpacity (1.0f);
-        g.strokePath (drawPath1, PathStrokeType (1.3, PathStrokeType::beveled));
+        g.strokePath (data.drawPath1, PathStrokeType (1.3, PathStrokeType::beveled));
         
         g.setColour  (Colours::palevioletred);
         g.setOpacity (1.0f);
-        g.strokePath (drawPath2, PathStrokeType (1.3, PathStrokeType::beveled));
+        g.strokePath (data.drawPath2, PathStrokeType (1.3, PathStrokeType::beveled));
     }
     
     g.drawImage (shadeWindow, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
     g.drawImage (axisImage, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
 }
 
+void SpectrumDifference::prepareFrame()
+{
+    // the STFT switched to a new size or layout, the per bin state follows it
+    const int fftSize = stftAnalyser.getFFTSize();
+    const int width   = widthAt.load();
+    frameHeight = heightAt.load();
+    
+    if (fftSize != fftSizeAt.load() || stftAnalyser.getNumOfLogPoints() != numOfLogPoints || width != frameWidth)
+    {
+        fftSizeAt.store (fftSize);
+        numOfLogPoints = stftAnalyser.getNumOfLogPoints();
+        linGainData1.reserve (fftSize);
+        linGainData2.reserve (fftSize);
+        createConversionTable (width);
+    }
+    
+    const int numOfBins = numOfLogPoints > 0 ? numOfLogPoints : fftSize / 2 + 1;
+    if (transfer1.getNumOfBins() != numOfBins)
+    {
+        transfer1.setSize (numOfBins);
+        transfer2.setSize (numOfBins);
+        lastFrameIndex = -1;
+    }
+    
+    // one lineTo per pixel column plus the closing points, in the buffer written next only:
+    // the message thread may be drawing the others, they grow when they come up for writing
+    renderDataType& data = renderData.getWriteBuffer();
+    if (data.preallocatedWidth != width)
+    {
+        data.drawPath1     .preallocateSpace (3 * (width + 4));
+        data.drawPath2     .preallocateSpace (3 * (width + 4));
+        data.coherencePath .preallocateSpace (3 * (width + 6));
+        data.preallocatedWidth = width;
+    }
+}
+
+void SpectrumDifference::processData()
+{
+    STFTAnalyser::spectrumFramePtr frame = stftAnalyser.getLatestFrame();
+    if (frame == nullptr || frame->fftSize != fftSizeAt.load() || frame->numOfLogPoints != numOfLogPoints)
+        return;
+    
+    const int mode = analyseMode.load();
+    if (mode != lastAnalyseMode)
+    {
+        // the curves follow other channels now, what they averaged so far does not apply
+        transfer1.reset();
+        transfer2.reset();
+        lastAnalyseMode = mode;
+        lastFrameIndex = -1;
+    }
+    
+    // every frame goes into the average once, however often the views are drawn
+    if (frame->frameIndex != lastFrameIndex)
+    {
+        lastFrameIndex = frame->frameIndex;
+        addFrame (*frame, mode);
+    }
+    processAllFftData (mode, linGainData1, linGainData2 );
+    
+    renderDataType& data = renderData.getWriteBuffer();
+    data.drawPath1.clear();
+    data.drawPath2.clear();
+    data.coherencePath.clear();
+    createPath (linGainData1, data.drawPath1);
+    if (mode != 1) createPath (linGainData2, data.drawPath2);
+    createCoherencePath (transfer1, data.coherencePath);
+    data.analyseMode = mode;
+    renderData.publish();
+}
+
 void SpectrumDifference::createPath ( std::vector<double>& magnitudeDBmono, Path &drawPath)
 {
+    if (magnitudeDBmono.empty() || frameWidth < 2) return;
+    
     int maxRange;
     switch (scaleModeAt.load())
     {
@@ -439,198 +533,95 @@ void SpectrumDifference::createPath ( std::vector<double>& magnitudeDBmono, Path
         case 3: maxRange = 144.f; break; case 4: maxRange = 240.f; break;
     }
     int index = 0;
-    int finalPoint = getWidth() - 1;
+    int finalPoint = frameWidth - 1;
     
-    drawPath.startNewSubPath  (0, getHeight()/2);
+    drawPath.startNewSubPath  (0, frameHeight/2);
     while ( index != finalPoint )
     {
         float posNextBin   = conversionTable [index][2];
         float magActualBin = magnitudeDBmono [conversionTable [index][0]];
         
         float magDb = magActualBin;
-        magDb = ( (magDb / maxRange) ) * getHeight();
+        magDb = ( (magDb / maxRange) ) * frameHeight;
         if (isinf(magDb)  || isnan(magDb))   magDb  = 0;
         
-        drawPath.lineTo          (Point<float> (index, (getHeight()/2.f) - magDb));
+        drawPath.lineTo          (Point<float> (index, (frameHeight/2.f) - magDb));
         index = (int)(posNextBin) + 1;
     }
-    drawPath.lineTo(getWidth(), getHeight()/2.f);
+    drawPath.lineTo(frameWidth, frameHeight/2.f);
 }
 
-void SpectrumDifference::processAllFftData (audioBufferManagementType& bufferPre, audioBufferManagementType& bufferPost, std::vector<double>& linGain1, std::vector<double>& linGain2 )
+void SpectrumDifference::createCoherencePath (const transferFunctionType& transfer, Path& drawPath)
 {
-    linGain1.clear();
-    linGain2.clear();
+    if (transfer.getNumOfBins() == 0 || frameWidth < 2) return;
     
-    const int fftSize    = fftSizeAt.load();
-    const int numOfChannels = bufferPre.historyBuffer.getNumChannels();
-    
-    AudioBuffer<float> auxBufferPre (numOfChannels, fftSize * 2);
-    auxBufferPre.clear();
-    bufferPre.copySamplesFromHistoryBuffer(auxBufferPre, fftSize);
-    forwFFT.performFFT(auxBufferPre);
-    
-    AudioBuffer<float> auxBufferPost (numOfChannels, fftSize * 2);
-    auxBufferPost.clear();
-    bufferPost.copySamplesFromHistoryBuffer(auxBufferPost, fftSize);
-    forwFFT.performFFT(auxBufferPost);
+    int index = 0;
+    int finalPoint = frameWidth - 1;
     
-    for (auto i = 0; i < fftSize; i++)
+    drawPath.startNewSubPath (0, frameHeight);
+    while ( index != finalPoint )
     {
-        
-        switch (analyseMode.load())
-        {
-            case 1: // MONO ANALYSIS
-            {
-                float levelRealPre = 0;
-                float levelImagPre = 0;
-                float levelRealPost = 0;
-                float levelImagPost = 0;
-
-                for (auto channel = 0; channel < 1; channel++)
-                {
-                    levelRealPre =   auxBufferPre.getSample (channel, (2 * i))         + levelRealPre;
-                    levelImagPre =   auxBufferPre.getSample (channel, (2 * i) + 1)     + levelImagPre;
-                    levelRealPost =  auxBufferPost.getSample (channel, (2 * i))     + levelRealPost;
-                    levelImagPost =  auxBufferPost.getSample (channel, (2 * i) + 1) + levelImagPost;
-                }
-                levelRealPre  = levelRealPre / auxBufferPre.getNumChannels();
-                levelImagPre  = levelImagPre / auxBufferPre.getNumChannels();
-                levelRealPost = levelRealPost / auxBufferPost.getNumChannels();
-                levelImagPost = levelImagPost / auxBufferPost.getNumChannels();
-                
-                float magLinPre  = sqrt (std::pow(levelRealPre, 2)  + std::pow(levelImagPre, 2));
-                float magLinPost = sqrt (std::pow(levelRealPost, 2) + std::pow(levelImagPost, 2));
-                
-                float gain = magLinPost / magLinPre;
-                if (isinf(gain) ) gain = 0;
-                
-                peakHolder(i, gain, historyValues1);
-                
-                float gainInDb = 20 * log10 (gain);
-                linGain1.push_back(gainInDb);
-                break;
-            }
-            case 2: // LEFT/RIGHT ANALYSIS
-            {
-                float levelRealPreL  = auxBufferPre.getSample(0, (2 * i));
-                float levelImagPreL  = auxBufferPre.getSample(0, (2 * i) + 1);
-                float levelRealPostL = auxBufferPost.getSample(0, (2 * i));
-                float levelImagPostL = auxBufferPost.getSample(0, (2 * i) + 1);
-                
-                float magLinPreL  = sqrt  (std::pow(levelRealPreL, 2) + std::pow(levelImagPreL, 2));
-                float magLinPostL = sqrt (std::pow(levelRealPostL, 2) + std::pow(levelImagPostL, 2));
-
-                float gainLinL = magLinPostL / magLinPreL;
-                
-                peakHolder(i, gainLinL, historyValues1);
-                
-                float gainInDbL = 20 * log10 (gainLinL);
-                linGain1.push_back(gainInDbL);
-                
-                float levelRealPreR  = auxBufferPre.getSample(1, (2 * i));
-                float levelImagPreR  = auxBufferPre.getSample(1, (2 * i) + 1);
-                float levelRealPostR = auxBufferPost.getSample(1, (2 * i));
-                float levelImagPostR = auxBufferPost.getSample(1, (2 * i) + 1);
-                
-                float magLinPreR  = sqrt (std::pow(levelRealPreR, 2) + std::pow(levelImagPreR, 2));
-                float magLinPostR = sqrt (std::pow(levelRealPostR, 2) + std::pow(levelImagPostR, 2));
-                
-                float gainLinR = magLinPostR / magLinPreR;
-                
-                peakHolder(i, gainLinR, historyValues2);
-                
-                float gainInDbR = 20 * log10 (gainLinR);
-                linGain2.push_back(gainInDbR);
-                
-                break;
-            }
-            case 3: // MID/SIDE ANALYSIS
-            {
-                float levelRealL = auxBufferPre.getSample(0, (2 * i));
-                float levelImagL = auxBufferPre.getSample(0, (2 * i) + 1);
-                float levelRealR = auxBufferPre.getSample(1, (2 * i));
-                float levelImagR = auxBufferPre.getSample(1, (2 * i) + 1);
-
-                float magLinMidPre = sqrt( std::pow((levelRealL + levelRealR) / 2, 2)
-                                          + std::pow((levelImagL + levelImagR) / 2, 2));
-                
-                levelRealL = auxBufferPost.getSample(0, (2 * i));
-                levelImagL = auxBufferPost.getSample(0, (2 * i) + 1);
-                levelRealR = auxBufferPost.getSample(1, (2 * i));
-                levelImagR = auxBufferPost.getSample(1, (2 * i) + 1);
-
-                float magLinMidPost = sqrt( std::pow((levelRealL + levelRealR) / 2, 2)
-                                           + std::pow((levelImagL + levelImagR) / 2, 2));
-                
-                float gainLinMid = magLinMidPost / magLinMidPre;
-                
-                peakHolder(i, gainLinMid, historyValues1);
-                float gainInDbMid = 20 * log10 (gainLinMid);
-                linGain1.push_back(gainInDbMid);
-                
-                
-                
-                levelRealL = auxBufferPre.getSample(0, (2 * i));
-                levelImagL = auxBufferPre.getSample(0, (2 * i) + 1);
-                levelRealR = auxBufferPre.getSample(1, (2 * i));
-                levelImagR = auxBufferPre.getSample(1, (2 * i) + 1);
-                
-                float sideLinPre = sqrt( std::pow((levelRealL - levelRealR) / 2, 2)
-                                          + std::pow((levelImagL - levelImagR) / 2, 2));
-                
-                levelRealL = auxBufferPost.getSample(0, (2 * i));
-                levelImagL = auxBufferPost.getSample(0, (2 * i) + 1);
-                levelRealR = auxBufferPost.getSample(1, (2 * i));
-                levelImagR = auxBufferPost.getSample(1, (2 * i) + 1);
-                
-                float sideLinPost = sqrt( std::pow((levelRealL - levelRealR) / 2, 2)
-                                        + std::pow((levelImagL - levelImagR) / 2, 2));
-
-                float gainLinSide = sideLinPost / sideLinPre;
-                
-                peakHolder(i, gainLinSide, historyValues2);
-                float gainInDbSide = 20 * log10 (gainLinSide);
-                linGain2.push_back(gainInDbSide);
-                
-                break;
-            }
-        }
+        const int bin = jmin (transfer.getNumOfBins() - 1, (int) conversionTable [index][0]);
+        drawPath.lineTo (index, frameHeight * (1.0f - transfer.getCoherence (bin)));
+        index = (int)(conversionTable [index][2]) + 1;
     }
+    drawPath.lineTo (frameWidth, frameHeight);
+    drawPath.closeSubPath();
 }
 
-void SpectrumDifference::peakHolder(int index, float& magLin, floatMatrix &historySamples)
+void SpectrumDifference::addFrame (const spectrumFrameType& frame, int mode)
 {
-    if (numOfHistorySamples != numOfHistorySamplesAt.load())
+    // every frame weighs 1 / numOfHistorySamples, the older ones fade out geometrically
+    const float smoothing = 1.0f - 1.0f / jmax (1, numOfHistorySamplesAt.load());
+    auto add = [&frame, smoothing] (transferFunctionType& transfer, int channel)
     {
-        historyValues1.clear();
-        historyValues2.clear();
-        numOfHistorySamples = numOfHistorySamplesAt.load();
-        int fftSize = fftSizeAt.load();
-        for (auto i = 0; i < fftSize; i++)
-        {
-            historyValues1.push_back (std::vector<float> (numOfHistorySamples, 1.0f));
-            historyValues2.push_back (std::vector<float> (numOfHistorySamples, 1.0f));
-        }
-    }
-        
-    for (auto i = 0 ; i < numOfHistorySamples; ++i)
+        transfer.addFrame (frame.getViewAveragePre (channel), frame.getViewAveragePost (channel),
+                           frame.getViewCrossSpectrum (channel), smoothing);
+    };
+    
+    switch (mode)
     {
-        if (i == numOfHistorySamples - 1)
-            historySamples[index][i] = magLin;
-        else
-            historySamples[index][i] = historySamples[index][i + 1];
+        case 1: // MONO ANALYSIS
+            add (transfer1, spectrumFrameType::mid);
+            break;
+        case 2: // LEFT/RIGHT ANALYSIS
+            add (transfer1, spectrumFrameType::left);
+            add (transfer2, spectrumFrameType::right);
+            break;
+        case 3: // MID/SIDE ANALYSIS
+            add (transfer1, spectrumFrameType::mid);
+            add (transfer2, spectrumFrameType::side);
+            break;
     }
+}
+
+void SpectrumDifference::processAllFftData (int mode, std::vector<double>& linGain1, std::vector<double>& linGain2 )
+{
+    linGain1.clear();
+    linGain2.clear();
     
-    float averageValue = 0;
-    for (auto i = 0; i < numOfHistorySamples; ++i)
-        averageValue = historySamples[index][i] + averageValue;
-    averageValue = averageValue / numOfHistorySamples;
+    processGainData (transfer1, linGain1);
+    if (mode != 1)
+        processGainData (transfer2, linGain2);
+}
+
+void SpectrumDifference::processGainData (const transferFunctionType& transfer, std::vector<double>& linGain)
+{
+    const auto estimator = (transferFunctionType::estimatorType) estimatorAt.load();
     
-    magLin = averageValue;
+    for (auto i = 0; i < transfer.getNumOfBins(); i++)
+    {
+        float gainInDb = 20 * log10 (transfer.getGain (i, estimator));
+        linGain.push_back(gainInDb);
+    }
 }
 
-void SpectrumDifference::resized() {}
+void SpectrumDifference::resized()
+{
+    mainFrame = Image (Image::PixelFormat::RGB, getWidth(), getHeight(), true);
+    widthAt.store (getWidth());
+    heightAt.store (getHeight());
+}
 
 void SpectrumDifference::createNewAxis()
 {
@@ -854,12 +845,14 @@ void SpectrumDifference::createNewAxis()
 
 //==============================================================================
 // PHASE DIFFERENCE
-PhaseDifference::PhaseDifference(int sR, int fS, int nC, AudioBufferManagement& buffManag, forwardFFT& fFFT)
+PhaseDifference::PhaseDifference(int sR, int fS, int nC, AudioBufferManagement& buffManag, STFTAnalyser& stft)
 :
     analyseMode(1),
     numOfHistorySamplesAt(8),
     mainAudioBufferSystem(buffManag),
-    forwFFT(fFFT)
+    stftAnalyser(stft),
+    widthAt(0),
+    heightAt(0)
 {
     setTopLeftPosition(9,668); //7, 263
     setSize (710, 116); // 714,281
@@ -875,9 +868,7 @@ PhaseDifference::PhaseDifference(int sR, int fS, int nC, AudioBufferManagement&
     fftSizeAt    .store(fS);
     
     
-    const int sampleRate = sampleRateAt.load();
     const int fftSize    = fftSizeAt.load();
-    numOfHistorySamples = numOfHistorySamplesAt.load();
     
     createNewAxis();
     
@@ -886,22 +877,49 @@ PhaseDifference::PhaseDifference(int sR, int fS, int nC, AudioBufferManagement&
     {
         linGainData1. push_back(0);
         linGainData2. push_back(0);
-        historyValues1.push_back (std::vector<float> (numOfHistorySamples, 0.f));
-        historyValues2.push_back (std::vector<float> (numOfHistorySamples, 0.f));
     }
+    transfer1.setSize (fftSize / 2 + 1);
+    transfer2.setSize (fftSize / 2 + 1);
     
-    for (auto i = 0; i < getWidth(); i++)
+    createConversionTable (getWidth());
+}
+
+PhaseDifference::~PhaseDifference()
+{
+}
+
+void PhaseDifference::createConversionTable (int width)
+{
+    // pixel column -> FFT bin, for the log frequency axis
+    const int sampleRate = sampleRateAt.load();
+    const int fftSize    = fftSizeAt.load();
+    conversionTable.clear();
+    frameWidth = width;
+
+    if (numOfLogPoints > 0)
+    {
+        // multi-resolution points are on the pixel axis already
+        const float pixelsPerPoint = width / (float) numOfLogPoints;
+        for (auto i = 0; i < width; i++)
+        {
+            const int point = jmin (numOfLogPoints - 1, (int) (i / pixelsPerPoint));
+            conversionTable.push_back ({ (float) point, point * pixelsPerPoint, (point + 1) * pixelsPerPoint });
+        }
+        return;
+    }
+
+    for (auto i = 0; i < width; i++)
     {
         float res = ((float)sampleRate) / ((float)fftSize);
-        float F = std::exp((i * std::log((sampleRate / 2.f) / 10.f ) / getWidth()) + std::log(10));
+        float F = std::exp((i * std::log((sampleRate / 2.f) / 10.f ) / width) + std::log(10));
         float freqInBinScale = F * (1 / res);
         
         int   bin1 = (int)freqInBinScale;
-        float posBin1 = (getWidth() / log((sampleRate / 2) / 10))
+        float posBin1 = (width / log((sampleRate / 2) / 10))
         * log((bin1 * res) / 10);
         if (isinf(posBin1)) posBin1 = 0;
         
-        float posBin2 = (getWidth() / log((sampleRate / 2) / 10))
+        float posBin2 = (width / log((sampleRate / 2) / 10))
         * log(((bin1 + 1) * res) / 10);
         
         std::vector<float> convTab(3,0);
@@ -913,337 +931,199 @@ PhaseDifference::PhaseDifference(int sR, int fS, int nC, AudioBufferManagement&
     }
 }
 
-PhaseDifference::~PhaseDifference()
-{
-}
-
 void PhaseDifference::paint (Graphics& g)
 {
-    createFrame();
+    {
+        const ScopedFrameAllocationCheck allocationCheck (maxNumOfPaintAllocations);
+        createFrame();
+    }
     g.drawImage (mainFrame, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
 }
 
 void PhaseDifference::createFrame()
 {
-    mainFrame = Image(Image::PixelFormat::RGB, getWidth(), getHeight(), true);
+    mainFrame.clear (mainFrame.getBounds());
     Graphics g (mainFrame);
     
     g.setColour (Colour (0xff0f0f1c));
     g.fillRoundedRectangle(0, 0, getWidth(), getHeight(), 8.0f);
     
-    processAllFftData (mainAudioBufferSystem.bufferPre, mainAudioBufferSystem.bufferPost, linGainData1, linGainData2 );
+    const renderDataType& data = renderData.getReadBuffer();
     
-    if (analyseMode.load() == 1 )
+    if (data.analyseMode == 1 )
     {
-        Path drawPath1;
-        createPath (linGainData1, drawPath1);
         g.setColour  (Colours::whitesmoke);
         g.setOpacity (1.0f);
-        g.strokePath (drawPath1, PathStrokeType (1.3, PathStrokeType::beveled));
+        g.strokePath (data.drawPath1, PathStrokeType (1.3, PathStrokeType::beveled));
     }
-    else if (analyseMode.load() == 2 )
+    else if (data.analyseMode == 2 )
     {
-        Path drawPath1, drawPath2;
-        createPath (linGainData1, drawPath1);
-        createPath (linGainData2, drawPath2);
-        
         g.setColour  (Colours::lightgoldenrodyellow);
         g.setOpacity (1.0f);
-        g.strokePath (drawPath1, PathStrokeType (1.3, PathStrokeType::beveled));
+        g.strokePath (data.drawPath1, PathStrokeType (1.3, PathStrokeType::beveled));
         
         g.setColour  (Colours::skyblue);
         g.setOpacity (1.0f);
-        g.strokePath (drawPath2, PathStrokeType (1.3, PathStrokeType::beveled));
+        g.strokePath (data.drawPath2, PathStrokeType (1.3, PathStrokeType::beveled));
     }
-    else if (analyseMode.load() == 3 )
+    else if (data.analyseMode == 3 )
     {
-        Path drawPath1, drawPath2;
-        createPath (linGainData1, drawPath1);
-        createPath (linGainData2, drawPath2);
-        
         g.setColour  (Colours::whitesmoke);
         g.setOpacity (1.0f);
-        g.strokePath (drawPath1, PathStrokeType (1.3, PathStrokeType::beveled));
+        g.strokePath (data.drawPath1, PathStrokeType (1.3, PathStrokeType::beveled));
         
         g.setColour  (Colours::palevioletred);
         g.setOpacity (1.0f);
-        g.strokePath (drawPath2, PathStrokeType (1.3, PathStrokeType::beveled));
+        g.strokePath (data.drawPath2, PathStrokeType (1.3, PathStrokeType::beveled));
     }
     
     g.drawImage (shadeWindow, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
     g.drawImage (axisImage, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
 }
 
+void PhaseDifference::prepareFrame()
+{
+    // the STFT switched to a new size or layout, the per bin state follows it
+    const int fftSize = stftAnalyser.getFFTSize();
+    const int width   = widthAt.load();
+    frameHeight = heightAt.load();
+    
+    if (fftSize != fftSizeAt.load() || stftAnalyser.getNumOfLogPoints() != numOfLogPoints || width != frameWidth)
+    {
+        fftSizeAt.store (fftSize);
+        numOfLogPoints = stftAnalyser.getNumOfLogPoints();
+        linGainData1.reserve (fftSize);
+        linGainData2.reserve (fftSize);
+        createConversionTable (width);
+    }
+    
+    const int numOfBins = numOfLogPoints > 0 ? numOfLogPoints : fftSize / 2 + 1;
+    if (transfer1.getNumOfBins() != numOfBins)
+    {
+        transfer1.setSize (numOfBins);
+        transfer2.setSize (numOfBins);
+        lastFrameIndex = -1;
+    }
+    
+    // one lineTo per pixel column plus the closing points, in the buffer written next only:
+    // the message thread may be drawing the others, they grow when they come up for writing
+    renderDataType& data = renderData.getWriteBuffer();
+    if (data.preallocatedWidth != width)
+    {
+        data.drawPath1 .preallocateSpace (3 * (width + 4));
+        data.drawPath2 .preallocateSpace (3 * (width + 4));
+        data.preallocatedWidth = width;
+    }
+}
+
+void PhaseDifference::processData()
+{
+    STFTAnalyser::spectrumFramePtr frame = stftAnalyser.getLatestFrame();
+    if (frame == nullptr || frame->fftSize != fftSizeAt.load() || frame->numOfLogPoints != numOfLogPoints)
+        return;
+    
+    const int mode = analyseMode.load();
+    if (mode != lastAnalyseMode)
+    {
+        transfer1.reset();
+        transfer2.reset();
+        lastAnalyseMode = mode;
+        lastFrameIndex = -1;
+    }
+    
+    if (frame->frameIndex != lastFrameIndex)
+    {
+        lastFrameIndex = frame->frameIndex;
+        addFrame (*frame, mode);
+    }
+    processAllFftData (mode, linGainData1, linGainData2 );
+    
+    renderDataType& data = renderData.getWriteBuffer();
+    data.drawPath1.clear();
+    data.drawPath2.clear();
+    createPath (linGainData1, data.drawPath1);
+    if (mode != 1) createPath (linGainData2, data.drawPath2);
+    data.analyseMode = mode;
+    renderData.publish();
+}
+
 void PhaseDifference::createPath ( std::vector<double>& magnitudeDBmono, Path &drawPath)
 {
+    if (magnitudeDBmono.empty() || frameWidth < 2) return;
+
 
     int index = 0;
-    int finalPoint = getWidth() - 1;
+    int finalPoint = frameWidth - 1;
     
-    drawPath.startNewSubPath  (0, getHeight()/2);
+    drawPath.startNewSubPath  (0, frameHeight/2);
     while ( index != finalPoint )
     {
         float posNextBin   = conversionTable [index][2];
         float magActualBin = magnitudeDBmono [conversionTable [index][0]];
         
         float magDb = magActualBin;
-        magDb = magActualBin * getHeight();
+        magDb = magActualBin * frameHeight;
         if (isinf(magDb)  || isnan(magDb))   magDb  = 0;
         
-        drawPath.lineTo          (Point<float> (index, (getHeight()/2.f) - magDb));
+        drawPath.lineTo          (Point<float> (index, (frameHeight/2.f) - magDb));
         index = (int)(posNextBin) + 1;
     }
-    drawPath.lineTo(getWidth(), getHeight()/2.f);
+    drawPath.lineTo(frameWidth, frameHeight/2.f);
+}
+
+void PhaseDifference::addFrame (const spectrumFrameType& frame, int mode)
+{
+    // the phase comes from the averaged cross spectrum, so it never wraps while it averages
+    const float smoothing = 1.0f - 1.0f / jmax (1, numOfHistorySamplesAt.load());
+    auto add = [&frame, smoothing] (transferFunctionType& transfer, int channel)
+    {
+        transfer.addFrame (frame.getViewAveragePre (channel), frame.getViewAveragePost (channel),
+                           frame.getViewCrossSpectrum (channel), smoothing);
+    };
+    
+    switch (mode)
+    {
+        case 1: // MONO ANALYSIS
+            add (transfer1, spectrumFrameType::mid);
+            break;
+        case 2: // LEFT/RIGHT ANALYSIS
+            add (transfer1, spectrumFrameType::left);
+            add (transfer2, spectrumFrameType::right);
+            break;
+        case 3: // MID/SIDE ANALYSIS
+            add (transfer1, spectrumFrameType::mid);
+            add (transfer2, spectrumFrameType::side);
+            break;
+    }
 }
 
-void PhaseDifference::processAllFftData (audioBufferManagementType& bufferPre, audioBufferManagementType& bufferPost, std::vector<double>& linGain1, std::vector<double>& linGain2 )
+void PhaseDifference::processAllFftData (int mode, std::vector<double>& linGain1, std::vector<double>& linGain2 )
 {
     linGain1.clear();
     linGain2.clear();
     
-    const int fftSize    = fftSizeAt.load();
-    const int numOfChannels = bufferPre.historyBuffer.getNumChannels();
-    
-    
-    AudioBuffer<float> auxBufferPre (numOfChannels, fftSize * 2);
-    auxBufferPre.clear();
-    bufferPre.copySamplesFromHistoryBuffer(auxBufferPre, fftSize);
-    forwFFT.performFFT(auxBufferPre);
-    
-    AudioBuffer<float> auxBufferPost (numOfChannels, fftSize * 2);
-    auxBufferPost.clear();
-    bufferPost.copySamplesFromHistoryBuffer(auxBufferPost, fftSize);
-    forwFFT.performFFT(auxBufferPost);
+    processPhaseData (transfer1, linGain1);
+    if (mode != 1)
+        processPhaseData (transfer2, linGain2);
+}
 
-    for (auto i = 0; i < fftSize; i++)
+void PhaseDifference::processPhaseData (const transferFunctionType& transfer, std::vector<double>& phaseDiffs)
+{
+    for (auto i = 0; i < transfer.getNumOfBins(); i++)
     {
-        
-        switch (analyseMode.load())
-        {
-            case 1: // MONO ANALYSIS
-            {
-                float levelRealPre = 0;
-                float levelImagPre = 0;
-                float levelRealPost = 0;
-                float levelImagPost = 0;
-                
-                for (auto channel = 0; channel < 1; channel++)
-                {
-                    levelRealPre =   auxBufferPre.getSample (channel, (2 * i))         + levelRealPre;
-                    levelImagPre =   auxBufferPre.getSample (channel, (2 * i) + 1)     + levelImagPre;
-                    levelRealPost =  auxBufferPost.getSample (channel, (2 * i))     + levelRealPost;
-                    levelImagPost =  auxBufferPost.getSample (channel, (2 * i) + 1) + levelImagPost;
-                }
-                levelRealPre  = levelRealPre / auxBufferPre.getNumChannels();
-                levelImagPre  = levelImagPre / auxBufferPre.getNumChannels();
-                levelRealPost = levelRealPost / auxBufferPost.getNumChannels();
-                levelImagPost = levelImagPost / auxBufferPost.getNumChannels();
-                
-                float magLinPre  = sqrt (std::pow(levelRealPre, 2)  + std::pow(levelImagPre, 2));
-                float angPre = std::asin (levelImagPre / magLinPre);
-                if (levelRealPre < 0 && levelImagPre > 0) angPre = -angPre + juce::float_Pi;
-                if (levelRealPre < 0 && levelImagPre < 0) angPre = -angPre - juce::float_Pi;
-
-                float magLinPost = sqrt (std::pow(levelRealPost, 2) + std::pow(levelImagPost, 2));
-                float angPost = std::asin (levelImagPost / magLinPost);
-                if (levelRealPost < 0 && levelImagPost > 0) angPost = -angPost + juce::float_Pi;
-                if (levelRealPost < 0 && levelImagPost < 0) angPost = -angPost - juce::float_Pi;
-                
-                float phaseDiffPre = angPre - angPost;
-                int numOfCompleteCycles = (int) (phaseDiffPre / juce::float_Pi);
-                if (numOfCompleteCycles < -1 ) numOfCompleteCycles = -1;
-                float d = phaseDiffPre - (2 * juce::float_Pi * numOfCompleteCycles);
-                phaseDiffPre = d;
-                if (d >  juce::float_Pi) d =  juce::float_Pi;
-                if (d < -juce::float_Pi) d = -juce::float_Pi;
-                phaseDiffPre = d / (2 * juce::float_Pi);
-                
-                peakHolder(i, phaseDiffPre, historyValues1);
-                
-                linGain1.push_back(phaseDiffPre);
-                break;
-            }
-            case 2: // LEFT/RIGHT ANALYSIS
-            {
-                // LEFT CHANNEL
-                float levelRealPre  = auxBufferPre.getSample(0, (2 * i));
-                float levelImagPre  = auxBufferPre.getSample(0, (2 * i) + 1);
-                float levelRealPost = auxBufferPost.getSample(0, (2 * i));
-                float levelImagPost = auxBufferPost.getSample(0, (2 * i) + 1);
-                
-                float magLinPre  = sqrt (std::pow(levelRealPre, 2)  + std::pow(levelImagPre, 2));
-                float angPre = std::asin (levelImagPre / magLinPre);
-                if (levelRealPre < 0 && levelImagPre > 0) angPre = -angPre + juce::float_Pi;
-                if (levelRealPre < 0 && levelImagPre < 0) angPre = -angPre - juce::float_Pi;
-                
-                float magLinPost = sqrt (std::pow(levelRealPost, 2) + std::pow(levelImagPost, 2));
-                float angPost = std::asin (levelImagPost / magLinPost);
-                if (levelRealPost < 0 && levelImagPost > 0) angPost = -angPost + juce::float_Pi;
-                if (levelRealPost < 0 && levelImagPost < 0) angPost = -angPost - juce::float_Pi;
-
-                float phaseDiffPre = angPre - angPost;
-                int numOfCompleteCycles = (int) (phaseDiffPre / juce::float_Pi);
-                if (numOfCompleteCycles < -1 ) numOfCompleteCycles = -1;
-                float d = phaseDiffPre - (2 * juce::float_Pi * numOfCompleteCycles);
-                phaseDiffPre = d;
-                if (d >  juce::float_Pi) d =  juce::float_Pi;
-                if (d < -juce::float_Pi) d = -juce::float_Pi;
-                phaseDiffPre = d / (2 * juce::float_Pi);
-                
-                peakHolder(i, phaseDiffPre, historyValues1);
-                linGain1.push_back(phaseDiffPre);
-                
-                // RIGHT CHANNEL
-                levelRealPre  = auxBufferPre.getSample(1, (2 * i));
-                levelImagPre  = auxBufferPre.getSample(1, (2 * i) + 1);
-                levelRealPost = auxBufferPost.getSample(1, (2 * i));
-                levelImagPost = auxBufferPost.getSample(1, (2 * i) + 1);
-                
-                magLinPre  = sqrt (std::pow(levelRealPre, 2)  + std::pow(levelImagPre, 2));
-                angPre = std::asin (levelImagPre / magLinPre);
-                if (levelRealPre < 0 && levelImagPre > 0) angPre = -angPre + juce::float_Pi;
-                if (levelRealPre < 0 && levelImagPre < 0) angPre = -angPre - juce::float_Pi;
-                
-                magLinPost = sqrt (std::pow(levelRealPost, 2) + std::pow(levelImagPost, 2));
-                angPost = std::asin (levelImagPost / magLinPost);
-                if (levelRealPost < 0 && levelImagPost > 0) angPost = -angPost + juce::float_Pi;
-                if (levelRealPost < 0 && levelImagPost < 0) angPost = -angPost - juce::float_Pi;
-                
-                phaseDiffPre = angPre - angPost;
-                numOfCompleteCycles = (int) (phaseDiffPre / juce::float_Pi);
-                if (numOfCompleteCycles < -1 ) numOfCompleteCycles = -1;
-                d = phaseDiffPre - (2 * juce::float_Pi * numOfCompleteCycles);
-                phaseDiffPre = d;
-                if (d >  juce::float_Pi) d =  juce::float_Pi;
-                if (d < -juce::float_Pi) d = -juce::float_Pi;
-                phaseDiffPre = d / (2 * juce::float_Pi);
-                
-                peakHolder(i, phaseDiffPre, historyValues2);
-                linGain2.push_back(phaseDiffPre);
-
-                break;
-            }
-            case 3: // MID/SIDE ANALYSIS
-            {
-                // MID
-                float levelRealL = auxBufferPre.getSample(0, (2 * i));
-                float levelImagL = auxBufferPre.getSample(0, (2 * i) + 1);
-                float levelRealR = auxBufferPre.getSample(1, (2 * i));
-                float levelImagR = auxBufferPre.getSample(1, (2 * i) + 1);
-                
-                float levelImag = levelImagL + levelImagR;
-                float levelReal = levelRealL + levelRealR;
-                float magLin = sqrt( std::pow((levelReal) / 2, 2)
-                                          + std::pow((levelImag) / 2, 2));
-                float angPre = std::asin (levelImag / magLin);
-                if (levelReal < 0 && levelImag > 0) angPre = -angPre + juce::float_Pi;
-                if (levelReal < 0 && levelImag < 0) angPre = -angPre - juce::float_Pi;
-
-                
-                levelRealL = auxBufferPost.getSample(0, (2 * i));
-                levelImagL = auxBufferPost.getSample(0, (2 * i) + 1);
-                levelRealR = auxBufferPost.getSample(1, (2 * i));
-                levelImagR = auxBufferPost.getSample(1, (2 * i) + 1);
-                
-                levelImag = levelImagL + levelImagR;
-                levelReal = levelRealL + levelRealR;
-                magLin= sqrt( std::pow((levelReal) / 2, 2)
-                                       + std::pow((levelImag) / 2, 2));
-                float angPost = std::asin (levelImag / magLin);
-                if (levelReal < 0 && levelImag > 0) angPre = -angPost + juce::float_Pi;
-                if (levelReal < 0 && levelImag < 0) angPre = -angPost - juce::float_Pi;
-
-                float phaseDiff = angPre - angPost;
-                float numOfCompleteCycles = (int) (phaseDiff / juce::float_Pi);
-                if (numOfCompleteCycles < -1 ) numOfCompleteCycles = -1;
-                float d = phaseDiff - (2 * juce::float_Pi * numOfCompleteCycles);
-                phaseDiff = d;
-                if (d >  juce::float_Pi) d =  juce::float_Pi;
-                if (d < -juce::float_Pi) d = -juce::float_Pi;
-                phaseDiff= d / (2 * juce::float_Pi);
-                
-                peakHolder(i, phaseDiff, historyValues1);
-                linGain1.push_back(phaseDiff);
-                
-                // SIDE
-                levelRealL = auxBufferPre.getSample(0, (2 * i));
-                levelImagL = auxBufferPre.getSample(0, (2 * i) + 1);
-                levelRealR = auxBufferPre.getSample(1, (2 * i));
-                levelImagR = auxBufferPre.getSample(1, (2 * i) + 1);
-                
-                levelImag = levelImagL - levelImagR;
-                levelReal = levelRealL - levelRealR;
-                magLin = sqrt( std::pow((levelReal) / 2, 2)
-                                    + std::pow((levelImag) / 2, 2));
-                angPre = std::asin (levelImag / magLin);
-                if (levelReal < 0 && levelImag > 0) angPre = -angPre + juce::float_Pi;
-                if (levelReal < 0 && levelImag < 0) angPre = -angPre - juce::float_Pi;
-                
-                
-                levelRealL = auxBufferPost.getSample(0, (2 * i));
-                levelImagL = auxBufferPost.getSample(0, (2 * i) + 1);
-                levelRealR = auxBufferPost.getSample(1, (2 * i));
-                levelImagR = auxBufferPost.getSample(1, (2 * i) + 1);
-                
-                levelImag = levelImagL - levelImagR;
-                levelReal = levelRealL - levelRealR;
-                magLin= sqrt( std::pow((levelReal) / 2, 2)
-                             + std::pow((levelImag) / 2, 2));
-                angPost = std::asin (levelImag / magLin);
-                if (levelReal < 0 && levelImag > 0) angPre = -angPost + juce::float_Pi;
-                if (levelReal < 0 && levelImag < 0) angPre = -angPost - juce::float_Pi;
-                
-                phaseDiff = angPre - angPost;
-                numOfCompleteCycles = (int) (phaseDiff / juce::float_Pi);
-                if (numOfCompleteCycles < -1 ) numOfCompleteCycles = -1;
-                d = phaseDiff - (2 * juce::float_Pi * numOfCompleteCycles);
-                phaseDiff = d;
-                if (d >  juce::float_Pi) d =  juce::float_Pi;
-                if (d < -juce::float_Pi) d = -juce::float_Pi;
-                phaseDiff= d / (2 * juce::float_Pi);
-                
-                peakHolder(i, phaseDiff, historyValues2);
-                linGain2.push_back(phaseDiff);
-                
-                break;
-            }
-        }
+        // pre - post as before, in [-pi, pi] and normalised to one cycle
+        float phaseDiff = -transfer.getPhase (i) / (2 * juce::float_Pi);
+        phaseDiffs.push_back(phaseDiff);
     }
 }
 
-void PhaseDifference::peakHolder(int index, float& magLin, floatMatrix &historySamples)
+void PhaseDifference::resized()
 {
-    if (numOfHistorySamples != numOfHistorySamplesAt.load())
-    {
-        historyValues1.clear();
-        historyValues2.clear();
-        numOfHistorySamples = numOfHistorySamplesAt.load();
-        int fftSize = fftSizeAt.load();
-        for (auto i = 0; i < fftSize; i++)
-        {
-            historyValues1.push_back (std::vector<float> (numOfHistorySamples, 0));
-            historyValues2.push_back (std::vector<float> (numOfHistorySamples, 0));
-        }
-    }
-    
-    for (auto i = 0 ; i < numOfHistorySamples; ++i)
-    {
-        if (i == numOfHistorySamples - 1)
-            historySamples[index][i] = magLin;
-        else
-            historySamples[index][i] = historySamples[index][i + 1];
-    }
-    
-    float averageValue = 0;
-    for (auto i = 0; i < numOfHistorySamples; ++i)
-        averageValue = historySamples[index][i] + averageValue;
-    averageValue = averageValue / numOfHistorySamples;
-    
-    magLin = averageValue;
+    mainFrame = Image (Image::PixelFormat::RGB, getWidth(), getHeight(), true);
+    widthAt.store (getWidth());
+    heightAt.store (getHeight());
 }
 
-void PhaseDifference::resized() {}
-
 void PhaseDifference::createNewAxis()
 {
     axisImage = Image(Image::PixelFormat::RGB, getWidth(), getHeight(), true);
@@ -1355,6 +1235,270 @@ void PhaseDifference::createNewAxis()
 }
 
 
+//==============================================================================
+// COHERENCE ANALYSER
+CoherenceAnalyser::CoherenceAnalyser (int sR, int fS, AudioBufferManagement& buffManag, STFTAnalyser& stft)
+:
+    fftSizeAt(fS),
+    sampleRateAt(sR),
+    numOfHistorySamplesAt(8),
+    bandScaleAt(frequencyBandTable::erbBands),
+    mainAudioBufferSystem(buffManag),
+    stftAnalyser(stft),
+    widthAt(0),
+    heightAt(0)
+{
+    setTopLeftPosition(9,668); // shares its place with the phase difference
+    setSize (710, 116);
+    setPaintingIsUnclipped(true);
+    setOpaque(true);
+    
+    createNewAxis();
+}
+
+CoherenceAnalyser::~CoherenceAnalyser()
+{
+}
+
+void CoherenceAnalyser::paint (Graphics& g)
+{
+    {
+        const ScopedFrameAllocationCheck allocationCheck (maxNumOfPaintAllocations);
+        createFrame();
+    }
+    g.drawImage (mainFrame, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
+}
+
+void CoherenceAnalyser::createFrame()
+{
+    mainFrame.clear (mainFrame.getBounds());
+    Graphics g (mainFrame);
+    
+    g.setColour (Colour (0xff0f0f1c));
+    g.fillRoundedRectangle(0, 0, getWidth(), getHeight(), 8.0f);
+    
+    const renderDataType& data = renderData.getReadBuffer();
+    
+    g.setColour (Colour (0xff42a2c8).withAlpha (0.35f));
+    g.fillPath  (data.coherencePath);
+    
+    g.setColour  (Colours::lightgrey.withMultipliedBrightness (1 / 1.5f));
+    g.strokePath (data.drawPathPre,  PathStrokeType (1.3, PathStrokeType::beveled));
+    g.setColour  (Colours::whitesmoke);
+    g.strokePath (data.drawPathPost, PathStrokeType (1.3, PathStrokeType::beveled));
+    
+    g.drawImage (shadeWindow, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
+    g.drawImage (axisImage, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
+}
+
+void CoherenceAnalyser::prepareFrame()
+{
+    // follows the STFT size, the band table below is rebuilt when it changed
+    const auto scale = (frequencyBandTable::bandScaleType) bandScaleAt.load();
+    const int fftSize    = stftAnalyser.getFFTSize();
+    fftSizeAt.store (fftSize);
+    const int sampleRate = sampleRateAt.load();
+    const int width      = widthAt.load();
+    const bool hasSameBands = bandTable.matches (scale, fftSize, sampleRate);
+    
+    if (! hasSameBands || width != bandPositionsWidth)
+        updateBands (scale, fftSize, sampleRate, width);
+    
+    // the buffer written next only, the message thread may be drawing the others;
+    // they grow when they come up for writing
+    const int numOfBands = bandTable.getNumOfBands();
+    renderDataType& data = renderData.getWriteBuffer();
+    if (data.preallocatedBands != numOfBands)
+    {
+        data.drawPathPre   .preallocateSpace (3 * (numOfBands + 4));
+        data.drawPathPost  .preallocateSpace (3 * (numOfBands + 4));
+        data.coherencePath .preallocateSpace (3 * (numOfBands + 6));
+        data.preallocatedBands = numOfBands;
+    }
+}
+
+void CoherenceAnalyser::updateBands (frequencyBandTable::bandScaleType scale, int fftSize, int sampleRate, int width)
+{
+    if (! bandTable.matches (scale, fftSize, sampleRate))
+    {
+        bandTable.build (scale, fftSize, sampleRate);
+        const size_t numOfBands = (size_t) bandTable.getNumOfBands();
+        
+        for (bandSpectraType* spectra : { &spectraPre, &spectraPost })
+        {
+            spectra->crossRe .assign (numOfBands, 0.0f);
+            spectra->crossIm .assign (numOfBands, 0.0f);
+            spectra->powerL  .assign (numOfBands, 0.0f);
+            spectra->powerR  .assign (numOfBands, 0.0f);
+        }
+        lastFrameIndex = -1;
+    }
+    
+    // same log axis as the phase difference: 10 Hz .. fs / 2
+    const size_t numOfBands = (size_t) bandTable.getNumOfBands();
+    bandPositions.resize (numOfBands);
+    for (size_t band = 0; band < numOfBands; ++band)
+        bandPositions[band] = (width / std::log ((sampleRate / 2.0f) / 10.0f))
+                               * std::log (bandTable.centreFrequency[band] / 10.0f);
+    bandPositionsWidth = width;
+}
+
+void CoherenceAnalyser::processData()
+{
+    STFTAnalyser::spectrumFramePtr frame = stftAnalyser.getLatestFrame();
+    if (frame == nullptr || frame->fftSize != bandTable.fftSize || frame->frameIndex == lastFrameIndex)
+        return;
+    lastFrameIndex = frame->frameIndex;
+    
+    // every frame weighs 1 / numOfHistorySamples, the older ones fade out geometrically
+    const float ratio = 1.0f - 1.0f / jmax (1, numOfHistorySamplesAt.load());
+    averageBands (frame->getBinsPre  (spectrumFrameType::left), frame->getBinsPre  (spectrumFrameType::right), ratio, spectraPre);
+    averageBands (frame->getBinsPost (spectrumFrameType::left), frame->getBinsPost (spectrumFrameType::right), ratio, spectraPost);
+    
+    createPaths (renderData.getWriteBuffer());
+    renderData.publish();
+}
+
+void CoherenceAnalyser::averageBands (const float* binsL, const float* binsR, float ratio, bandSpectraType& spectra)
+{
+    for (int band = 0; band < bandTable.getNumOfBands(); ++band)
+    {
+        const int firstBin = bandTable.firstBin[band];
+        const int lastBin  = firstBin + bandTable.numOfBins[band];
+        float crossRe = 0, crossIm = 0, powerL = 0, powerR = 0;
+        
+        // L * conj (R) and the powers, summed over the band before they are averaged
+        for (int bin = firstBin; bin < lastBin; ++bin)
+        {
+            const float reL = binsL[2 * bin], imL = binsL[2 * bin + 1];
+            const float reR = binsR[2 * bin], imR = binsR[2 * bin + 1];
+            crossRe += reL * reR + imL * imR;
+            crossIm += imL * reR - reL * imR;
+            powerL  += reL * reL + imL * imL;
+            powerR  += reR * reR + imR * imR;
+        }
+        
+        spectra.crossRe[band] = ratio * spectra.crossRe[band] + (1.0f - ratio) * crossRe;
+        spectra.crossIm[band] = ratio * spectra.crossIm[band] + (1.0f - ratio) * crossIm;
+        spectra.powerL[band]  = ratio * spectra.powerL[band]  + (1.0f - ratio) * powerL;
+        spectra.powerR[band]  = ratio * spectra.powerR[band]  + (1.0f - ratio) * powerR;
+    }
+}
+
+void CoherenceAnalyser::createPaths (renderDataType& data)
+{
+    data.drawPathPre   .clear();
+    data.drawPathPost  .clear();
+    data.coherencePath .clear();
+    
+    const int numOfBands = bandTable.getNumOfBands();
+    if (numOfBands == 0)
+        return;
+    
+    const float centre = heightAt.load() / 2.0f;
+    const float range  = centre - 6.0f;
+    
+    // sqrt (powerL * powerR) underflows for quiet bands, each power is divided out on its own
+    auto hasEnergy = [] (const bandSpectraType& spectra, int band)
+    {
+        return spectra.powerL[band] > 1.0e-20f && spectra.powerR[band] > 1.0e-20f;
+    };
+    
+    auto getCorrelation = [&hasEnergy] (const bandSpectraType& spectra, int band)
+    {
+        return hasEnergy (spectra, band)
+               ? jlimit (-1.0f, 1.0f, spectra.crossRe[band] / std::sqrt (spectra.powerL[band]) / std::sqrt (spectra.powerR[band]))
+               : 0.0f;
+    };
+    
+    data.coherencePath.startNewSubPath (bandPositions[0], centre);
+    for (int band = 0; band < numOfBands; ++band)
+    {
+        const float x = bandPositions[band];
+        const float coherence = hasEnergy (spectraPost, band)
+                                ? jmin (1.0f, std::hypot (spectraPost.crossRe[band], spectraPost.crossIm[band])
+                                              / std::sqrt (spectraPost.powerL[band]) / std::sqrt (spectraPost.powerR[band]))
+                                : 0.0f;
+        
+        const Point<float> pre  (x, centre - getCorrelation (spectraPre,  band) * range);
+        const Point<float> post (x, centre - getCorrelation (spectraPost, band) * range);
+        if (band == 0)
+        {
+            data.drawPathPre  .startNewSubPath (pre);
+            data.drawPathPost .startNewSubPath (post);
+        }
+        else
+        {
+            data.drawPathPre  .lineTo (pre);
+            data.drawPathPost .lineTo (post);
+        }
+        data.coherencePath.lineTo (x, centre - coherence * range);
+    }
+    data.coherencePath.lineTo (bandPositions[numOfBands - 1], centre);
+    data.coherencePath.closeSubPath();
+}
+
+void CoherenceAnalyser::resized()
+{
+    mainFrame = Image (Image::PixelFormat::RGB, getWidth(), getHeight(), true);
+    widthAt.store (getWidth());
+    heightAt.store (getHeight());
+}
+
+void CoherenceAnalyser::createNewAxis()
+{
+    axisImage = Image(Image::PixelFormat::RGB, getWidth(), getHeight(), true);
+    Graphics g (axisImage);
+    
+    const int height = getHeight();
+    const int width  = getWidth();
+    const float sampleRate = sampleRateAt.load();
+    
+    const int decades[] = { 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000 };
+    for (auto fo : decades)
+    {
+        const int freq2draw = (width / std::log((sampleRate / 2) / 10))*std::log(fo / 10);
+        g.setColour(Colours::lightgrey);
+        g.setOpacity(0.3);
+        g.drawVerticalLine(freq2draw, 0, height);
+    }
+    
+    for (int i = 0; i <= 4; i++)
+    {
+        const float y = 6 + (height - 12) * (i / 4.0f);
+        g.setColour(Colours::lightgrey);
+        g.setOpacity(i == 2 ? 0.6f : 0.3f);
+        g.drawHorizontalLine(y, 30, (float)width - 10);
+        
+        if (i == 1 || i == 3)
+            continue;
+        
+        const String fo = i == 0 ? "+1" : (i == 2 ? "0" : "-1");
+        g.setColour(i == 0 ? Colours::palegreen : (i == 2 ? Colours::white : Colours::palevioletred));
+        g.setOpacity(1.0f);
+        g.setFont(11.f);
+        g.drawText(fo, 10, y - 10, 50, 20, juce::Justification::left, true);
+    }
+    
+    shadeWindow = Image(Image::PixelFormat::RGB, getWidth(), getHeight(), true);
+    Graphics g2 (shadeWindow);
+    for (int i = 0; i < 20; i++)
+    {
+        float opacity = (float(i) + 30) / 50;
+        g2.setColour(Colours::black.withAlpha(isPositiveAndBelow(1 - opacity, 1) ? 1 - opacity : 0.f));
+        g2.drawVerticalLine   (width - i, 0, height);
+        g2.drawHorizontalLine (i, 0, width);
+        g2.drawHorizontalLine (height - i, 0, width);
+    }
+    for (int i = 0; i < 50; i++)
+    {
+        float opacity = (float(i) + 20) / 50.f;
+        g2.setColour(Colours::black.withAlpha(isPositiveAndBelow(1 - opacity, 1) ? 1 - opacity : 0.f));
+        g2.drawVerticalLine(i, 0, height);
+    }
+}
+
+
 //==============================================================================
 // STEREO ANALYSER
 StereoAnalyser::StereoAnalyser(int sR, int bS, AudioBufferManagement& buffManag, forwardFFT& fFFT)
@@ -1363,8 +1507,12 @@ blockSizeAt(bS),
 sampleRateAt(sR),
 numOfHistorySamplesAt(20),
 zoomAt(200),
+persistenceModeAt(true),
+bandCorrelationAt(false),
 mainAudioBufferSystem(buffManag),
-forwFFT(fFFT)
+forwFFT(fFFT),
+widthAt(0),
+heightAt(0)
 {
     setTopLeftPosition(729, 89); //7, 263
     setSize (346, 346); // 714,281
@@ -1372,10 +1520,9 @@ forwFFT(fFFT)
     setPaintingIsUnclipped(true);
     setOpaque(true);
 
-    energyPre  = {0, 0};
-    energyPost = {0, 0};
-    meanValuePre  = 0;
-    meanValuePost = 0;
+    setOfCorrelationHistData = {0, 0, 0};
+    for (auto& bandData : bandCorrelationData)
+        bandData = {0, 0, 0};
     corrRMSWindowLength = sR * 0.8f;
     
     createNewAxis();
@@ -1388,209 +1535,372 @@ StereoAnalyser::~StereoAnalyser()
 
 void StereoAnalyser::paint (Graphics& g)
 {
-    createFrame();
+    {
+        const ScopedFrameAllocationCheck allocationCheck (maxNumOfPaintAllocations);
+        createFrame();
+    }
     g.drawImage (mainFrame, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
 }
 
 void StereoAnalyser::createFrame()
 {
-    processAllFftData ();
-    createCurbes();
+    const renderDataType& data = renderData.getReadBuffer();
 
-    mainFrame = Image(Image::PixelFormat::RGB, getWidth(), getHeight(), true);
+    mainFrame.clear (mainFrame.getBounds());
     Graphics g (mainFrame);
     
     g.drawImage (axisImage, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
-    g.drawImage (lissajouCurbe, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
+    g.drawImage (data.lissajouCurbe, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
     g.drawImage (shadeWindow, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
     g.drawImage (correlationBackground, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
-    g.drawImage (correlationLines, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
+    g.drawImage (data.correlationLines, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
 }
 
-void StereoAnalyser::createCurbes ()
+void StereoAnalyser::prepareFrame()
 {
-    int sizeOfQueue = setOfPointsHistDataPre.size();
-    int blockSize = blockSizeAt.load();
-    float zoom = zoomAt.load();
+    const int blockSize = blockSizeAt.load();
+    const int numOfChannels = mainAudioBufferSystem.bufferPre.historyBuffer.getNumChannels();
     
-    lissajouCurbe = Image(Image::PixelFormat::RGB, getWidth(), getHeight(), true);
-    Image::BitmapData bitMap (lissajouCurbe, Image::BitmapData::readWrite);
-
-    Colour colPre  = Colours::lightgrey;
-    int count = 0;
-    for (auto index = sizeOfQueue - 1 ; index >= 0; --index)
+    // persistence keeps its trail in the density buffers, only the newest block of points is needed
+    const bool isPersistent = persistenceModeAt.load();
+    const int numOfHistorySamples = isPersistent ? 1 : numOfHistorySamplesAt.load();
+    
+    if (audioBlockPre.getNumSamples() != blockSize || audioBlockPre.getNumChannels() != numOfChannels)
     {
-        int opacity = (float(count) / (float(sizeOfQueue) + index)) * 255;
-        if (sizeOfQueue == 1) opacity = 1.0f;
-        for (auto i = 0; i < blockSize; ++i)
+        audioBlockPre  .setSize (numOfChannels, blockSize);
+        audioBlockPost .setSize (numOfChannels, blockSize);
+    }
+    
+    if (numOfHistorySlots < numOfHistorySamples || historyBlockSize != blockSize)
+    {
+        numOfHistorySlots  = jmax (numOfHistorySlots, numOfHistorySamples);
+        historyBlockSize   = blockSize;
+        newestHistoryIndex = 0;
+        numOfValidHistory  = 0;
+        
+        for (pointHistoryType* points : { &pointsPre, &pointsPost })
         {
-            int X = (getWidth() / 2) - (setOfPointsHistDataPre[index][i].first  * zoom);
-            int Y = (getWidth() / 2) - (setOfPointsHistDataPre[index][i].second * zoom);
-            if ( isPositiveAndBelow (X, getWidth()) && isPositiveAndBelow(Y, getHeight()))
-                bitMap.setPixelColour(X, Y, colPre.withAlpha(juce::uint8(opacity/1.5f)));
+            points->x.assign ((size_t) (numOfHistorySlots * blockSize), 0.0f);
+            points->y.assign ((size_t) (numOfHistorySlots * blockSize), 0.0f);
+        }
+    }
+    
+    frameWidth  = widthAt.load();
+    frameHeight = heightAt.load();
+    
+    if (! densityPre.matches (frameWidth, frameHeight))
+    {
+        densityPre  .setSize (frameWidth, frameHeight);
+        densityPost .setSize (frameWidth, frameHeight);
+    }
+    
+    // drawn on this thread, so plain software bitmaps that can be reused. Only the buffer written
+    // next is resized, the message thread may be drawing the others; they follow in their turn
+    renderDataType& data = renderData.getWriteBuffer();
+    if (frameWidth > 0 && frameHeight > 0
+        && (data.lissajouCurbe.getWidth() != frameWidth || data.lissajouCurbe.getHeight() != frameHeight))
+    {
+        data.lissajouCurbe    = Image (Image::PixelFormat::RGB, frameWidth, frameHeight, true, SoftwareImageType());
+        data.correlationLines = Image (Image::PixelFormat::RGB, frameWidth, frameHeight, true, SoftwareImageType());
+    }
+    
+    if (persistenceMode != isPersistent)
+    {
+        persistenceMode   = isPersistent;
+        numOfValidHistory = 0;
+        densityPre  .clear();
+        densityPost .clear();
+    }
+    
+    // the correlation window stays 0.8 s long, rounded to whole blocks of sums
+    const int sampleRate = sampleRateAt.load();
+    const bool withBands = bandCorrelationAt.load();
+    
+    if (correlationSampleRate != sampleRate && sampleRate > 0)
+    {
+        correlationSampleRate = sampleRate;
+        corrRMSWindowLength   = roundToInt (sampleRate * 0.8f);
+        const int numOfSumBlocks = jmax (1, roundToInt (corrRMSWindowLength / (float) correlationSumBlockSize));
+        
+        for (correlationTapType* tap : { &correlationPre, &correlationPost })
+        {
+            tap->broadband.setSize (numOfSumBlocks, correlationSumBlockSize);
+            for (auto& band : tap->bands)
+                band.setSize (numOfSumBlocks, correlationSumBlockSize);
+            
+            for (int channel = 0; channel < 2; ++channel)
+            {
+                tap->lowPass[channel]     .setCoefficients (IIRCoefficients::makeLowPass  (sampleRate, 250.0));
+                tap->midHighPass[channel] .setCoefficients (IIRCoefficients::makeHighPass (sampleRate, 250.0));
+                tap->midLowPass[channel]  .setCoefficients (IIRCoefficients::makeLowPass  (sampleRate, 2500.0));
+                tap->highPass[channel]    .setCoefficients (IIRCoefficients::makeHighPass (sampleRate, 2500.0));
+            }
         }
-        count++;
+        lastCorrelationSample = mainAudioBufferSystem.bufferPost.numOfWrittenSamples.load();
     }
     
-    Colour colPost = Colours::whitesmoke;
-    count = 0;
-    for (auto index = sizeOfQueue - 1 ; index >= 0; --index)
+    if (correlationBands != withBands)
     {
-        int opacity = (float(count) / (float(sizeOfQueue) + index)) * 255;
-        if (sizeOfQueue == 1) opacity = 1.0f;
-        for (auto i = 0; i < blockSize; ++i)
+        correlationBands = withBands;
+        for (correlationTapType* tap : { &correlationPre, &correlationPost })
         {
-            int X = (getWidth() / 2) - (setOfPointsHistDataPost[index][i].first  * zoom);
-            int Y = (getWidth() / 2) - (setOfPointsHistDataPost[index][i].second * zoom);
-            if ( isPositiveAndBelow (X, getWidth()) && isPositiveAndBelow(Y, getHeight()))
-                bitMap.setPixelColour(X, Y, colPost.withAlpha(juce::uint8(opacity)));
+            for (auto& band : tap->bands)
+                band.reset();
+            for (int channel = 0; channel < 2; ++channel)
+            {
+                tap->lowPass[channel]     .reset();
+                tap->midHighPass[channel] .reset();
+                tap->midLowPass[channel]  .reset();
+                tap->highPass[channel]    .reset();
+            }
         }
-        count++;
+        for (auto& bandData : bandCorrelationData)
+            bandData = {0, 0, 0};
     }
     
-    correlationLines = Image(Image::PixelFormat::RGB, getWidth(), getHeight(), true);
-    Image::BitmapData bitMap2 (correlationLines, Image::BitmapData::readWrite);
-    Colour colCorr;
+    if (bandBlock.getNumSamples() != blockSize)
+        bandBlock.setSize (2, blockSize);
+}
+
+void StereoAnalyser::processData()
+{
+    processAllFftData ();
+    createCurbes (renderData.getWriteBuffer());
+    renderData.publish();
+}
 
-    float corrPre = setOfCorrelationHistData.corrPre * ((getWidth() - 54) / 2);
-    if (corrPre >= 0) colCorr = Colours::palegreen; else colCorr = Colours::palevioletred;
-    Colour colCorrPre = colCorr;
+void StereoAnalyser::createCurbes (renderDataType& data)
+{
+    const float zoom = zoomAt.load();
     
-    float corrPost = setOfCorrelationHistData.corrPost * ((getWidth() - 54) / 2);
-    if (corrPost >= 0) colCorr = Colours::palegreen; else colCorr = Colours::palevioletred;
-    Colour colCorrPost = colCorr;
+    if (persistenceMode)
+    {
+        // the trail decays to e^-3 over the vanish time, whatever its length the frame costs one block of points;
+        // after a zoom change the old trail would sit at the wrong scale
+        if (zoom != persistenceZoom)
+        {
+            persistenceZoom = zoom;
+            densityPre  .clear();
+            densityPost .clear();
+        }
+        
+        const float decay = std::exp (-3.0f / jmax (1, numOfHistorySamplesAt.load()));
+        const size_t offset = (size_t) (newestHistoryIndex * historyBlockSize);
+        densityPre  .decay (decay);
+        densityPost .decay (decay);
+        densityPre  .splat (pointsPre.x.data()  + offset, pointsPre.y.data()  + offset, historyBlockSize, zoom, 1.0f);
+        densityPost .splat (pointsPost.x.data() + offset, pointsPost.y.data() + offset, historyBlockSize, zoom, 1.0f);
+    }
+    else
+    {
+        // the older a block, the less it weighs: the trail fades out over the vanish time
+        const float fadeBlocks = jmax (1.0f, numOfValidHistory / 3.0f);
+        
+        densityPre  .clear();
+        densityPost .clear();
+        for (auto age = 0; age < numOfValidHistory; ++age)
+        {
+            const int slot = (newestHistoryIndex + age) % numOfHistorySlots;
+            const size_t offset = (size_t) (slot * historyBlockSize);
+            const float weight = std::exp (-age / fadeBlocks);
+            
+            densityPre  .splat (pointsPre.x.data()  + offset, pointsPre.y.data()  + offset, historyBlockSize, zoom, weight);
+            densityPost .splat (pointsPost.x.data() + offset, pointsPost.y.data() + offset, historyBlockSize, zoom, weight);
+        }
+    }
+    
+    if (densityPre.matches (data.lissajouCurbe.getWidth(), data.lissajouCurbe.getHeight()))
+    {
+        Image::BitmapData bitMap (data.lissajouCurbe, Image::BitmapData::writeOnly);
+        pointDensityBuffer::toneMap (densityPre,  Colours::lightgrey.withMultipliedBrightness (1 / 1.5f),
+                                     densityPost, Colours::whitesmoke, 4.0f, bitMap);
+    }
     
-    float corrRest = setOfCorrelationHistData.corrRest * ((getWidth() - 54) / 4);
-    if (corrRest >= 0) colCorr = Colours::palegreen; else colCorr = Colours::palevioletred;
-    Colour colCorrRest = colCorr;
+    if (! data.correlationLines.isValid())
+        return;
     
-    int rectAnchor = getHeight() - (15 + getHeight() * .22f);
-    int rectHeight = ((getHeight() * 0.22f) / 3) - 7;
-    for (auto y = 0; y < rectHeight; ++y)
+    data.correlationLines.clear (data.correlationLines.getBounds());
+    Image::BitmapData bitMap2 (data.correlationLines, Image::BitmapData::readWrite);
+    
+    // a three pixel wide marker, green for positive and red for negative correlation
+    const float centre = frameHeight / 2.0f;
+    auto drawMarker = [&bitMap2, centre] (float correlation, float range, int top, int numOfRows, bool brightEdges)
     {
-        if ( abs(corrPre) < getHeight()/2.0f )
-            bitMap2.setPixelColour ( (getHeight()/2.0f) - corrPre,      rectAnchor + y + 7, colCorrPre.brighter());
-        bitMap2.setPixelColour ( (getHeight()/2.0f) - corrPre - 1,  rectAnchor + y + 7, colCorrPre);
-        bitMap2.setPixelColour ( (getHeight()/2.0f) - corrPre + 1,  rectAnchor + y + 7, colCorrPre);
+        const float position = correlation * range;
+        const Colour colCorr = correlation >= 0 ? Colours::palegreen : Colours::palevioletred;
+        const Colour colEdge = brightEdges ? colCorr.brighter() : colCorr;
         
-        if ( abs(corrPost) < getHeight()/2.0f )
-            bitMap2.setPixelColour ( (getHeight()/2.0f) - corrPost, rectAnchor + rectHeight   + y + 14, colCorrPost.brighter());
-        bitMap2.setPixelColour ( (getHeight()/2.0f) - corrPost - 1, rectAnchor + rectHeight   + y + 14, colCorrPost.brighter());
-        bitMap2.setPixelColour ( (getHeight()/2.0f) - corrPost + 1, rectAnchor + rectHeight   + y + 14, colCorrPost.brighter());
+        for (auto y = top; y < top + numOfRows; ++y)
+        {
+            if ( abs(position) < centre - 1 )
+                bitMap2.setPixelColour ( centre - position, y, colCorr.brighter());
+            bitMap2.setPixelColour ( centre - position - 1, y, colEdge);
+            bitMap2.setPixelColour ( centre - position + 1, y, colEdge);
+        }
+    };
+    
+    const float range = (frameWidth - 54) / 2;
+    int rectAnchor = frameHeight - (15 + frameHeight * .22f);
+    int rectHeight = ((frameHeight * 0.22f) / 3) - 7;
+    
+    // pre, post and their difference (at twice the resolution), each band in its own third of the bar
+    auto drawBar = [&] (int bar, float correlation, float barRange)
+    {
+        const int top = rectAnchor + bar * (rectHeight + 7) + 7;
+        const bool brightEdges = bar > 0;
         
+        if (! correlationBands)
+        {
+            drawMarker (correlation, barRange, top, rectHeight, brightEdges);
+            return;
+        }
         
-        if ( abs(corrRest) < (getHeight()/2.0f) - 1 )
-            bitMap2.setPixelColour ( (getHeight()/2.0f) - corrRest, rectAnchor + 2*rectHeight + y + 21, colCorrRest.brighter());
-        bitMap2.setPixelColour ( (getHeight()/2.0f) - corrRest - 1, rectAnchor + 2*rectHeight + y + 21, colCorrRest.brighter());
-        bitMap2.setPixelColour ( (getHeight()/2.0f) - corrRest + 1, rectAnchor + 2*rectHeight + y + 21, colCorrRest.brighter());
-    }
+        for (int band = 0; band < numOfCorrelationBands; ++band)
+        {
+            const int bandTop = top + band * rectHeight / numOfCorrelationBands;
+            const int bandBottom = top + (band + 1) * rectHeight / numOfCorrelationBands;
+            const setOfCorrPoints& points = bandCorrelationData[band];
+            const float bandCorrelation = bar == 0 ? points.corrPre : (bar == 1 ? points.corrPost : points.corrRest);
+            drawMarker (bandCorrelation, barRange, bandTop, bandBottom - bandTop, brightEdges);
+        }
+    };
+    
+    drawBar (0, setOfCorrelationHistData.corrPre,  range);
+    drawBar (1, setOfCorrelationHistData.corrPost, range);
+    drawBar (2, setOfCorrelationHistData.corrRest, range / 2);
+}
 }
 
 void StereoAnalyser::processAllFftData ()
 {
     const int blockSize = blockSizeAt.load();
-    const int numOfHistorySamples = numOfHistorySamplesAt.load();
+    const int numOfHistorySamples = jmin (numOfHistorySamplesAt.load(), numOfHistorySlots);
     const int numOfChannels = mainAudioBufferSystem.bufferPre.historyBuffer.getNumChannels();
     
-    std::vector<pairOfXYpoints> setOfXYpointsPre;
-    std::vector<pairOfXYpoints> setOfXYpointsPost;
+    // the oldest block of points is overwritten by the newest one
+    newestHistoryIndex = (newestHistoryIndex + numOfHistorySlots - 1) % numOfHistorySlots;
+    numOfValidHistory  = jmin (numOfValidHistory + 1, numOfHistorySamples);
     
-    AudioBuffer<float> audioBlockPre (numOfChannels, blockSize);
+    jassert (audioBlockPre.getNumSamples() >= blockSize && audioBlockPre.getNumChannels() == numOfChannels);
     audioBlockPre.clear();
     mainAudioBufferSystem.bufferPre.copySamplesFromHistoryBuffer(audioBlockPre, blockSize);
     
-    AudioBuffer<float> audioBlockPost (numOfChannels, blockSize);
     audioBlockPost.clear();
     mainAudioBufferSystem.bufferPost.copySamplesFromHistoryBuffer(audioBlockPost, blockSize);
-
-
-    for (auto i = 0; i < blockSize; ++i)
+    
+    // x = cos(pi/4) * (L - R), y = sin(pi/4) * (L + R); a mono signal sits on the diagonal x = y = 2 * cos(pi/4) * L
+    auto blockToPoints = [blockSize] (const AudioBuffer<float>& block, float* x, float* y)
     {
-        // PRE
-        float xL =   std::cos(juce::float_Pi / 4) * audioBlockPre.getSample(0, i);
-        float yL =   std::sin(juce::float_Pi / 4) * audioBlockPre.getSample(0, i);
-        float xR, yR;
-        if (audioBlockPre.getNumChannels() > 1) // stereo
-        {
-            xR = - std::cos(juce::float_Pi / 4) * audioBlockPre.getSample(1, i);
-            yR =   std::sin(juce::float_Pi / 4) * audioBlockPre.getSample(1, i);
-            setOfXYpointsPre.push_back(pairOfXYpoints(xL + xR, yL + yR));
-            meanValuePre = ((audioBlockPre.getSample(0, i) * audioBlockPre.getSample(1, i)))
-                                + meanValuePre
-                                - (meanValuePre / float(corrRMSWindowLength));
-            energyPre.first  = std::pow(audioBlockPre.getSample(0, i), 2)
-                                + energyPre.first
-                                - ( energyPre.first / float(corrRMSWindowLength) );
-            energyPre.second = std::pow(audioBlockPre.getSample(1, i), 2)
-                                + energyPre.second
-                                - ( energyPre.second / float(corrRMSWindowLength) );
-        }
-        else // mono
-        {
-            setOfXYpointsPre.push_back(pairOfXYpoints( 2 * xL, 2 * yL));
-            meanValuePre = std::pow(audioBlockPre.getSample(0, i) , 2)
-                                    + meanValuePre
-                                    - (meanValuePre / float(corrRMSWindowLength));
-            energyPre.first  = std::pow(audioBlockPre.getSample(0, i), 2)
-                                + energyPre.first
-                                - ( energyPre.first / float(corrRMSWindowLength) );
-            energyPre.second = std::pow(audioBlockPre.getSample(0, i), 2)
-                                + energyPre.second
-                                - ( energyPre.second / float(corrRMSWindowLength) );
-        }
+        const float* left = block.getReadPointer (0);
+        const float diagonal = std::cos (juce::float_Pi / 4);
         
-        // POST
-        xL =   std::cos(juce::float_Pi / 4) * audioBlockPost.getSample(0, i);
-        yL =   std::sin(juce::float_Pi / 4) * audioBlockPost.getSample(0, i);
-        if (audioBlockPost.getNumChannels() > 1) // stereo
+        if (block.getNumChannels() > 1)
         {
-            xR = - std::cos(juce::float_Pi / 4) * audioBlockPost.getSample(1, i);
-            yR =   std::sin(juce::float_Pi / 4) * audioBlockPost.getSample(1, i);
-            setOfXYpointsPost.push_back(pairOfXYpoints(xL + xR, yL + yR));
-            meanValuePost = ((audioBlockPost.getSample(0, i) * audioBlockPost.getSample(1, i)))
-                            + meanValuePost
-                            - (meanValuePost / float(corrRMSWindowLength));;
-            energyPost.first  = std::pow(audioBlockPost.getSample(0, i), 2)
-                            + energyPost.first
-                            - ( energyPost.first / float(corrRMSWindowLength) );
-            energyPost.second = std::pow(audioBlockPost.getSample(1, i), 2)
-                            + energyPost.second
-                            - ( energyPost.second / float(corrRMSWindowLength) );
+            const float* right = block.getReadPointer (1);
+            FloatVectorOperations::subtract (x, left, right, blockSize);
+            FloatVectorOperations::add      (y, left, right, blockSize);
+            FloatVectorOperations::multiply (x, diagonal, blockSize);
+            FloatVectorOperations::multiply (y, diagonal, blockSize);
         }
-        else // mono
+        else
         {
-            setOfXYpointsPost.push_back(pairOfXYpoints( 2 * xL, 2 * yL));
-            meanValuePost = std::pow(audioBlockPost.getSample(0, i) , 2)
-                            + meanValuePost
-                            - ( meanValuePost / float(corrRMSWindowLength));
-            energyPost.first  = std::pow(audioBlockPost.getSample(0, i), 2)
-                                + energyPost.first
-                                - ( energyPost.first / float(corrRMSWindowLength) );
-            energyPost.second = std::pow(audioBlockPost.getSample(0, i), 2)
-                                + energyPost.second
-                                - ( energyPost.second / float(corrRMSWindowLength) );
+            FloatVectorOperations::copyWithMultiply (x, left, 2 * diagonal, blockSize);
+            FloatVectorOperations::copy (y, x, blockSize);
         }
+    };
+    
+    const size_t offset = (size_t) (newestHistoryIndex * historyBlockSize);
+    blockToPoints (audioBlockPre,  pointsPre.x.data()  + offset, pointsPre.y.data()  + offset);
+    blockToPoints (audioBlockPost, pointsPost.x.data() + offset, pointsPost.y.data() + offset);
+
+    updateCorrelation();
+}
+
+void StereoAnalyser::updateCorrelation()
+{
+    audioBufferManagementType& pre  = mainAudioBufferSystem.bufferPre;
+    audioBufferManagementType& post = mainAudioBufferSystem.bufferPost;
+    
+    // both histories receive the same blocks, the post one counts for both
+    const int64 numOfWrittenSamples = post.numOfWrittenSamples.load();
+    if (numOfWrittenSamples < lastCorrelationSample) // the history was reset
+        lastCorrelationSample = numOfWrittenSamples;
+    
+    // after a long pause only the newest part is read, the rest has been overwritten by then
+    const int maxNumOfNewSamples = post.historyBuffer.getNumSamples() / 2;
+    int numOfNewSamples = (int) jmin ((int64) maxNumOfNewSamples, numOfWrittenSamples - lastCorrelationSample);
+    lastCorrelationSample = numOfWrittenSamples;
+    
+    const float preDelay = pre.getAlignmentDelay();
+    const int chunkSize = audioBlockPre.getNumSamples();
+    
+    // every sample since the last frame, oldest chunk first; the point blocks are done, their buffers are reused
+    while (numOfNewSamples > 0 && chunkSize > 0)
+    {
+        const int numOfSamples = jmin (numOfNewSamples, chunkSize);
+        numOfNewSamples -= numOfSamples;
+        
+        pre  .copyDelayedSamplesFromHistoryBuffer (audioBlockPre,  numOfSamples, preDelay + numOfNewSamples);
+        post .copyDelayedSamplesFromHistoryBuffer (audioBlockPost, numOfSamples, (float) numOfNewSamples);
+        
+        addCorrelationSamples (correlationPre,  audioBlockPre,  numOfSamples, correlationBands);
+        addCorrelationSamples (correlationPost, audioBlockPost, numOfSamples, correlationBands);
     }
     
-    while (setOfPointsHistDataPre.size() >= numOfHistorySamples) setOfPointsHistDataPre.pop_back();
-    setOfPointsHistDataPre.push_front(setOfXYpointsPre);
-    while (setOfPointsHistDataPost.size() >= numOfHistorySamples) setOfPointsHistDataPost.pop_back();
-    setOfPointsHistDataPost.push_front(setOfXYpointsPost);
-     
-    float corrPre  = (meanValuePre  / float(corrRMSWindowLength)) / std::sqrt((energyPre.first / float(corrRMSWindowLength))  * (energyPre.second / float(corrRMSWindowLength)));
-    if (isnan(corrPre)  || isinf(corrPre))  corrPre = 0;
-    float corrPost = (meanValuePost / float(corrRMSWindowLength)) / std::sqrt((energyPost.first / float(corrRMSWindowLength)) * (energyPost.second / float(corrRMSWindowLength)));
-    if (isnan(corrPost) || isinf(corrPost)) corrPost = 0;
-    float corrRest = corrPost - corrPre;
-    if (corrPre < -2 || corrPost < -2 || corrRest < -2)
+    auto getCorrelationPoints = [] (const streamingCorrelationType& pre, const streamingCorrelationType& post)
+    {
+        const float corrPre  = pre.getCorrelation();
+        const float corrPost = post.getCorrelation();
+        return setOfCorrPoints { corrPre, corrPost, corrPost - corrPre };
+    };
+    
+    setOfCorrelationHistData = getCorrelationPoints (correlationPre.broadband, correlationPost.broadband);
+    if (correlationBands)
+        for (int band = 0; band < numOfCorrelationBands; ++band)
+            bandCorrelationData[band] = getCorrelationPoints (correlationPre.bands[band], correlationPost.bands[band]);
+}
+
+void StereoAnalyser::addCorrelationSamples (correlationTapType& tap, const AudioBuffer<float>& block, int numOfSamples, bool withBands)
+{
+    // a mono tap correlates with itself
+    const int numOfChannels = jmin (2, block.getNumChannels());
+    tap.broadband.addSamples (block.getReadPointer (0), block.getReadPointer (numOfChannels - 1), numOfSamples);
+    
+    if (! withBands)
+        return;
+    
+    // the scratch holds one band of both channels at a time, every band keeps its own filter state
+    for (int band = 0; band < numOfCorrelationBands; ++band)
     {
-        energyPost.first = 3;
+        for (int channel = 0; channel < numOfChannels; ++channel)
+        {
+            float* data = bandBlock.getWritePointer (channel);
+            FloatVectorOperations::copy (data, block.getReadPointer (channel), numOfSamples);
+            
+            if (band == 0)
+            {
+                tap.lowPass[channel].processSamples (data, numOfSamples);
+            }
+            else if (band == 1)
+            {
+                tap.midHighPass[channel] .processSamples (data, numOfSamples);
+                tap.midLowPass[channel]  .processSamples (data, numOfSamples);
+            }
+            else
+            {
+                tap.highPass[channel].processSamples (data, numOfSamples);
+            }
+        }
+        tap.bands[band].addSamples (bandBlock.getReadPointer (0), bandBlock.getReadPointer (numOfChannels - 1), numOfSamples);
     }
-    //if ( setOfCorrelationHistData.size() == numOfHistorySamples )
-    setOfCorrelationHistData = {corrPre, corrPost, corrRest};
 }
 
-void StereoAnalyser::resized() {}
+void StereoAnalyser::resized()
+{
+    mainFrame = Image (Image::PixelFormat::RGB, getWidth(), getHeight(), true);
+    widthAt.store (getWidth());
+    heightAt.store (getHeight());
+}
 
 void StereoAnalyser::createNewAxis()
 {
@@ -1662,7 +1972,9 @@ modeAt(3),
 rangeAt(1),
 gainAt(1.0f),
 axisNeedsUpdate(true),
-mainAudioBufferSystem(buffManag)
+mainAudioBufferSystem(buffManag),
+widthAt(0),
+heightAt(0)
 {
     setTopLeftPosition(9, 89); //7, 263
     setSize (710, 166); // 714,281
@@ -1671,12 +1983,7 @@ mainAudioBufferSystem(buffManag)
     setOpaque(true);
     
     rmsWindowLength = sR * 0.4f;
-    historyBufferPre   = std::vector<float> ( getWidth(), getHeight());
-    historyBufferPost  = std::vector<float> ( getWidth(), getHeight());
-    historyBufferMinMaxPre = std::vector<Range<float>> ( getWidth(), Range<float>(getHeight() / 2, getHeight() / 2));
-    historyBufferMinMaxPost = std::vector<Range<float>> ( getWidth(), Range<float>(getHeight() / 2, getHeight() / 2));
-    rmsGainBuffer  = std::vector<float> ( getWidth(), getHeight() / 2);
-
+    
     rmsGainPath.preallocateSpace(7 + getWidth());
     
     createNewAxis();
@@ -1688,7 +1995,10 @@ WaveformAnalyser::~WaveformAnalyser()
 
 void WaveformAnalyser::paint (Graphics& g)
 {
-    createFrame();
+    {
+        const ScopedFrameAllocationCheck allocationCheck (maxNumOfPaintAllocations);
+        createFrame();
+    }
     g.drawImage (waveformImage, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
     if (axisNeedsUpdate.load()) createNewAxis();
     g.drawImage (axisImage, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
@@ -1696,12 +2006,12 @@ void WaveformAnalyser::paint (Graphics& g)
 
 void WaveformAnalyser::createFrame()
 {
-    processData();
+    const renderDataType& data = renderData.getReadBuffer();
     
     const int width = getWidth();
     const int height = getHeight();
     
-    waveformImage = Image(Image::PixelFormat::RGB, getWidth(), getHeight(), true);
+    waveformImage.clear (waveformImage.getBounds());
     Graphics g (waveformImage);
     
     g.setColour (Colour (0xff0f0f1c));
@@ -1710,7 +2020,7 @@ void WaveformAnalyser::createFrame()
     g.setColour  (Colours::lightgrey);
     g.setOpacity (0.3f);
     int x1 = 0;
-    for (Range<float> valuesInPixel : historyBufferMinMaxPre)
+    for (Range<float> valuesInPixel : data.minMaxPre)
     {
         g.drawVerticalLine(x1, valuesInPixel.getStart(), height / 2);
         g.drawVerticalLine(x1, height / 2, valuesInPixel.getEnd() );
@@ -1720,7 +2030,7 @@ void WaveformAnalyser::createFrame()
     g.setColour  (Colours::whitesmoke);
     g.setOpacity (0.85f);
     int x2 = 0;
-    for (Range<float> valuesInPixel : historyBufferMinMaxPost)
+    for (Range<float> valuesInPixel : data.minMaxPost)
     {
         g.drawVerticalLine(x2, valuesInPixel.getStart(), height / 2);
         g.drawVerticalLine(x2, height / 2, valuesInPixel.getEnd() );
@@ -1730,7 +2040,7 @@ void WaveformAnalyser::createFrame()
     rmsGainPath.clear();
     rmsGainPath.startNewSubPath(0, height / 2);
     int x3 = 0;
-    for (float valueInPixel : rmsGainBuffer)
+    for (float valueInPixel : data.rmsGain)
     {
         rmsGainPath.lineTo (x3, valueInPixel);
         ++x3;
@@ -1742,12 +2052,36 @@ void WaveformAnalyser::createFrame()
     g.strokePath (rmsGainPath, PathStrokeType (2.f, PathStrokeType::beveled));
 }
 
+void WaveformAnalyser::prepareFrame()
+{
+    frameWidth  = widthAt.load();
+    frameHeight = heightAt.load();
+    
+    if ((int) rmsGainDbRing.size() != frameWidth)
+    {
+        rmsGainDbRing.assign ((size_t) frameWidth, 0.0f);
+        rmsGainSamplesPerPixel = 0;
+    }
+    
+    // one entry per pixel column, in the buffer written next only: the message thread
+    // may be drawing the others, they follow when they come up for writing
+    renderDataType& data = renderData.getWriteBuffer();
+    if ((int) data.rmsGain.size() != frameWidth)
+    {
+        data.minMaxPre  .resize ((size_t) frameWidth);
+        data.minMaxPost .resize ((size_t) frameWidth);
+        data.rmsGain    .resize ((size_t) frameWidth);
+    }
+}
+
 void WaveformAnalyser::processData()
 {
-    const int width = getWidth();
-    const int height = getHeight();
+    const int width = frameWidth;
+    const int height = frameHeight;
+    if (width <= 0)
+        return;
+
     const int sampleRate = sampleRateAt.load();
-    const int numOfChannels = mainAudioBufferSystem.bufferPre.historyBuffer.getNumChannels();
     
     const float gain = gainAt.load();
     
@@ -1768,80 +2102,85 @@ void WaveformAnalyser::processData()
         case 1: rmsGainCurbeRange = 12; break;
         case 2: rmsGainCurbeRange = 24; break;
         case 3: rmsGainCurbeRange = 36; break;
-        default: modeDurationSeconds = 12; break;
+        default: rmsGainCurbeRange = 12; break;
     }
 
     
     int numOfSamplesInTimeMode = sampleRate * modeDurationSeconds; // 44100 * 2 88200 samples ( 2s of audio )
-    int numOfSamplesPerPixel = numOfSamplesInTimeMode / width; // ~ 125 samples / pixel
+    int numOfSamplesPerPixel = jmax (1, numOfSamplesInTimeMode / width); // ~ 125 samples / pixel
     
-    int numOfNewSamples = sampleRate * ( 43 / 1000.f );
-    int numOfNewPixelValues = std::ceil(numOfNewSamples / (float)numOfSamplesPerPixel);
-    
-    AudioBuffer<float> audioBlockPre (2, numOfNewPixelValues * numOfSamplesPerPixel );
-    audioBlockPre.clear();
-    mainAudioBufferSystem.bufferPre.copySamplesFromHistoryBuffer(audioBlockPre, numOfNewSamples);
-    
-    AudioBuffer<float> audioBlockPost (2, numOfNewPixelValues * numOfSamplesPerPixel );
-    audioBlockPost.clear();
-    mainAudioBufferSystem.bufferPost.copySamplesFromHistoryBuffer(audioBlockPost, numOfNewSamples);
-    
-    FloatVectorOperations::copy (&rmsGainBuffer[0], &rmsGainBuffer[numOfNewPixelValues], width - numOfNewPixelValues);
+    // Columns are aligned to absolute sample positions, column j covers [j, j + 1) * numOfSamplesPerPixel
+    // (shifted by each buffer's processor delay), so a column never changes once it is complete.
+    const AudioBufferManagement::minMaxPyramidType& minMaxPre  = mainAudioBufferSystem.bufferPre  .monoMinMax;
+    const AudioBufferManagement::minMaxPyramidType& minMaxPost = mainAudioBufferSystem.bufferPost .monoMinMax;
+    const int64 numOfSamples = minMaxPre.getNumOfSamples();
+    const int64 endColumn = numOfSamples / numOfSamplesPerPixel;
     
-    for (int i = 0; i < width - numOfNewPixelValues; i++)
+    // the gain needs the RMS windows of the history, so only the new columns are computed
+    if (numOfSamplesPerPixel != rmsGainSamplesPerPixel || endColumn - nextRmsGainColumn > width || endColumn < nextRmsGainColumn)
     {
-        historyBufferMinMaxPre[i]   = historyBufferMinMaxPre  [i + numOfNewPixelValues];
-        historyBufferMinMaxPost[i]  = historyBufferMinMaxPost [i + numOfNewPixelValues];
+        nextRmsGainColumn = endColumn - width;
+        rmsGainSamplesPerPixel = numOfSamplesPerPixel;
     }
     
-    for (auto i = 0; i < numOfNewPixelValues; ++i)
+    const int numOfSamplesInHistory = mainAudioBufferSystem.bufferPre.historyBuffer.getNumSamples();
+    for (; nextRmsGainColumn < endColumn; ++nextRmsGainColumn)
     {
-        int index = i * numOfSamplesPerPixel;
-        AudioBuffer<float> sampleGroupPre  (2, numOfSamplesPerPixel);
-        AudioBuffer<float> sampleGroupPost (2, numOfSamplesPerPixel);
+        const int64 samplesInThePast = numOfSamples - (nextRmsGainColumn + 1) * numOfSamplesPerPixel;
+        float& gainDb = rmsGainDbRing [(size_t) ((nextRmsGainColumn % width + width) % width)];
         
-        for (auto ch = 0; ch < numOfChannels ; ++ch)
+        if (nextRmsGainColumn < 0 || samplesInThePast + rmsWindowLength >= numOfSamplesInHistory)
         {
-            sampleGroupPre  .copyFrom (ch, 0, audioBlockPre,  ch, index, numOfSamplesPerPixel);
-            sampleGroupPost .copyFrom (ch, 0, audioBlockPost, ch, index, numOfSamplesPerPixel);
+            gainDb = 0.0f;
+            continue;
         }
-        FloatVectorOperations::add (sampleGroupPre.getWritePointer(0), sampleGroupPre.getReadPointer(1), numOfSamplesPerPixel);
-        FloatVectorOperations::add (sampleGroupPost.getWritePointer(0), sampleGroupPost.getReadPointer(1), numOfSamplesPerPixel);
-        
-        Range<float> maxMinSampleGroupPre   = FloatVectorOperations::findMinAndMax (sampleGroupPre.getReadPointer(0),  numOfSamplesPerPixel);
-        Range<float> maxMinSampleGroupPost  = FloatVectorOperations::findMinAndMax (sampleGroupPost.getReadPointer(0), numOfSamplesPerPixel);
-        
-        float newStartPre = ( (height / 2) - ( maxMinSampleGroupPre.getEnd() * (height / 2) * gain));
-        float newEndPre = ( (height / 2) - ( maxMinSampleGroupPre.getStart() * (height / 2) * gain));
-        float newStartPost = ( (height / 2) - ( maxMinSampleGroupPost.getEnd() * (height / 2) * gain));
-        float newEndPost = ( (height / 2) - ( maxMinSampleGroupPost.getStart() * (height / 2) * gain));
-        
-        maxMinSampleGroupPre = Range<float> (newStartPre, newEndPre);
-        maxMinSampleGroupPost = Range<float> (newStartPost, newEndPost);
-        maxMinSampleGroupPre  .getIntersectionWith (Range<float>(0, height));
-        maxMinSampleGroupPost .getIntersectionWith (Range<float>(0, height));
-        
-        historyBufferMinMaxPre  [ width - i - 1 ] = maxMinSampleGroupPre;
-        historyBufferMinMaxPost [ width - i - 1 ] = maxMinSampleGroupPost;
         
-        float rmsInBufferPre   = mainAudioBufferSystem.bufferPre  .getRMSMonoValueInSample(index, rmsWindowLength);
-        float rmsInBufferPost  = mainAudioBufferSystem.bufferPost .getRMSMonoValueInSample(index, rmsWindowLength);
+        float rmsInBufferPre   = mainAudioBufferSystem.bufferPre  .getRMSMonoValueInSample((int) samplesInThePast, rmsWindowLength);
+        float rmsInBufferPost  = mainAudioBufferSystem.bufferPost .getRMSMonoValueInSample((int) samplesInThePast, rmsWindowLength);
         
         double linGain = double(rmsInBufferPost) / double(rmsInBufferPre) ;
         if (isinf(linGain)) linGain = 0;
-        double gainLog = 20 * log10 (linGain);
-        double rmsValuePixel = ( gainLog / rmsGainCurbeRange ) * ( height / 2.f );
+        gainDb = (float) (20 * log10 (linGain));
+    }
+    
+    auto toPixelRange = [height, gain] (Range<float> minMax)
+    {
+        float newStart = ( (height / 2) - ( minMax.getEnd()   * (height / 2) * gain));
+        float newEnd   = ( (height / 2) - ( minMax.getStart() * (height / 2) * gain));
+        return Range<float> (newStart, newEnd).getIntersectionWith (Range<float> (0, height));
+    };
+    
+    const int delayPre  = roundToInt (mainAudioBufferSystem.bufferPre  .getAlignmentDelay());
+    const int delayPost = roundToInt (mainAudioBufferSystem.bufferPost .getAlignmentDelay());
+    
+    renderDataType& data = renderData.getWriteBuffer();
+    for (int x = 0; x < width; ++x)
+    {
+        const int64 column = endColumn - width + x;
+        const int64 firstSample = column * numOfSamplesPerPixel;
+        const int64 endSample   = firstSample + numOfSamplesPerPixel;
+        
+        data.minMaxPre  [x] = toPixelRange (minMaxPre  .getMinMax (firstSample - delayPre,  endSample - delayPre));
+        data.minMaxPost [x] = toPixelRange (minMaxPost .getMinMax (firstSample - delayPost, endSample - delayPost));
+        
+        double rmsValuePixel = ( rmsGainDbRing [(size_t) ((column % width + width) % width)] / rmsGainCurbeRange ) * ( height / 2.f );
         rmsValuePixel = ( height / 2.f) - rmsValuePixel;
         if (! isPositiveAndBelow (rmsValuePixel, height))
         {
             if ( rmsValuePixel < 0 ) rmsValuePixel = 0;
             else                     rmsValuePixel = height - 1;
         }
-        rmsGainBuffer [width - i - 1] = rmsValuePixel;
+        data.rmsGain [x] = rmsValuePixel;
     }
+    renderData.publish();
 }
 
-void WaveformAnalyser::resized() {}
+void WaveformAnalyser::resized()
+{
+    waveformImage = Image (Image::PixelFormat::RGB, getWidth(), getHeight(), true);
+    widthAt.store (getWidth());
+    heightAt.store (getHeight());
+}
 
 void WaveformAnalyser::createNewAxis()
 {
@@ -1921,18 +2260,21 @@ LevelMeter::~LevelMeter()
 
 void LevelMeter::paint (Graphics& g)
 {
-    createFrame();
+    {
+        const ScopedFrameAllocationCheck allocationCheck (maxNumOfPaintAllocations);
+        createFrame();
+    }
     g.drawImage (waveformImage, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
     g.drawImage (axisImage, 0, 0, getWidth(), getHeight(), 0, 0, getWidth(), getHeight());
 }
 
 void LevelMeter::createFrame()
 {
-    processData();
+    const SetOfValuesToPaint& valuesToPaint = renderData.getReadBuffer();
     const int width = getWidth();
     const int height = getHeight();
     
-    waveformImage = Image(Image::PixelFormat::RGB, width, height, true);
+    waveformImage.clear (waveformImage.getBounds());
     Graphics g (waveformImage);
     
     g.setColour (Colour (0xff0f0f1c));
@@ -1946,14 +2288,14 @@ void LevelMeter::createFrame()
     float finalPixelValue, rmsLevel, rmsLevelNorm;
 
     // LEFT CHANNEL FINAL LEVEL (PEAK & RMS)
-    rmsLevel = 20 * log10 (setOfValuesToPaint.peakLevelPost.first ) + 3.f;
+    rmsLevel = 20 * log10 (valuesToPaint.peakLevelPost.first ) + 3.f;
     rmsLevelNorm =  abs(rmsLevel) / maxRangeAbsolute; // ~-1 , ~0
     finalPixelValue = topPartOffset + ( rmsLevelNorm * size0dB );
     
     g.setColour(Colours::whitesmoke.darker());
     g.fillRect (Rectangle<float>::leftTopRightBottom (60.f, finalPixelValue, (width/2.f) - 1.0f , height));
 
-    rmsLevel = 20 * log10 (setOfValuesToPaint.rmsLevelPost.first) + 3.f;
+    rmsLevel = 20 * log10 (valuesToPaint.rmsLevelPost.first) + 3.f;
     rmsLevelNorm =  abs(rmsLevel) / maxRangeAbsolute; // ~-1 , ~0
     finalPixelValue = topPartOffset + ( rmsLevelNorm * size0dB );
     
@@ -1961,14 +2303,14 @@ void LevelMeter::createFrame()
     g.fillRect (Rectangle<float>::leftTopRightBottom (60.f, finalPixelValue, (width/2.f) - 1.0f, height));
     
     // RIGHT CHANNEL FINAL LEVEL (PEAK & RMS)
-    rmsLevel = 20 * log10 (setOfValuesToPaint.peakLevelPost.second ) + 3.f;
+    rmsLevel = 20 * log10 (valuesToPaint.peakLevelPost.second ) + 3.f;
     rmsLevelNorm =  abs(rmsLevel) / maxRangeAbsolute; // ~-1 , ~0
     finalPixelValue = topPartOffset + ( rmsLevelNorm * size0dB );
     
     g.setColour(Colours::whitesmoke.darker());
     g.fillRect (Rectangle<float>::leftTopRightBottom ((width/2.f) + 1.0f, finalPixelValue, width - 60.0f , height));
     
-    rmsLevel = 20 * log10 (setOfValuesToPaint.rmsLevelPost.second) + 3.f;
+    rmsLevel = 20 * log10 (valuesToPaint.rmsLevelPost.second) + 3.f;
     rmsLevelNorm =  abs(rmsLevel) / maxRangeAbsolute; // ~-1 , ~0
     finalPixelValue = topPartOffset + ( rmsLevelNorm * size0dB );
     
@@ -1976,7 +2318,7 @@ void LevelMeter::createFrame()
     g.fillRect (Rectangle<float>::leftTopRightBottom ((width/2.f) + 1.0f, finalPixelValue, width - 60.0f, height));
     
     // LEFT CHANNEL DIFFERENCE LEVEL (PEAK & RMS)
-    rmsLevel = 20 * log10 (setOfValuesToPaint.peakLevelDifference.first );
+    rmsLevel = 20 * log10 (valuesToPaint.peakLevelDifference.first );
     finalPixelValue = size0dBDiff - (rmsLevel * numPixPerDb);
 
     rmsLevel > 0 ?
@@ -1986,7 +2328,7 @@ void LevelMeter::createFrame()
         g.fillRect (Rectangle<float>::leftTopRightBottom (33.f, finalPixelValue, 39.f , size0dBDiff)) :
         g.fillRect (Rectangle<float>::leftTopRightBottom (33.f, size0dBDiff, 39.f , finalPixelValue));
 
-    rmsLevel = 20 * log10 (setOfValuesToPaint.rmsLevelDifference.first);
+    rmsLevel = 20 * log10 (valuesToPaint.rmsLevelDifference.first);
     finalPixelValue = size0dBDiff - (rmsLevel * numPixPerDb);
 
     rmsLevel > 0 ?
@@ -1997,7 +2339,7 @@ void LevelMeter::createFrame()
         g.fillRect (Rectangle<float>::leftTopRightBottom (40.f, size0dBDiff, 60.0f - 2.0f , finalPixelValue));
 
     // RIGHT CHANNEL DIFFERENCE LEVEL (PEAK & RMS)
-    rmsLevel = 20 * log10 (setOfValuesToPaint.peakLevelDifference.second );
+    rmsLevel = 20 * log10 (valuesToPaint.peakLevelDifference.second );
     finalPixelValue = size0dBDiff - (rmsLevel * numPixPerDb);
 
     rmsLevel > 0 ?
@@ -2007,7 +2349,7 @@ void LevelMeter::createFrame()
         g.fillRect (Rectangle<float>::leftTopRightBottom (width - 40.f + 1, finalPixelValue, width - 40.f + 7.f , size0dBDiff)) :
         g.fillRect (Rectangle<float>::leftTopRightBottom (width - 40.f + 1, size0dBDiff, width - 40.f + 7.f , finalPixelValue));
 
-    rmsLevel = 20 * log10 (setOfValuesToPaint.rmsLevelDifference.second );
+    rmsLevel = 20 * log10 (valuesToPaint.rmsLevelDifference.second );
     finalPixelValue = size0dBDiff - (rmsLevel * numPixPerDb);
 
     rmsLevel > 0 ?
@@ -2019,6 +2361,17 @@ void LevelMeter::createFrame()
 
 }
 
+void LevelMeter::prepareFrame()
+{
+    const int numOfNewSamples = sampleRateAt.load() * ( 43 / 1000.f );
+    
+    if (audioBlockPre.getNumSamples() != numOfNewSamples)
+    {
+        audioBlockPre  .setSize (2, numOfNewSamples);
+        audioBlockPost .setSize (2, numOfNewSamples);
+    }
+}
+
 void LevelMeter::processData()
 {
     const int sampleRate = sampleRateAt.load();
@@ -2036,11 +2389,10 @@ void LevelMeter::processData()
         = setOfValuesToPaint.rmsLevelPost.second / mainAudioBufferSystem.bufferPre.getRMSChannelValueInSample(0, rmsWindowLength, 1);
     
     // Peak computing for both pre and post signals
-    AudioBuffer<float> audioBlockPre (2, numOfNewSamples );
+    jassert (audioBlockPre.getNumSamples() >= numOfNewSamples);
     audioBlockPre.clear();
     mainAudioBufferSystem.bufferPre.copySamplesFromHistoryBuffer(audioBlockPre, numOfNewSamples);
     
-    AudioBuffer<float> audioBlockPost (2, numOfNewSamples );
     audioBlockPost.clear();
     mainAudioBufferSystem.bufferPost.copySamplesFromHistoryBuffer(audioBlockPost, numOfNewSamples);
     
@@ -2082,9 +2434,15 @@ void LevelMeter::processData()
     
     setOfValuesToPaint.peakLevelDifference.first   = differenceChannel1;
     setOfValuesToPaint.peakLevelDifference.second  = differenceChannel2;
+    
+    renderData.getWriteBuffer() = setOfValuesToPaint;
+    renderData.publish();
 }
 
-void LevelMeter::resized() {}
+void LevelMeter::resized()
+{
+    waveformImage = Image (Image::PixelFormat::RGB, getWidth(), getHeight(), true);
+}
 
 void LevelMeter::createNewAxis()
 {
@@ -2152,3 +2510,104 @@ void LevelMeter::createNewAxis()
 }
 
 
+
+//==============================================================================
+// AUDIO THREAD STATS OVERLAY
+AudioThreadStatsOverlay::AudioThreadStatsOverlay (audioThreadStatsType& s, AudioBufferManagement& mABS)
+:
+stats (s),
+mainAudioBufferSystem (mABS)
+{
+    setInterceptsMouseClicks (true, false);
+    for (int i = 0; i < numOfHistograms; ++i)
+        lastSnapshots[i] = getHistogram (i).getSnapshot();
+}
+
+AudioThreadStatsOverlay::~AudioThreadStatsOverlay()
+{
+}
+
+const timingHistogramType& AudioThreadStatsOverlay::getHistogram (int index) const
+{
+    if (index == 0) return stats.blockTime;
+    if (index == 1) return stats.chainTime;
+    if (index == 2) return stats.captureTime;
+    return stats.slotTime[index - 3];
+}
+
+String AudioThreadStatsOverlay::getHistogramName (int index)
+{
+    if (index == 0) return "block";
+    if (index == 1) return "chain";
+    if (index == 2) return "capture";
+    return "slot " + String (index - 2);
+}
+
+void AudioThreadStatsOverlay::update()
+{
+    const int sampleRate = stats.sampleRate.load();
+    const int blockSize  = stats.blockSize.load();
+    const double deadlineUs = sampleRate > 0 ? 1.0e6 * blockSize / sampleRate : 0.0;
+
+    lines.clearQuick();
+    lines.add ("audio thread   deadline " + String (deadlineUs, 0) + " us (" + String (blockSize) + " @ " + String (sampleRate) + ")");
+    lines.add ("               mean     p99     max  us   p99 %");
+
+    for (int i = 0; i < numOfHistograms; ++i)
+    {
+        const timingHistogramType::snapshotType snapshot = getHistogram (i).getSnapshot();
+        const timingHistogramType::snapshotType interval = snapshot.getDifference (lastSnapshots[i]);
+        lastSnapshots[i] = snapshot;
+
+        if (interval.numOfValues == 0)
+        {
+            lines.add (getHistogramName (i).paddedRight (' ', 10) + "      -");
+            continue;
+        }
+
+        const double p99Us = interval.getPercentileNs (99) / 1000.0;
+        lines.add (getHistogramName (i).paddedRight (' ', 10)
+                   + String (interval.getMeanNs() / 1000.0, 1).paddedLeft (' ', 9)
+                   + String (p99Us, 1).paddedLeft (' ', 8)
+                   + String (snapshot.maxNs / 1000.0, 1).paddedLeft (' ', 8)
+                   + (deadlineUs > 0 ? String (100.0 * p99Us / deadlineUs, 1) : String ("-")).paddedLeft (' ', 10));
+    }
+
+    lines.add (String());
+    lines.add ("blocks                " + String (stats.numOfBlocks.load()));
+    lines.add ("chain swaps           " + String (stats.numOfChainSwaps.load()));
+    lines.add ("cut crossfades        " + String (stats.numOfCutCrossfades.load()));
+    lines.add ("dropped samples       " + String (stats.numOfDroppedSamples.load()));
+    lines.add ("capture overruns      " + String (mainAudioBufferSystem.captureRing.numOfOverrunBlocks.load()));
+    lines.add (dumpMessage.isEmpty() ? String ("click to dump to file") : dumpMessage);
+
+    if (isVisible())
+        repaint();
+}
+
+void AudioThreadStatsOverlay::paint (Graphics& g)
+{
+    g.setColour (Colour (0xff181f22).withAlpha (0.85f));
+    g.fillRoundedRectangle (getLocalBounds().toFloat(), 4.0f);
+    g.setColour (Colours::grey);
+    g.drawRoundedRectangle (getLocalBounds().toFloat().reduced (0.5f), 4.0f, 1.0f);
+
+    g.setColour (Colours::white);
+    g.setFont (Font (Font::getDefaultMonospacedFontName(), 11.0f, Font::plain));
+
+    const int lineHeight = 13;
+    for (int i = 0; i < lines.size(); ++i)
+        g.drawText (lines[i], 8, 6 + i * lineHeight, getWidth() - 16, lineHeight, Justification::centredLeft, false);
+}
+
+void AudioThreadStatsOverlay::mouseDown (const MouseEvent&)
+{
+    const File folder = File::getSpecialLocation (File::userDocumentsDirectory).getChildFile ("ChannelStripAnalyser");
+    folder.createDirectory();
+
+    const File file = folder.getChildFile ("audio-thread-stats-" + Time::getCurrentTime().formatted ("%Y%m%d-%H%M%S") + ".csv");
+    dumpMessage = stats.dumpToFile (file, mainAudioBufferSystem.captureRing.numOfOverrunBlocks.load())
+                ? "written to " + file.getFileName()
+                : "could not write " + file.getFileName();
+    update();
+}
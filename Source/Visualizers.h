@@ -1,23 +1,27 @@
 #pragma once
-#include "../JuceLibraryCode/JuceHeader.h"
+#include "JuceHeader.h"
 #include "spline.h"
-#include "PluginProcessor.h"
+#include "AnalysisEngine.h"
+#include "AudioThreadStats.h"
 #include <deque>
 #include <numeric>
 
 //==============================================================================
-class SpectrumAnalyser  : public Component
+class SpectrumAnalyser  : public Component,
+                          public AnalysisClient
 {
     
 public:
     typedef std::vector<std::vector<float>> floatMatrix;
     typedef AudioBufferManagement::audioBufferManagementType audioBufferManagementType;
 
-    SpectrumAnalyser(int sampleRate, int fftSize, int numOfChannels, AudioBufferManagement& mainAudioBufferSystem, forwardFFT& fFFT);
+    SpectrumAnalyser(int sampleRate, int fftSize, int numOfChannels, AudioBufferManagement& mainAudioBufferSystem, STFTAnalyser& stftAnalyser);
     ~SpectrumAnalyser();
     
     void paint (Graphics& g) override;
     void createFrame();
+    void prepareFrame() override;
+    void processData() override;
     void resized() override;
 
     std::atomic<bool> axisNeedsUpdate;
@@ -25,40 +29,58 @@ public:
     std::atomic<int> fftSizeAt;
     std::atomic<int> sampleRateAt;
     std::atomic<double> decayRatioAt;
+    std::atomic<bool> interpolationAt;      // parabolic peaks and bins, see pixelReductionTable
     
 private:
-    void processAllFftData (audioBufferManagementType& buffer, std::vector<double>& magnitudeDBmono, std::vector<float>& maxValues);
-    void peakHolder (int i, float& magLin, std::vector<float>& maxValues, double &decayRatio);
-    void createPath (std::vector<double>& magnitudeDBmono, Path &drawPath);
+    struct renderDataType
+    {
+        Path drawPathPre;
+        Path drawPathPost;
+        int preallocatedWidth = 0;              // the paths have room for this many pixel columns
+    };
+    
+    void processAllFftData (const float* bins, int numOfBins, int windowLength, std::vector<float>& magnitudeDBmono, std::vector<float>& maxValues);
+    void createPath (std::vector<float>& magnitudeDBmono, Path &drawPath);
     void createNewAxis ();
     
     std::vector<float> maxValuesPre;
     std::vector<float> maxValuesPost;
-    std::vector<double> monoMagDataPre;
-    std::vector<double> monoMagDataPost;
+    std::vector<float> monoMagDataPre;
+    std::vector<float> monoMagDataPost;
+    std::vector<float> pixelMagDb;
     
-    floatMatrix conversionTable;
+    pixelReductionTable reductionTable;
+    TripleBuffer<renderDataType> renderData;
     Image spectrumFrame;
     Image axisImage;
     Image shadeWindow;
     
     AudioBufferManagement& mainAudioBufferSystem;
-    forwardFFT& forwFFT;
+    STFTAnalyser& stftAnalyser;
     std::mutex m;
+    
+    // set by resized(), the analysis thread reads the size from here instead of the Component
+    std::atomic<int> widthAt;
+    std::atomic<int> heightAt;
+    int frameHeight = 0;                        // heightAt as prepareFrame() found it
+    int64 maxNumOfPaintAllocations = 0;         // message thread, see ScopedFrameAllocationCheck
 };
 
 //==============================================================================
-class SpectrumDifference  : public Component
+class SpectrumDifference  : public Component,
+                            public AnalysisClient
 {
 public:
     typedef std::vector<std::vector<float>> floatMatrix;
     typedef AudioBufferManagement::audioBufferManagementType audioBufferManagementType;
     
-    SpectrumDifference(int sampleRate, int fftSize, int nomOfChannels, AudioBufferManagement& mainAudioBufferSystem, forwardFFT& fFFT);
+    SpectrumDifference(int sampleRate, int fftSize, int nomOfChannels, AudioBufferManagement& mainAudioBufferSystem, STFTAnalyser& stftAnalyser);
     ~SpectrumDifference();
     
     void paint (Graphics& g) override;
     void createFrame();
+    void prepareFrame() override;
+    void processData() override;
     void resized() override;
 
     std::atomic<bool> axisNeedsUpdate;
@@ -66,83 +88,197 @@ public:
     std::atomic<int> scaleModeAt;
     std::atomic<int> fftSizeAt;
     std::atomic<int> sampleRateAt;
-    std::atomic<int> numOfHistorySamplesAt;
+    std::atomic<int> numOfHistorySamplesAt;     // time constant of the transfer function average, in frames
+    std::atomic<int> estimatorAt;               // transferFunctionType::estimatorType
 
 private:
-    void processAllFftData (audioBufferManagementType& binsStereoPre, audioBufferManagementType& binsStereoPost, std::vector<double>& linGain1, std::vector<double>& linGain2 );
-    void peakHolder (int i, float& magLin, floatMatrix &historySamples);
+    struct renderDataType
+    {
+        Path drawPath1;
+        Path drawPath2;
+        Path coherencePath;                     // of the first curve, filled from the bottom
+        int analyseMode = 0;
+        int preallocatedWidth = 0;              // the paths have room for this many pixel columns
+    };
+    
+    void addFrame (const spectrumFrameType& frame, int mode);
+    void processAllFftData (int mode, std::vector<double>& linGain1, std::vector<double>& linGain2 );
+    void processGainData (const transferFunctionType& transfer, std::vector<double>& linGain);
     void createPath (std::vector<double>& magnitudeDBmono, Path &drawPath);
+    void createCoherencePath (const transferFunctionType& transfer, Path& drawPath);
     void createNewAxis ();
+    void createConversionTable (int width);
 
     AudioBufferManagement& mainAudioBufferSystem;
-    forwardFFT& forwFFT;
+    STFTAnalyser& stftAnalyser;
     std::mutex m;
     
-    int numOfHistorySamples = 0;
+    // set by resized(), the analysis thread reads the size from here instead of the Component
+    std::atomic<int> widthAt;
+    std::atomic<int> heightAt;
+    int frameWidth = 0;                         // the size prepareFrame() built the conversion table for
+    int frameHeight = 0;
     
     std::vector<double> linGainData1;
     std::vector<double> linGainData2;
-    floatMatrix historyValues1;
-    floatMatrix historyValues2;
+    transferFunctionType transfer1;
+    transferFunctionType transfer2;
+    int lastAnalyseMode = 0;
+    int64 lastFrameIndex = -1;
 
     floatMatrix conversionTable;
+    int numOfLogPoints = 0;                 // the frames' multi-resolution layout, 0: linear bins
+    TripleBuffer<renderDataType> renderData;
     Image mainFrame;
     Image axisImage;
     Image shadeWindow;
+    int64 maxNumOfPaintAllocations = 0;         // message thread, see ScopedFrameAllocationCheck
 };
 
 //==============================================================================
-class PhaseDifference  : public Component
+class PhaseDifference  : public Component,
+                         public AnalysisClient
 {
     
 public:
     typedef std::vector<std::vector<float>> floatMatrix;
     typedef AudioBufferManagement::audioBufferManagementType audioBufferManagementType;
     
-    PhaseDifference (int sampleRate, int fftSize, int nomOfChannels, AudioBufferManagement& mainAudioBufferSystem, forwardFFT& fFFT);
+    PhaseDifference (int sampleRate, int fftSize, int nomOfChannels, AudioBufferManagement& mainAudioBufferSystem, STFTAnalyser& stftAnalyser);
     ~PhaseDifference();
     
     void paint (Graphics& g) override;
     void createFrame();
+    void prepareFrame() override;
+    void processData() override;
     void resized() override;
     
     std::atomic<int> analyseMode;    
     std::atomic<int> fftSizeAt;
     std::atomic<int> sampleRateAt;
-    std::atomic<int> numOfHistorySamplesAt;
+    std::atomic<int> numOfHistorySamplesAt;     // time constant of the transfer function average, in frames
     
     
 private:
-    void processAllFftData (audioBufferManagementType& binsStereoPre, audioBufferManagementType& binsStereoPost, std::vector<double>& linGain1, std::vector<double>& linGain2 );
+    struct renderDataType
+    {
+        Path drawPath1;
+        Path drawPath2;
+        int analyseMode = 0;
+        int preallocatedWidth = 0;              // the paths have room for this many pixel columns
+    };
+    
+    void addFrame (const spectrumFrameType& frame, int mode);
+    void processAllFftData (int mode, std::vector<double>& linGain1, std::vector<double>& linGain2 );
+    void processPhaseData (const transferFunctionType& transfer, std::vector<double>& phaseDiffs);
     
-    void peakHolder (int i, float& magLin, floatMatrix &historySamples);
     void createPath (std::vector<double>& magnitudeDBmono, Path &drawPath);
     void createNewAxis ();
+    void createConversionTable (int width);
     
     AudioBufferManagement& mainAudioBufferSystem;
-    forwardFFT& forwFFT;
+    STFTAnalyser& stftAnalyser;
     std::mutex m;
     
+    // set by resized(), the analysis thread reads the size from here instead of the Component
+    std::atomic<int> widthAt;
+    std::atomic<int> heightAt;
+    int frameWidth = 0;                         // the size prepareFrame() built the conversion table for
+    int frameHeight = 0;
+    
     std::vector<double> linGainData1;
     std::vector<double> linGainData2;
     
-    floatMatrix historyValues1;
-    floatMatrix historyValues2;
-    int numOfHistorySamples = 0;
+    transferFunctionType transfer1;
+    transferFunctionType transfer2;
+    int lastAnalyseMode = 0;
+    int64 lastFrameIndex = -1;
     
     floatMatrix conversionTable;
+    int numOfLogPoints = 0;                 // the frames' multi-resolution layout, 0: linear bins
+    TripleBuffer<renderDataType> renderData;
     Image mainFrame;
     Image axisImage;
     Image shadeWindow;
+    int64 maxNumOfPaintAllocations = 0;         // message thread, see ScopedFrameAllocationCheck
 };
 
 //==============================================================================
-class StereoAnalyser  : public Component
+/** Stereo coherence spectrum: how far left and right agree per frequency band, before
+    and after the chain. The cross spectrum L * conj (R) and both power spectra are summed
+    over the bins of every band of the shared STFT frame and averaged over time per band,
+    so a frame costs one pass over the bins. The line is Re (S_LR) / sqrt (S_LL * S_RR),
+    +1 in phase, 0 unrelated, -1 out of phase; the shade under it is the post coherence
+    |S_LR| / sqrt (S_LL * S_RR), which a polarity flip keeps and a chorus or widener lowers.
+*/
+class CoherenceAnalyser  : public Component,
+                           public AnalysisClient
+{
+public:
+    CoherenceAnalyser (int sampleRate, int fftSize, AudioBufferManagement& mainAudioBufferSystem, STFTAnalyser& stftAnalyser);
+    ~CoherenceAnalyser();
+    
+    void paint (Graphics& g) override;
+    void createFrame();
+    void prepareFrame() override;
+    void processData() override;
+    void resized() override;
+    
+    std::atomic<int> fftSizeAt;
+    std::atomic<int> sampleRateAt;
+    std::atomic<int> numOfHistorySamplesAt;     // time constant of the average, in frames
+    std::atomic<int> bandScaleAt;               // frequencyBandTable::bandScaleType
+    
+private:
+    struct renderDataType
+    {
+        Path drawPathPre;
+        Path drawPathPost;
+        Path coherencePath;
+        int preallocatedBands = 0;              // the paths have room for this many bands
+    };
+    
+    // recursive averages of one tap, one entry per band
+    struct bandSpectraType
+    {
+        std::vector<float> crossRe;
+        std::vector<float> crossIm;
+        std::vector<float> powerL;
+        std::vector<float> powerR;
+    };
+    
+    void updateBands (frequencyBandTable::bandScaleType scale, int fftSize, int sampleRate, int width);
+    void averageBands (const float* binsL, const float* binsR, float ratio, bandSpectraType& spectra);
+    void createPaths (renderDataType& data);
+    void createNewAxis ();
+    
+    AudioBufferManagement& mainAudioBufferSystem;
+    STFTAnalyser& stftAnalyser;
+    
+    frequencyBandTable bandTable;
+    std::vector<float> bandPositions;           // x of every band centre on the log axis
+    int bandPositionsWidth = 0;
+    bandSpectraType spectraPre;
+    bandSpectraType spectraPost;
+    int64 lastFrameIndex = -1;
+    
+    // set by resized(), the analysis thread reads the size from here instead of the Component
+    std::atomic<int> widthAt;
+    std::atomic<int> heightAt;
+    
+    TripleBuffer<renderDataType> renderData;
+    Image mainFrame;
+    Image axisImage;
+    Image shadeWindow;
+    int64 maxNumOfPaintAllocations = 0;         // message thread, see ScopedFrameAllocationCheck
+};
+
+//==============================================================================
+class StereoAnalyser  : public Component,
+                        public AnalysisClient
 {
     
 public:
-    typedef std::pair<float, float> pairOfXYpoints;
-    typedef std::deque <std::vector <pairOfXYpoints>> pairFloatMatrix;
     typedef AudioBufferManagement::audioBufferManagementType audioBufferManagementType;
 
     struct setOfCorrPoints
@@ -157,44 +293,94 @@ public:
     
     void paint (Graphics& g) override;
     void createFrame();
+    void prepareFrame() override;
+    void processData() override;
     void resized() override;
     
     std::atomic<int> blockSizeAt;
     std::atomic<int> sampleRateAt;
     std::atomic<int> numOfHistorySamplesAt;
     std::atomic<float> zoomAt;
+    std::atomic<bool> persistenceModeAt;    // decaying accumulation instead of redrawing the history
+    std::atomic<bool> bandCorrelationAt;    // every correlation bar split into low, mid and high
 
     
 private:
+    struct renderDataType
+    {
+        Image lissajouCurbe;
+        Image correlationLines;
+    };
+    
+    // below 250 Hz, 250 Hz .. 2.5 kHz, above 2.5 kHz
+    enum { numOfCorrelationBands = 3, correlationSumBlockSize = 256 };
+    
+    // one tap's correlation, fed with every sample the history receives
+    struct correlationTapType
+    {
+        streamingCorrelationType broadband;
+        streamingCorrelationType bands[numOfCorrelationBands];
+        IIRFilter lowPass[2], midHighPass[2], midLowPass[2], highPass[2];   // per channel
+    };
+    
     void processAllFftData();
-    void createCurbes ();
+    void updateCorrelation();
+    void addCorrelationSamples (correlationTapType& tap, const AudioBuffer<float>& block, int numOfSamples, bool withBands);
+    void createCurbes (renderDataType& data);
     void createNewAxis ();
     void createCorrelationBackground();
 
     AudioBufferManagement& mainAudioBufferSystem;
     forwardFFT& forwFFT;
+    
+    // set by resized(), the analysis thread reads the size from here instead of the Component
+    std::atomic<int> widthAt;
+    std::atomic<int> heightAt;
+    int frameWidth = 0;                         // the size prepareFrame() found, this frame's images have it
+    int frameHeight = 0;
 
-    pairFloatMatrix setOfPointsHistDataPre;
-    pairFloatMatrix setOfPointsHistDataPost;
-    setOfCorrPoints setOfCorrelationHistData;
+    // x / y of the last blocks of points, slot k at k * historyBlockSize, newestHistoryIndex holds the latest one
+    struct pointHistoryType
+    {
+        std::vector<float> x;
+        std::vector<float> y;
+    };
     
-    int corrRMSWindowLength;
-    float meanValuePre;
-    float meanValuePost;
+    pointHistoryType pointsPre;
+    pointHistoryType pointsPost;
+    pointDensityBuffer densityPre;
+    pointDensityBuffer densityPost;
+    bool persistenceMode = false;
+    float persistenceZoom = 0;
+    int numOfHistorySlots  = 0;
+    int historyBlockSize   = 0;
+    int newestHistoryIndex = 0;
+    int numOfValidHistory  = 0;
+    
+    AudioBuffer<float> audioBlockPre;
+    AudioBuffer<float> audioBlockPost;
+    AudioBuffer<float> bandBlock;
     
-    std::pair<float, float> energyPre;
-    std::pair<float, float> energyPost;
+    int corrRMSWindowLength;
+    int correlationSampleRate = 0;
+    bool correlationBands = false;
+    int64 lastCorrelationSample = 0;
+    correlationTapType correlationPre;
+    correlationTapType correlationPost;
+    setOfCorrPoints setOfCorrelationHistData;
+    setOfCorrPoints bandCorrelationData[numOfCorrelationBands];
     
+    TripleBuffer<renderDataType> renderData;
     Image mainFrame;
     Image axisImage;
-    Image lissajouCurbe;
     Image correlationBackground;
-    Image correlationLines;
     Image shadeWindow;
+    int64 maxNumOfPaintAllocations = 0;         // message thread, see ScopedFrameAllocationCheck
 };
 
 //==============================================================================
-class WaveformAnalyser  : public Component
+class WaveformAnalyser  : public Component,
+                          public AnalysisClient
 {
 public:
     typedef std::pair<float, float> pairOfFloats;
@@ -203,6 +389,8 @@ public:
     ~ WaveformAnalyser();
     
     void paint (Graphics& g) override;
+    void prepareFrame() override;
+    void processData() override;
     void resized() override;
     
     std::atomic<int> blockSizeAt;
@@ -214,28 +402,42 @@ public:
     std::atomic<bool> axisNeedsUpdate;
 
 private:
+    struct renderDataType
+    {
+        std::vector<Range<float>> minMaxPre;
+        std::vector<Range<float>> minMaxPost;
+        std::vector<float> rmsGain;
+    };
+    
     void createFrame();
-    void processData ();
     void createNewAxis ();
     
     AudioBufferManagement& mainAudioBufferSystem;
     
+    // set by resized(), the analysis thread reads the size from here instead of the Component
+    std::atomic<int> widthAt;
+    std::atomic<int> heightAt;
+    int frameWidth = 0;                         // the size prepareFrame() found, this frame's columns follow it
+    int frameHeight = 0;
+    
     int rmsWindowLength;
     
-    std::vector<Range<float>> historyBufferMinMaxPre;
-    std::vector<Range<float>> historyBufferMinMaxPost;
-
-    std::vector<float> historyBufferPost;
-    std::vector<float> historyBufferPre;
-    std::vector<float> rmsGainBuffer;
+    // Gain in dB per pixel column, column j is kept in slot j % width. The min/max
+    // columns are read from the history's min/max pyramid on every frame instead.
+    std::vector<float> rmsGainDbRing;
+    int64 nextRmsGainColumn = 0;
+    int rmsGainSamplesPerPixel = 0;
 
+    TripleBuffer<renderDataType> renderData;
     Path rmsGainPath;
     Image axisImage;
     Image waveformImage;
+    int64 maxNumOfPaintAllocations = 0;         // message thread, see ScopedFrameAllocationCheck
 };
 
 //==============================================================================
-class LevelMeter  : public Component
+class LevelMeter  : public Component,
+                    public AnalysisClient
 {
 public:
     
@@ -254,6 +456,8 @@ public:
     ~LevelMeter();
     
     void paint (Graphics& g) override;
+    void prepareFrame() override;
+    void processData() override;
     void resized() override;
     
     std::atomic<int> blockSizeAt;
@@ -261,7 +465,6 @@ public:
     
 private:
     void createFrame();
-    void processData();
     void createNewAxis();
     void peakHolder();
     
@@ -269,10 +472,45 @@ private:
     
     int rmsWindowLength;
     SetOfValuesToPaint setOfValuesToPaint;
+    TripleBuffer<SetOfValuesToPaint> renderData;
+    
+    AudioBuffer<float> audioBlockPre;
+    AudioBuffer<float> audioBlockPost;
     
     Path rmsGainPath;
     Image axisImage;
     Image waveformImage;
+    int64 maxNumOfPaintAllocations = 0;         // message thread, see ScopedFrameAllocationCheck
 };
 
 
+
+//==============================================================================
+/** Text overlay of the audio thread's counters and timings, refreshed by the editor's timer.
+    Clicking it dumps the full histograms to a CSV file in the documents folder.
+*/
+class AudioThreadStatsOverlay  : public Component
+{
+public:
+    AudioThreadStatsOverlay (audioThreadStatsType& stats, AudioBufferManagement& mainAudioBufferSystem);
+    ~AudioThreadStatsOverlay();
+
+    void paint (Graphics& g) override;
+    void mouseDown (const MouseEvent& event) override;
+
+    /** Takes new snapshots and formats the values of the interval since the last call. */
+    void update();
+
+private:
+    enum { numOfHistograms = 3 + audioThreadStatsType::numOfSlots };
+
+    const timingHistogramType& getHistogram (int index) const;
+    static String getHistogramName (int index);
+
+    audioThreadStatsType& stats;
+    AudioBufferManagement& mainAudioBufferSystem;
+
+    timingHistogramType::snapshotType lastSnapshots[numOfHistograms];
+    StringArray lines;
+    String dumpMessage;
+};
@@ -0,0 +1,306 @@
+// The shared headers include "JuceHeader.h" through the include path, the tool's own AppConfig.
+#include "../../../Source/AnalysisEngine.h"
+#include "../../../Source/Visualizers.h"
+
+//==============================================================================
+// ALLOCATION COUNTER
+// Only this executable replaces operator new, and only in debug builds unless asked for,
+// so release timings run on the plain allocator.
+#ifndef ANALYSER_BENCHMARK_COUNT_ALLOCATIONS
+ #define ANALYSER_BENCHMARK_COUNT_ALLOCATIONS JUCE_DEBUG
+#endif
+
+#if ANALYSER_BENCHMARK_COUNT_ALLOCATIONS
+namespace
+{
+    thread_local int64 numOfThreadAllocations = 0;
+}
+
+void* operator new (std::size_t size)
+{
+    ++numOfThreadAllocations;
+    if (void* p = std::malloc (size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size)                                { return operator new (size); }
+void* operator new   (std::size_t size, const std::nothrow_t&) noexcept { ++numOfThreadAllocations; return std::malloc (size == 0 ? 1 : size); }
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept { ++numOfThreadAllocations; return std::malloc (size == 0 ? 1 : size); }
+void operator delete   (void* p) noexcept                               { std::free (p); }
+void operator delete[] (void* p) noexcept                               { std::free (p); }
+void operator delete   (void* p, std::size_t) noexcept                  { std::free (p); }
+void operator delete[] (void* p, std::size_t) noexcept                  { std::free (p); }
+
+static int64 getNumOfThreadAllocations()    { return numOfThreadAllocations; }
+#endif
+
+//==============================================================================
+/** Synthetic pre/post signal: a slow sine sweep plus noise, and the same signal
+    after a gain and a one-pole low-pass, standing in for a hosted channel strip.
+*/
+class SignalGenerator
+{
+public:
+    SignalGenerator (int sR, int nC) : sampleRate (sR), lowPassState ((size_t) nC, 0.0f) {}
+
+    void fillNextBlock (AudioBuffer<float>& pre, AudioBuffer<float>& post, int numOfSamples)
+    {
+        const double phaseIncrementPerSample = 2.0 * double_Pi / sampleRate;
+
+        for (int i = 0; i < numOfSamples; ++i)
+        {
+            const double frequency = 100.0 + 5000.0 * (0.5 + 0.5 * std::sin (sweepPhase));
+            sinePhase  += frequency * phaseIncrementPerSample;
+            sweepPhase += 0.1 * phaseIncrementPerSample;
+
+            for (int channel = 0; channel < pre.getNumChannels(); ++channel)
+            {
+                const float sample = 0.5f * (float) std::sin (sinePhase + channel) + 0.1f * (random.nextFloat() - 0.5f);
+                float& state = lowPassState[(size_t) channel];
+                state += 0.2f * (sample - state);
+
+                pre .setSample (channel, i, sample);
+                post.setSample (channel, i, 0.7f * state);
+            }
+        }
+    }
+
+private:
+    const int sampleRate;
+    double sinePhase = 0, sweepPhase = 0;
+    std::vector<float> lowPassState;
+    Random random { 1 };
+};
+
+//==============================================================================
+struct benchmarkResultType
+{
+    String stage;
+    int fftSize, sampleRate, numOfChannels, numOfFrames;
+    double meanNs, minNs, maxNs;
+    double allocationsPerFrame;   // -1 when the allocation counter is not compiled in
+    double framesPerSecond;
+    double realtimeFactor;        // audio time of one hop / processing time of one frame
+
+    static String getCsvHeader()
+    {
+        return "stage,fft_size,sample_rate,channels,frames,mean_ns,min_ns,max_ns,allocations_per_frame,frames_per_second,realtime_factor";
+    }
+
+    String toCsv() const
+    {
+        return stage + "," + String (fftSize) + "," + String (sampleRate) + "," + String (numOfChannels) + "," + String (numOfFrames)
+             + "," + String (meanNs, 1) + "," + String (minNs, 1) + "," + String (maxNs, 1)
+             + "," + String (allocationsPerFrame, 3) + "," + String (framesPerSecond, 1) + "," + String (realtimeFactor, 2);
+    }
+};
+
+//==============================================================================
+/** Accumulates the time and the heap allocations of one stage over the measured frames. */
+class StageTimer
+{
+public:
+    explicit StageTimer (const String& name) : stage (name) {}
+
+    template <typename Function>
+    void measure (Function function, bool isWarmUp)
+    {
+        const int64 allocationsBefore = getNumOfAllocations();
+        const int64 start = Time::getHighResolutionTicks();
+        function();
+        const int64 end = Time::getHighResolutionTicks();
+        const int64 allocationsAfter = getNumOfAllocations();
+
+        if (isWarmUp)
+            return;
+
+        const double ns = Time::highResolutionTicksToSeconds (end - start) * 1.0e9;
+        sumNs += ns;
+        minNs = jmin (minNs, ns);
+        maxNs = jmax (maxNs, ns);
+        numOfAllocations += allocationsAfter - allocationsBefore;
+        ++numOfFrames;
+    }
+
+    benchmarkResultType getResult (int fftSize, int sampleRate, int numOfChannels, int hopSize) const
+    {
+        const double meanNs = numOfFrames > 0 ? sumNs / numOfFrames : 0;
+        const double hopNs  = 1.0e9 * hopSize / sampleRate;
+
+        return { stage, fftSize, sampleRate, numOfChannels, numOfFrames, meanNs, minNs, maxNs,
+                 allocationCounterAvailable() && numOfFrames > 0 ? (double) numOfAllocations / numOfFrames : -1.0,
+                 meanNs > 0 ? 1.0e9 / meanNs : 0, meanNs > 0 ? hopNs / meanNs : 0 };
+    }
+
+private:
+    static bool allocationCounterAvailable()   { return ANALYSER_BENCHMARK_COUNT_ALLOCATIONS != 0; }
+
+    static int64 getNumOfAllocations()
+    {
+       #if ANALYSER_BENCHMARK_COUNT_ALLOCATIONS
+        return getNumOfThreadAllocations();
+       #else
+        return 0;
+       #endif
+    }
+
+    String stage;
+    double sumNs = 0;
+    double minNs = std::numeric_limits<double>::max();
+    double maxNs = 0;
+    int64 numOfAllocations = 0;
+    int numOfFrames = 0;
+};
+
+//==============================================================================
+/** Drives the analysis chain for one configuration the way AnalysisThread does:
+    capture ring -> history -> STFT frame -> every view's processData().
+*/
+static void runConfiguration (int fftSize, int sampleRate, int numOfChannels, int numOfFrames, int numOfWarmUpFrames,
+                              Array<benchmarkResultType>& results)
+{
+    const int blockSize = 512;
+    const int hopSize   = roundToInt (sampleRate * ( 43 / 1000.0 ));
+
+    AudioBufferManagement buffers (numOfChannels, blockSize, sampleRate, 5 * sampleRate);
+    forwardFFT forwFFT (fftSize);
+    STFTAnalyser stftAnalyser (fftSize, sampleRate, buffers, forwFFT);
+
+    SpectrumAnalyser   spectrumAnalyser   (sampleRate, fftSize, numOfChannels, buffers, stftAnalyser);
+    SpectrumDifference spectrumDifference (sampleRate, fftSize, numOfChannels, buffers, stftAnalyser);
+    PhaseDifference    phaseDifference    (sampleRate, fftSize, numOfChannels, buffers, stftAnalyser);
+    CoherenceAnalyser  coherenceAnalyser  (sampleRate, fftSize, buffers, stftAnalyser);
+    StereoAnalyser     stereoAnalyser     (sampleRate, fftSize, buffers, forwFFT);
+    WaveformAnalyser   waveformAnalyser   (sampleRate, fftSize, buffers);
+    LevelMeter         levelMeter         (sampleRate, fftSize, buffers);
+    AlignmentEstimator alignmentEstimator (sampleRate, buffers);
+
+    std::vector<std::pair<AnalysisClient*, StageTimer>> clients;
+    clients.push_back ({ &spectrumAnalyser,   StageTimer ("SpectrumAnalyser::processData") });
+    clients.push_back ({ &spectrumDifference, StageTimer ("SpectrumDifference::processData") });
+    clients.push_back ({ &phaseDifference,    StageTimer ("PhaseDifference::processData") });
+    clients.push_back ({ &coherenceAnalyser,  StageTimer ("CoherenceAnalyser::processData") });
+    clients.push_back ({ &stereoAnalyser,     StageTimer ("StereoAnalyser::processData") });
+    clients.push_back ({ &waveformAnalyser,   StageTimer ("WaveformAnalyser::processData") });
+    clients.push_back ({ &levelMeter,         StageTimer ("LevelMeter::processData") });
+    clients.push_back ({ &alignmentEstimator, StageTimer ("AlignmentEstimator::processData") });   // measures every 250 ms of audio
+
+    StageTimer historyTimer ("AudioBufferManagement::pushAudioBufferIntoHistoryBuffer");
+    StageTimer stftTimer    ("STFTAnalyser::processNextFrame");
+    StageTimer frameTimer   ("frame");
+
+    SignalGenerator generator (sampleRate, numOfChannels);
+    AudioBuffer<float> pre  (numOfChannels, blockSize);
+    AudioBuffer<float> post (numOfChannels, blockSize);
+
+    for (int frame = 0; frame < numOfWarmUpFrames + numOfFrames; ++frame)
+    {
+        const bool isWarmUp = frame < numOfWarmUpFrames;
+
+        // one hop of audio through the capture ring, as the audio thread would write it
+        for (int written = 0; written < hopSize; written += blockSize)
+        {
+            const int numOfSamples = jmin (blockSize, hopSize - written);
+            generator.fillNextBlock (pre, post, numOfSamples);
+            buffers.captureRing.writePreBlock  (pre,  numOfSamples);
+            buffers.captureRing.writePostBlock (post, numOfSamples);
+            buffers.captureRing.publishBlock();
+        }
+
+        stftAnalyser.prepareFrame();
+        for (auto& client : clients)
+            client.first->prepareFrame();
+
+        frameTimer.measure ([&]
+        {
+            // the same check as the frame loop of AnalysisThread
+            const ScopedFrameAllocationCheck allocationCheck;
+            ignoreUnused (allocationCheck);
+
+            historyTimer.measure ([&] { buffers.pushAudioBufferIntoHistoryBuffer(); }, isWarmUp);
+            stftTimer   .measure ([&] { stftAnalyser.processNextFrame(); }, isWarmUp);
+
+            for (auto& client : clients)
+                client.second.measure ([&] { client.first->processData(); }, isWarmUp);
+        }, isWarmUp);
+    }
+
+    results.add (historyTimer.getResult (fftSize, sampleRate, numOfChannels, hopSize));
+    results.add (stftTimer   .getResult (fftSize, sampleRate, numOfChannels, hopSize));
+    for (auto& client : clients)
+        results.add (client.second.getResult (fftSize, sampleRate, numOfChannels, hopSize));
+    results.add (frameTimer.getResult (fftSize, sampleRate, numOfChannels, hopSize));
+}
+
+//==============================================================================
+static Array<int> parseIntList (const String& list)
+{
+    Array<int> values;
+    for (const String& value : StringArray::fromTokens (list, ",", ""))
+        values.add (value.getIntValue());
+    return values;
+}
+
+static void printUsage()
+{
+    std::cout << "Usage: AnalyserBenchmark [options]" << std::endl
+              << "  --fft <list>       FFT sizes (default 1024,2048,4096,8192,16384)" << std::endl
+              << "  --rates <list>     sample rates (default 44100,48000,96000,192000)" << std::endl
+              << "  --channels <list>  channel counts (default 1,2)" << std::endl
+              << "  --frames <n>       measured frames per configuration (default 200)" << std::endl
+              << "  --warmup <n>       frames run before measuring (default 20)" << std::endl
+              << "  --output <file>    write the CSV there instead of stdout" << std::endl;
+}
+
+int main (int argc, char* argv[])
+{
+    // the views are Components, they need a message manager even without a window
+    ScopedJuceInitialiser_GUI juceInitialiser;
+
+   #if ANALYSER_BENCHMARK_COUNT_ALLOCATIONS && CHANNELSTRIP_CHECK_FRAME_ALLOCATIONS
+    ScopedFrameAllocationCheck::setAllocationCounter (getNumOfThreadAllocations);
+   #endif
+
+    Array<int> fftSizes    { 1024, 2048, 4096, 8192, 16384 };
+    Array<int> sampleRates { 44100, 48000, 96000, 192000 };
+    Array<int> channels    { 1, 2 };
+    int numOfFrames = 200;
+    int numOfWarmUpFrames = 20;
+    File outputFile;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const String arg (argv[i]);
+        const bool hasValue = i + 1 < argc;
+
+        if      (arg == "--fft"      && hasValue) fftSizes          = parseIntList (argv[++i]);
+        else if (arg == "--rates"    && hasValue) sampleRates       = parseIntList (argv[++i]);
+        else if (arg == "--channels" && hasValue) channels          = parseIntList (argv[++i]);
+        else if (arg == "--frames"   && hasValue) numOfFrames       = String (argv[++i]).getIntValue();
+        else if (arg == "--warmup"   && hasValue) numOfWarmUpFrames = String (argv[++i]).getIntValue();
+        else if (arg == "--output"   && hasValue) outputFile        = File::getCurrentWorkingDirectory().getChildFile (argv[++i]);
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+
+    Array<benchmarkResultType> results;
+    for (int fftSize : fftSizes)
+        for (int sampleRate : sampleRates)
+            for (int numOfChannels : channels)
+                runConfiguration (fftSize, sampleRate, numOfChannels, numOfFrames, numOfWarmUpFrames, results);
+
+    String csv = benchmarkResultType::getCsvHeader() + "\n";
+    for (const benchmarkResultType& result : results)
+        csv << result.toCsv() << "\n";
+
+    if (outputFile == File())
+    {
+        std::cout << csv;
+        return 0;
+    }
+    return outputFile.replaceWithText (csv) ? 0 : 1;
+}
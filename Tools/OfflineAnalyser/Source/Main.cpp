@@ -0,0 +1,62 @@
+#include "OfflineAnalysis.h"
+
+//==============================================================================
+static void printUsage()
+{
+    std::cout << "Usage: OfflineAnalyser <input audio file> <output file> [options]" << std::endl
+              << "  --state <file>     plugin state saved by the host, restores the hosted chain" << std::endl
+              << "  --fft <size>       FFT size, power of two (default 2048)" << std::endl
+              << "  --hop <samples>    samples between two analysis frames (default 2048)" << std::endl
+              << "  --block <samples>  processing block size (default 512)" << std::endl
+              << "  --threads <n>      analysis worker threads (default: number of CPUs)" << std::endl
+              << "  --binary           write the compact binary format instead of CSV" << std::endl;
+}
+
+int main (int argc, char* argv[])
+{
+    // hosted plugins need a message manager, even without a window
+    ScopedJuceInitialiser_GUI juceInitialiser;
+
+    StringArray args;
+    for (int i = 1; i < argc; ++i)
+        args.add (argv[i]);
+
+    if (args.size() < 2)
+    {
+        printUsage();
+        return 1;
+    }
+
+    OfflineAnalysisRunner::optionsType options;
+    options.inputFile  = File::getCurrentWorkingDirectory().getChildFile (args[0]);
+    options.outputFile = File::getCurrentWorkingDirectory().getChildFile (args[1]);
+
+    for (int i = 2; i < args.size(); ++i)
+    {
+        const String& arg = args[i];
+        const bool hasValue = i + 1 < args.size();
+
+        if      (arg == "--state"   && hasValue) options.stateFile    = File::getCurrentWorkingDirectory().getChildFile (args[++i]);
+        else if (arg == "--fft"     && hasValue) options.fftSize      = args[++i].getIntValue();
+        else if (arg == "--hop"     && hasValue) options.hopSize      = args[++i].getIntValue();
+        else if (arg == "--block"   && hasValue) options.blockSize    = args[++i].getIntValue();
+        else if (arg == "--threads" && hasValue) options.numOfThreads = args[++i].getIntValue();
+        else if (arg == "--binary")              options.writeBinary  = true;
+        else
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            printUsage();
+            return 1;
+        }
+    }
+
+    OfflineAnalysisRunner runner (options);
+    const Result result = runner.run();
+
+    if (result.failed())
+    {
+        std::cerr << result.getErrorMessage() << std::endl;
+        return 1;
+    }
+    return 0;
+}
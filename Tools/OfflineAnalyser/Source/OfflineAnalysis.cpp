@@ -0,0 +1,410 @@
+#include "OfflineAnalysis.h"
+
+//==============================================================================
+// HOP METRICS
+StringArray hopMetricsType::getColumnNames (const frequencyBandTable& bands)
+{
+    StringArray names { "time_s", "rms_pre_db", "rms_post_db", "rms_gain_db", "correlation_pre", "correlation_post" };
+
+    for (int band = 0; band < bands.getNumOfBands(); ++band)
+        names.add ("spectrum_difference_db_" + String (roundToInt (bands.centreFrequency[band])));
+    for (int band = 0; band < bands.getNumOfBands(); ++band)
+        names.add ("phase_difference_deg_" + String (roundToInt (bands.centreFrequency[band])));
+
+    jassert (names.size() == getNumOfColumns (bands));
+    return names;
+}
+
+void hopMetricsType::getColumns (float* columns) const
+{
+    *columns++ = timeSeconds;
+    *columns++ = rmsPreDb;
+    *columns++ = rmsPostDb;
+    *columns++ = rmsGainDb;
+    *columns++ = correlationPre;
+    *columns++ = correlationPost;
+
+    for (float value : spectrumDifferenceDb)
+        *columns++ = value;
+    for (float value : phaseDifferenceDegrees)
+        *columns++ = value;
+}
+
+
+//==============================================================================
+// HOP ANALYSER
+HopAnalyser::HopAnalyser (int fS, int sR, int bS, int hS, const frequencyBandTable& b)
+:
+fftSize (fS),
+sampleRate (sR),
+maxBlockSize (bS),
+historySize (hS),
+rmsWindowLength (getRMSWindowLength (sR)),
+bands (b),
+buffers (2, bS, bS, hS),
+fft (fS),
+alignedBlock (2, bS)
+{
+    jassert (isPowerOfTwo (fftSize));
+    transfer.setSize (fftSize / 2 + 1);
+
+    // the correlations cover the newest fftSize samples, like the old per-window meter
+    const int sumBlockSize = jmin (fftSize, (int) correlationSumBlockSize);
+    correlationPre  .setSize (fftSize / sumBlockSize, sumBlockSize);
+    correlationPost .setSize (fftSize / sumBlockSize, sumBlockSize);
+}
+
+void HopAnalyser::reset (int processorDelay)
+{
+    buffers.reset (2, maxBlockSize, maxBlockSize, historySize);
+    buffers.bufferPre.processorDelay.store (processorDelay);
+
+    stftAnalyser.reset (new STFTAnalyser (fftSize, sampleRate, buffers, fft));
+    transfer.reset();
+    correlationPre  .reset();
+    correlationPost .reset();
+}
+
+void HopAnalyser::addBlock (AudioBuffer<float>& pre, AudioBuffer<float>& post, int startSample, int numOfSamples)
+{
+    jassert (numOfSamples <= maxBlockSize);
+
+    // the capture ring takes a block from its first sample on, these refer to the segment's samples
+    AudioBuffer<float> preBlock  (pre.getArrayOfWritePointers(),  pre.getNumChannels(),  startSample, numOfSamples);
+    AudioBuffer<float> postBlock (post.getArrayOfWritePointers(), post.getNumChannels(), startSample, numOfSamples);
+
+    // the same way into the histories as the plugin's audio and analysis threads take them
+    buffers.captureRing.writePreBlock  (preBlock,  numOfSamples);
+    buffers.captureRing.writePostBlock (postBlock, numOfSamples);
+    buffers.captureRing.publishBlock();
+    buffers.pushAudioBufferIntoHistoryBuffer();
+
+    // the stereo view reads the new samples back, the pre tap delayed by the chain's latency
+    buffers.bufferPre.copySamplesFromHistoryBuffer (alignedBlock, numOfSamples);
+    correlationPre.addSamples (alignedBlock.getReadPointer (0), alignedBlock.getReadPointer (1), numOfSamples);
+    buffers.bufferPost.copySamplesFromHistoryBuffer (alignedBlock, numOfSamples);
+    correlationPost.addSamples (alignedBlock.getReadPointer (0), alignedBlock.getReadPointer (1), numOfSamples);
+}
+
+void HopAnalyser::endHop()
+{
+    // no smoothing: the transfer function of this frame's windows alone; a hop shorter than
+    // the STFT's own keeps the previous frame when no new window was due
+    if (! stftAnalyser->processNextFrame())
+        return;
+
+    const STFTAnalyser::spectrumFramePtr frame = stftAnalyser->getLatestFrame();
+    transfer.addFrame (frame->getAveragePre  (spectrumFrameType::mid),
+                       frame->getAveragePost (spectrumFrameType::mid),
+                       frame->getCrossSpectrum (spectrumFrameType::mid), 0.0f);
+}
+
+void HopAnalyser::getMetrics (hopMetricsType& metrics)
+{
+    // the level views' RMS of the mono sum (L + R)
+    const float rmsPre  = buffers.bufferPre  .getRMSMonoValueInSample (0, rmsWindowLength) * 0.5f;
+    const float rmsPost = buffers.bufferPost .getRMSMonoValueInSample (0, rmsWindowLength) * 0.5f;
+    metrics.rmsPreDb  = Decibels::gainToDecibels (rmsPre);
+    metrics.rmsPostDb = Decibels::gainToDecibels (rmsPost);
+    metrics.rmsGainDb = metrics.rmsPostDb - metrics.rmsPreDb;
+
+    metrics.correlationPre  = correlationPre.getCorrelation();
+    metrics.correlationPost = correlationPost.getCorrelation();
+
+    for (int band = 0; band < bands.getNumOfBands(); ++band)
+    {
+        const int firstBin  = bands.firstBin[band];
+        const int numOfBins = bands.numOfBins[band];
+        const float gain = transfer.getBandGain (firstBin, numOfBins, transferFunctionType::h1Estimator);
+
+        // silence on either tap reads as no difference
+        metrics.spectrumDifferenceDb[band]   = gain > 0 ? 20.0f * std::log10 (gain) : 0.0f;
+        metrics.phaseDifferenceDegrees[band] = radiansToDegrees (transfer.getBandPhase (firstBin, numOfBins));
+    }
+}
+
+
+//==============================================================================
+// OFFLINE ANALYSIS RUNNER
+namespace
+{
+    /** One segment of the rendered taps and the engine that analyses it. The main thread
+        only fills a job that is not in the pool, the job only writes its own hops' results. */
+    class SegmentJob  : public ThreadPoolJob
+    {
+    public:
+        SegmentJob (const OfflineAnalysisRunner::optionsType& o, double sR, int64 nS, int segmentLength, int historySize,
+                    const frequencyBandTable& bands, std::vector<hopMetricsType>& r)
+        : ThreadPoolJob ("Segment"),
+          hopAnalyser (o.fftSize, (int) sR, o.blockSize, historySize, bands),
+          pre  (2, segmentLength),
+          post (2, segmentLength),
+          options (o),
+          sampleRate (sR),
+          numOfFileSamples (nS),
+          results (r)
+        {}
+
+        /** Main thread: the segment starts numOfPreRollHops hops before firstHop, its samples go to pre and post. */
+        void setSegment (int newFirstHop, int newNumOfPreRollHops, int newNumOfHops, int newProcessorDelay)
+        {
+            firstHop         = newFirstHop;
+            numOfPreRollHops = newNumOfPreRollHops;
+            numOfHops        = newNumOfHops;
+            processorDelay   = newProcessorDelay;
+        }
+
+        JobStatus runJob() override
+        {
+            hopAnalyser.reset (processorDelay);
+
+            const int64 firstSample = (int64) (firstHop - numOfPreRollHops) * options.hopSize;
+            int position = 0;
+
+            for (int hop = firstHop - numOfPreRollHops; hop < firstHop + numOfHops; ++hop)
+            {
+                // blocks are cut at every hop end, the last hop ends with the file
+                const int hopEnd = (int) (jmin ((int64) (hop + 1) * options.hopSize, numOfFileSamples) - firstSample);
+                while (position < hopEnd)
+                {
+                    const int numOfBlockSamples = jmin (options.blockSize, hopEnd - position);
+                    hopAnalyser.addBlock (pre, post, position, numOfBlockSamples);
+                    position += numOfBlockSamples;
+                }
+                hopAnalyser.endHop();
+
+                if (hop < firstHop)
+                    continue;
+
+                hopMetricsType& metrics = results[(size_t) hop];
+                metrics.timeSeconds = (float) ((firstSample + hopEnd) / sampleRate);
+                hopAnalyser.getMetrics (metrics);
+            }
+            return jobHasFinished;
+        }
+
+        HopAnalyser hopAnalyser;
+        AudioBuffer<float> pre, post;
+
+    private:
+        const OfflineAnalysisRunner::optionsType& options;
+        const double sampleRate;
+        const int64 numOfFileSamples;
+        std::vector<hopMetricsType>& results;
+
+        int firstHop = 0;
+        int numOfPreRollHops = 0;
+        int numOfHops = 0;
+        int processorDelay = 0;
+    };
+}
+
+OfflineAnalysisRunner::OfflineAnalysisRunner (const optionsType& o)
+: options (o)
+{
+}
+
+Result OfflineAnalysisRunner::run()
+{
+    AudioFormatManager audioFormatManager;
+    audioFormatManager.registerBasicFormats();
+
+    std::unique_ptr<AudioFormatReader> reader (audioFormatManager.createReaderFor (options.inputFile));
+    if (reader == nullptr)
+        return Result::fail ("Cannot read " + options.inputFile.getFullPathName());
+
+    if (! isPowerOfTwo (options.fftSize) || options.hopSize <= 0 || options.blockSize <= 0)
+        return Result::fail ("The FFT size must be a power of two and hop and block sizes positive");
+
+    const double sampleRate = reader->sampleRate;
+    const int64 numOfSamples = reader->lengthInSamples;
+
+    // the same chain the plugin would run, restored from a saved state when one is given
+    const Result chainResult = loadChain (sampleRate);
+    if (chainResult.failed())
+        return chainResult;
+    const int latency = chainRenderer.getLatencySamples();
+
+    bands.build (frequencyBandTable::thirdOctaveBands, options.fftSize, (int) sampleRate);
+
+    // the trailing partial hop is a hop of its own, it ends with the file
+    const int numOfHops = (int) ((numOfSamples + options.hopSize - 1) / options.hopSize);
+    std::vector<hopMetricsType> results ((size_t) numOfHops);
+    for (hopMetricsType& metrics : results)
+    {
+        metrics.spectrumDifferenceDb   .resize ((size_t) bands.getNumOfBands());
+        metrics.phaseDifferenceDegrees .resize ((size_t) bands.getNumOfBands());
+    }
+
+    // the pre-roll fills the longest window of the pre tap, which is read latency samples late;
+    // segments are long against it, so most of the work is on hops that are written out
+    const int rmsWindowLength = HopAnalyser::getRMSWindowLength (sampleRate);
+    const int numOfPreRollHops = (jmax (options.fftSize, rmsWindowLength) + latency + options.hopSize - 1) / options.hopSize;
+    const int numOfHopsPerSegment = jmax (32, 8 * numOfPreRollHops);
+    const int preRollLength = numOfPreRollHops * options.hopSize;
+    const int segmentLength = (numOfPreRollHops + numOfHopsPerSegment) * options.hopSize;
+
+    // the STFT keeps a backlog of half the history, a window and a hop have to fit into it
+    const int historySize = 2 * (options.fftSize + options.hopSize) + rmsWindowLength + latency;
+
+    // two segments per thread: one being analysed while the main thread renders the next
+    const int numOfThreads = jmax (1, options.numOfThreads);
+    OwnedArray<SegmentJob> jobs;
+    for (int i = 0; i < 2 * numOfThreads; ++i)
+        jobs.add (new SegmentJob (options, sampleRate, numOfSamples, segmentLength, historySize, bands, results));
+
+    ThreadPool pool (numOfThreads);
+
+    AudioBuffer<float> block (2, options.blockSize);
+    AudioBuffer<float> preRollPre  (2, preRollLength);
+    AudioBuffer<float> preRollPost (2, preRollLength);
+    MidiBuffer midiMessages;
+    int64 position = 0;
+
+    for (int firstHop = 0, segment = 0; firstHop < numOfHops; firstHop += numOfHopsPerSegment, ++segment)
+    {
+        // the jobs are the queue: a job takes its next segment once it is done with the last one
+        SegmentJob& job = *jobs[segment % jobs.size()];
+        pool.waitForJobToFinish (&job, -1);
+
+        // the pre-roll is the end of the previous segment, the first one starts with empty histories
+        const int numOfSegmentPreRollHops = firstHop > 0 ? numOfPreRollHops : 0;
+        const int numOfSegmentHops = jmin (numOfHopsPerSegment, numOfHops - firstHop);
+        job.setSegment (firstHop, numOfSegmentPreRollHops, numOfSegmentHops, latency);
+
+        int segmentPosition = numOfSegmentPreRollHops * options.hopSize;
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            job.pre  .copyFrom (channel, 0, preRollPre,  channel, 0, segmentPosition);
+            job.post .copyFrom (channel, 0, preRollPost, channel, 0, segmentPosition);
+        }
+
+        const int64 segmentEnd = jmin ((int64) (firstHop + numOfSegmentHops) * options.hopSize, numOfSamples);
+        while (position < segmentEnd)
+        {
+            const int numOfBlockSamples = (int) jmin ((int64) options.blockSize, segmentEnd - position);
+
+            block.clear();
+            reader->read (&block, 0, numOfBlockSamples, position, true, true);
+            AudioBuffer<float> blockToProcess (block.getArrayOfWritePointers(), block.getNumChannels(), numOfBlockSamples);
+
+            for (int channel = 0; channel < 2; ++channel)
+                job.pre.copyFrom (channel, segmentPosition, blockToProcess, channel, 0, numOfBlockSamples);
+            chainRenderer.process (blockToProcess, midiMessages);
+            midiMessages.clear();
+            for (int channel = 0; channel < 2; ++channel)
+                job.post.copyFrom (channel, segmentPosition, blockToProcess, channel, 0, numOfBlockSamples);
+
+            position += numOfBlockSamples;
+            segmentPosition += numOfBlockSamples;
+        }
+
+        // the worker owns the segment from here on, the next pre-roll is copied before
+        if (segmentPosition >= preRollLength)
+        {
+            for (int channel = 0; channel < 2; ++channel)
+            {
+                preRollPre  .copyFrom (channel, 0, job.pre,  channel, segmentPosition - preRollLength, preRollLength);
+                preRollPost .copyFrom (channel, 0, job.post, channel, segmentPosition - preRollLength, preRollLength);
+            }
+        }
+        pool.addJob (&job, false);
+    }
+
+    for (SegmentJob* job : jobs)
+        pool.waitForJobToFinish (job, -1);
+
+    return options.writeBinary ? writeBinary (results) : writeCsv (results);
+}
+
+Result OfflineAnalysisRunner::loadChain (double sampleRate)
+{
+    // set up like the plugin's prepareToPlay(); without a state the chain stays empty and post is pre
+    chainRenderer.prepare (sampleRate, options.blockSize, 2);
+
+    if (options.stateFile == File())
+        return Result::ok();
+
+    MemoryBlock state;
+    if (! options.stateFile.loadFileAsData (state))
+        return Result::fail ("Cannot read " + options.stateFile.getFullPathName());
+
+    ScopedPointer<XmlElement> rootXml (AudioProcessor::getXmlFromBinary (state.getData(), (int) state.getSize()));
+    if (rootXml == nullptr)
+        return Result::fail (options.stateFile.getFullPathName() + " is not a state saved by the plugin");
+
+    savedChainType savedChain;
+    savedChain.readFromXml (*rootXml);
+    formatManager.addDefaultFormats();
+
+    // bypassed slots do not run, their plugins are not loaded at all
+    ChainRenderer::slotNodesType slotNodes;
+    for (const savedChainType::slotType& slot : savedChain.slots)
+    {
+        AudioProcessorGraph::Node::Ptr node;
+        if (slot.isLoaded && ! slot.isBypassed)
+        {
+            String errorMessage;
+            AudioPluginInstance* plugin = formatManager.createPluginInstance (slot.description, sampleRate, options.blockSize, errorMessage);
+            if (plugin == nullptr)
+                return Result::fail ("Cannot load " + slot.description.name + ": " + errorMessage);
+
+            plugin->setStateInformation (slot.state.getData(), (int) slot.state.getSize());
+            node = graph.addNode (plugin);
+        }
+        slotNodes.add (node);
+    }
+
+    // preparing again installs the chain at once, the file does not start with a crossfade
+    chainRenderer.setChain (slotNodes, savedChain.layout);
+    chainRenderer.prepare (sampleRate, options.blockSize, 2);
+    return Result::ok();
+}
+
+Result OfflineAnalysisRunner::writeCsv (const std::vector<hopMetricsType>& results) const
+{
+    options.outputFile.deleteFile();
+    FileOutputStream stream (options.outputFile);
+    if (stream.failedToOpen())
+        return Result::fail ("Cannot write " + options.outputFile.getFullPathName());
+
+    stream << hopMetricsType::getColumnNames (bands).joinIntoString (",") << "\n";
+
+    std::vector<float> columns ((size_t) hopMetricsType::getNumOfColumns (bands));
+    for (const hopMetricsType& metrics : results)
+    {
+        metrics.getColumns (columns.data());
+
+        String line;
+        for (size_t i = 0; i < columns.size(); ++i)
+            line << (i > 0 ? "," : "") << String (columns[i], 4);
+        stream << line << "\n";
+    }
+    return Result::ok();
+}
+
+Result OfflineAnalysisRunner::writeBinary (const std::vector<hopMetricsType>& results) const
+{
+    // "CSAM", version, number of columns, the column names (null terminated),
+    // number of rows, then the rows as little endian float32.
+    options.outputFile.deleteFile();
+    FileOutputStream stream (options.outputFile);
+    if (stream.failedToOpen())
+        return Result::fail ("Cannot write " + options.outputFile.getFullPathName());
+
+    stream.write ("CSAM", 4);
+    stream.writeInt (1);
+    stream.writeInt (hopMetricsType::getNumOfColumns (bands));
+    for (const String& name : hopMetricsType::getColumnNames (bands))
+        stream.writeString (name);
+    stream.writeInt64 ((int64) results.size());
+
+    std::vector<float> columns ((size_t) hopMetricsType::getNumOfColumns (bands));
+    for (const hopMetricsType& metrics : results)
+    {
+        metrics.getColumns (columns.data());
+        for (float value : columns)
+            stream.writeFloat (value);
+    }
+    return Result::ok();
+}
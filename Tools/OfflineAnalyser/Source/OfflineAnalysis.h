@@ -0,0 +1,114 @@
+#pragma once
+// The engine headers include "JuceHeader.h" through the include path, the tool's own AppConfig.
+#include "../../../Source/AnalysisEngine.h"
+#include "../../../Source/ChainRenderer.h"
+
+//==============================================================================
+/** The metrics of one analysis hop, the quantities the editor's views show: RMS gain,
+    pre/post correlation and the transfer function's gain and phase per third octave band.
+*/
+struct hopMetricsType
+{
+    enum { numOfFixedColumns = 6 };
+
+    float timeSeconds     = 0;
+    float rmsPreDb        = 0;
+    float rmsPostDb       = 0;
+    float rmsGainDb       = 0;
+    float correlationPre  = 0;
+    float correlationPost = 0;
+    std::vector<float> spectrumDifferenceDb;      // one per band of the frequencyBandTable
+    std::vector<float> phaseDifferenceDegrees;
+
+    static int getNumOfColumns (const frequencyBandTable& bands)   { return numOfFixedColumns + 2 * bands.getNumOfBands(); }
+    static StringArray getColumnNames (const frequencyBandTable& bands);
+    void getColumns (float* columns) const;
+};
+
+//==============================================================================
+/** The plugin's analysis engine for one stretch of the file: capture ring and histories,
+    the STFT, the transfer function and the streaming correlations the views use. Every
+    worker job owns one, nothing in it is shared but the band table.
+*/
+class HopAnalyser
+{
+public:
+    HopAnalyser (int fftSize, int sampleRate, int maxBlockSize, int historySize, const frequencyBandTable& bands);
+
+    /** Starts over with empty histories; the pre tap is read this many samples late, like the plugin's. */
+    void reset (int processorDelay);
+
+    /** Captures one block of both taps, at most maxBlockSize samples from startSample on. */
+    void addBlock (AudioBuffer<float>& pre, AudioBuffer<float>& post, int startSample, int numOfSamples);
+
+    /** At the end of every hop, also the ones whose metrics are not needed: a frame
+        averages the STFT windows since the previous one. */
+    void endHop();
+
+    /** The metrics of the hop endHop() closed, the band vectors sized to the band table. */
+    void getMetrics (hopMetricsType& metrics);
+
+    /** The RMS window of the level views. */
+    static int getRMSWindowLength (double sampleRate)   { return (int) (sampleRate * 0.4); }
+
+private:
+    const int fftSize;
+    const int sampleRate;
+    const int maxBlockSize;
+    const int historySize;
+    const int rmsWindowLength;
+    const frequencyBandTable& bands;
+
+    AudioBufferManagement buffers;
+    forwardFFT fft;
+    std::unique_ptr<STFTAnalyser> stftAnalyser;     // one per reset, its windows start with the histories
+    transferFunctionType transfer;
+    streamingCorrelationType correlationPre;
+    streamingCorrelationType correlationPost;
+    AudioBuffer<float> alignedBlock;                // the newest samples of a tap, pre delayed like the views read it
+
+    enum { correlationSumBlockSize = 256 };
+};
+
+//==============================================================================
+/** Streams an audio file through the hosted chain faster than real time and writes the
+    hop metrics as a CSV or compact binary time series. The chain is rebuilt from a state
+    saved by the plugin, without the plugin itself.
+
+    The main thread renders the chain and cuts its pre and post taps into segments of
+    whole hops. Each segment carries a pre-roll of the hops before it, long enough for the
+    longest window and the latency, so a worker analyses it with a fresh engine whose
+    histories are full by the segment's first hop. A fixed set of jobs is reused for the
+    segments, the main thread waits for a job before it refills it.
+*/
+class OfflineAnalysisRunner
+{
+public:
+    struct optionsType
+    {
+        File inputFile;
+        File outputFile;
+        File stateFile;        // optional, a state blob saved by the plugin's getStateInformation()
+        int fftSize    = 2048;
+        int hopSize    = 2048;
+        int blockSize  = 512;
+        int numOfThreads = SystemStats::getNumCpus();
+        bool writeBinary = false;
+    };
+
+    explicit OfflineAnalysisRunner (const optionsType& options);
+
+    Result run();
+
+private:
+    Result loadChain (double sampleRate);
+    Result writeCsv    (const std::vector<hopMetricsType>& results) const;
+    Result writeBinary (const std::vector<hopMetricsType>& results) const;
+
+    optionsType options;
+    frequencyBandTable bands;
+
+    AudioPluginFormatManager formatManager;
+    AudioProcessorGraph graph;          // owns the hosted plugins
+    ChainRenderer chainRenderer;
+};
@@ -0,0 +1,168 @@
+#include "SpectrumKernel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+//==============================================================================
+/** Checks the SSE2 / NEON path of spectrumKernel::magnitudeToDb against the scalar
+    reference on the same input. Both sides get their own copy of the peak-hold
+    state, so a difference in the decay shows up in the frames after it happened.
+    Without SIMD both sides run the scalar code and the tests pass trivially.
+*/
+class SpectrumKernelTest
+{
+public:
+    int run()
+    {
+        beginTest ("random bins, every tail length");
+        for (int numOfBins = 0; numOfBins <= 67; ++numOfBins)
+        {
+            fillRandom (numOfBins, 1.0f);
+            compareFrame (numOfBins, 0.95f, -20.0f);
+        }
+
+        beginTest ("random bins, large frame");
+        fillRandom (8193, 100.0f);
+        compareFrame (8193, 0.9f, 0.0f);
+
+        beginTest ("peak hold decays the same way");
+        fillRandom (1027, 10.0f);
+        compareFrame (1027, 0.8f, -6.0f);
+        for (int frame = 0; frame < 64; ++frame)
+        {
+            // quiet frames let the held peaks decay, every 8th frame some bins come back louder
+            for (int i = 0; i < 2 * 1027; ++i)
+                bins[(size_t) i] = (frame % 8 == 7 && i % 6 < 2) ? 4.0f * nextFloat() : 1.0e-3f * (nextFloat() - 0.5f);
+            compareFrame (1027, 0.8f, -6.0f);
+        }
+
+        beginTest ("dB floor");
+        {
+            // zero, denormal and tiny magnitudes all sit below the floor, a bin 1 dB above it stays put
+            const float floorDb = spectrumKernel::minimumDb;
+            const float magnitudes[] = { 0.0f, 1.0e-40f, std::numeric_limits<float>::denorm_min(), std::numeric_limits<float>::min(),
+                                         1.0e-12f, 1.0e-11f, std::pow (10.0f, (floorDb + 1.0f) / 20.0f) };
+            const int numOfBins = (int) (sizeof (magnitudes) / sizeof (magnitudes[0]));
+            fillMagnitudes (magnitudes, numOfBins);
+            compareFrame (numOfBins, 0.95f, 0.0f);
+
+            for (int i = 0; i < numOfBins - 1; ++i)
+            {
+                expectEquals (dbSimd  [(size_t) i], floorDb, "SIMD dB of a magnitude below the floor");
+                expectEquals (dbScalar[(size_t) i], floorDb, "scalar dB of a magnitude below the floor");
+            }
+            expectWithinAbsoluteError (dbSimd[(size_t) numOfBins - 1], floorDb + 1.0f, dbTolerance, "dB of a bin above the floor");
+
+            // a large negative offset pushes ordinary bins onto the floor as well
+            fillRandom (29, 1.0f);
+            compareFrame (29, 0.95f, -400.0f);
+            for (int i = 0; i < 29; ++i)
+                expectEquals (dbSimd[(size_t) i], floorDb, "dB with a large negative offset");
+        }
+
+        beginTest ("scalar path against 20 log10");
+        fillRandom (256, 1000.0f);
+        std::fill (maxScalar.begin(), maxScalar.end(), 0.0f);
+        std::fill (maxSimd  .begin(), maxSimd  .end(), 0.0f);
+        compareFrame (256, 0.95f, 0.0f);
+        for (int i = 0; i < 256; ++i)
+        {
+            const float exactDb = std::max ((float) spectrumKernel::minimumDb, 20.0f * std::log10 (maxScalar[(size_t) i]));
+            expectWithinAbsoluteError (dbScalar[(size_t) i], exactDb, 0.01f, "scalar dB against 20 log10");
+        }
+
+        std::printf ("%d checks, %d failures\n", numOfChecks, numOfFailures);
+        return numOfFailures == 0 ? 0 : 1;
+    }
+
+private:
+    enum { maxReportedFailures = 20 };
+
+    // the polynomial log2 is the same on both paths, only the rounding order differs
+    const float dbTolerance  = 1.0e-3f;
+    const float maxTolerance = 1.0e-5f;
+
+    void beginTest (const char* name)
+    {
+        std::printf ("%s\n", name);
+        testName = name;
+    }
+
+    void expectWithinAbsoluteError (float actual, float expected, float tolerance, const char* what, int bin = -1, int numOfBins = -1)
+    {
+        ++numOfChecks;
+        if (std::abs (actual - expected) <= tolerance)
+            return;
+
+        if (++numOfFailures <= maxReportedFailures)
+            std::printf ("  FAILED (%s): %s, bin %d of %d: %.7g, expected %.7g +- %g\n",
+                         testName, what, bin, numOfBins, actual, expected, tolerance);
+    }
+
+    void expectEquals (float actual, float expected, const char* what)
+    {
+        expectWithinAbsoluteError (actual, expected, 0.0f, what);
+    }
+
+    float nextFloat()               { return std::uniform_real_distribution<float> (0.0f, 1.0f) (random); }
+    bool nextBool()                 { return (random() & 1) != 0; }
+
+    void resize (int numOfBins)
+    {
+        bins     .resize ((size_t) (2 * numOfBins));
+        maxSimd  .resize ((size_t) numOfBins);
+        maxScalar.resize ((size_t) numOfBins);
+        dbSimd   .resize ((size_t) numOfBins);
+        dbScalar .resize ((size_t) numOfBins);
+    }
+
+    /** Random re/im pairs, the held peaks land on both sides of the new magnitude. */
+    void fillRandom (int numOfBins, float range)
+    {
+        resize (numOfBins);
+        for (auto& bin : bins)
+            bin = range * (2.0f * nextFloat() - 1.0f);
+        for (int i = 0; i < numOfBins; ++i)
+            maxSimd[(size_t) i] = maxScalar[(size_t) i] = nextBool() ? 1.5f * range * nextFloat() : 0.0f;
+    }
+
+    void fillMagnitudes (const float* magnitudes, int numOfBins)
+    {
+        resize (numOfBins);
+        for (int i = 0; i < numOfBins; ++i)
+        {
+            bins[(size_t) (2 * i)]     = magnitudes[i];
+            bins[(size_t) (2 * i + 1)] = 0.0f;
+            maxSimd[(size_t) i] = maxScalar[(size_t) i] = 0.0f;
+        }
+    }
+
+    void compareFrame (int numOfBins, float decayRatio, float dbOffset)
+    {
+        spectrumKernel::magnitudeToDb       (bins.data(), numOfBins, maxSimd.data(),   decayRatio, dbOffset, dbSimd.data());
+        spectrumKernel::magnitudeToDbScalar (bins.data(), numOfBins, maxScalar.data(), decayRatio, dbOffset, dbScalar.data());
+
+        for (int i = 0; i < numOfBins; ++i)
+        {
+            const float scalarMax = maxScalar[(size_t) i];
+            expectWithinAbsoluteError (dbSimd [(size_t) i], dbScalar[(size_t) i], dbTolerance, "dB", i, numOfBins);
+            expectWithinAbsoluteError (maxSimd[(size_t) i], scalarMax, maxTolerance * std::max (1.0f, scalarMax), "held peak", i, numOfBins);
+        }
+    }
+
+    std::mt19937 random { 4 };
+    std::vector<float> bins, maxSimd, maxScalar, dbSimd, dbScalar;
+    const char* testName = "";
+    int numOfChecks = 0;
+    int numOfFailures = 0;
+};
+
+//==============================================================================
+int main()
+{
+    SpectrumKernelTest test;
+    return test.run();
+}